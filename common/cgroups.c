@@ -0,0 +1,431 @@
+/*
+ * Copyright Cedric Bellegarde <cedric.bellegarde@adishatz.org>
+ */
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+
+#include <glib-unix.h>
+
+#include "cgroups.h"
+#include "define.h"
+#include "utils.h"
+
+#define CGROUPS_INOTIFY_MASK \
+    (IN_CREATE | IN_DELETE | IN_ONLYDIR | IN_EXCL_UNLINK)
+#define CGROUPS_INOTIFY_BUFFER_SIZE 4096
+
+struct _CgroupsPrivate {
+    char *path;
+
+    gint inotify_fd;
+    GSource *inotify_source;
+
+    GHashTable *watches;
+    GHashTable *services;
+    GHashTable *scopes;
+};
+
+G_DEFINE_TYPE_WITH_CODE (
+    Cgroups,
+    cgroups,
+    G_TYPE_OBJECT,
+    G_ADD_PRIVATE (Cgroups)
+)
+
+static void cgroups_scan (Cgroups *self, const char *path);
+
+static void
+index_cgroup (Cgroups    *self,
+              const char *path,
+              const char *name)
+{
+    g_autofree char *cgroup = g_build_filename (path, name, NULL);
+
+    if (g_str_has_suffix (name, ".slice"))
+        cgroups_scan (self, cgroup);
+    else if (g_str_has_suffix (name, ".service"))
+        g_hash_table_replace (
+            self->priv->services, g_strdup (name), g_steal_pointer (&cgroup)
+        );
+    else if (g_str_has_suffix (name, ".scope"))
+        g_hash_table_replace (
+            self->priv->scopes, g_strdup (name), g_steal_pointer (&cgroup)
+        );
+}
+
+static void
+unindex_cgroup (Cgroups    *self,
+                const char *path,
+                const char *name)
+{
+    g_autofree char *cgroup = g_build_filename (path, name, NULL);
+    GHashTable *table = NULL;
+
+    /* Slices watches go away with IN_IGNORED */
+    if (g_str_has_suffix (name, ".service"))
+        table = self->priv->services;
+    else if (g_str_has_suffix (name, ".scope"))
+        table = self->priv->scopes;
+
+    /* Same name may be indexed from another slice */
+    if (table != NULL &&
+            g_strcmp0 (g_hash_table_lookup (table, name), cgroup) == 0)
+        g_hash_table_remove (table, name);
+}
+
+static void
+cgroups_scan (Cgroups    *self,
+              const char *path)
+{
+    g_autoptr (GDir) dir = NULL;
+    const char *name;
+    gint wd;
+
+    /* Watch before reading, so no cgroup is missed in between */
+    wd = inotify_add_watch (self->priv->inotify_fd, path, CGROUPS_INOTIFY_MASK);
+    if (wd < 0)
+        g_warning ("Can't watch cgroup %s: %s", path, g_strerror (errno));
+    else
+        g_hash_table_replace (
+            self->priv->watches, GINT_TO_POINTER (wd), g_strdup (path)
+        );
+
+    dir = g_dir_open (path, 0, NULL);
+    if (dir == NULL) {
+        g_warning ("Can't find cgroup: %s", path);
+        return;
+    }
+
+    while ((name = g_dir_read_name (dir)) != NULL)
+        index_cgroup (self, path, name);
+}
+
+static void
+cgroups_rebuild (Cgroups *self)
+{
+    GHashTableIter iter;
+    gpointer wd;
+
+    g_hash_table_iter_init (&iter, self->priv->watches);
+    while (g_hash_table_iter_next (&iter, &wd, NULL))
+        inotify_rm_watch (self->priv->inotify_fd, GPOINTER_TO_INT (wd));
+
+    g_hash_table_remove_all (self->priv->watches);
+    g_hash_table_remove_all (self->priv->services);
+    g_hash_table_remove_all (self->priv->scopes);
+
+    cgroups_scan (self, self->priv->path);
+}
+
+static gboolean
+on_inotify_event (gint         fd,
+                  GIOCondition condition,
+                  gpointer     user_data)
+{
+    Cgroups *self = CGROUPS (user_data);
+    char buffer[CGROUPS_INOTIFY_BUFFER_SIZE]
+        __attribute__ ((aligned (__alignof__ (struct inotify_event))));
+    gboolean overflow = FALSE;
+    ssize_t length;
+
+    while ((length = read (fd, buffer, sizeof (buffer))) > 0) {
+        char *ptr = buffer;
+
+        while (ptr < buffer + length) {
+            const struct inotify_event *event = (struct inotify_event *) ptr;
+            const char *path = g_hash_table_lookup (
+                self->priv->watches, GINT_TO_POINTER (event->wd)
+            );
+
+            ptr += sizeof (struct inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                overflow = TRUE;
+                continue;
+            }
+
+            if (event->mask & IN_IGNORED) {
+                g_hash_table_remove (
+                    self->priv->watches, GINT_TO_POINTER (event->wd)
+                );
+                continue;
+            }
+
+            if (path == NULL || event->len == 0 || !(event->mask & IN_ISDIR))
+                continue;
+
+            if (event->mask & IN_CREATE)
+                index_cgroup (self, path, event->name);
+            else if (event->mask & IN_DELETE)
+                unindex_cgroup (self, path, event->name);
+        }
+    }
+
+    if (overflow) {
+        g_warning ("cgroups events lost, rebuilding index: %s", self->priv->path);
+        cgroups_rebuild (self);
+    }
+
+    return G_SOURCE_CONTINUE;
+}
+
+static void
+cgroups_dispose (GObject *cgroups)
+{
+    Cgroups *self = CGROUPS (cgroups);
+
+    if (self->priv->inotify_source != NULL) {
+        g_source_destroy (self->priv->inotify_source);
+        g_clear_pointer (&self->priv->inotify_source, g_source_unref);
+    }
+
+    G_OBJECT_CLASS (cgroups_parent_class)->dispose (cgroups);
+}
+
+static void
+cgroups_finalize (GObject *cgroups)
+{
+    Cgroups *self = CGROUPS (cgroups);
+
+    if (self->priv->inotify_fd >= 0)
+        close (self->priv->inotify_fd);
+
+    g_hash_table_destroy (self->priv->watches);
+    g_hash_table_destroy (self->priv->services);
+    g_hash_table_destroy (self->priv->scopes);
+    g_free (self->priv->path);
+
+    G_OBJECT_CLASS (cgroups_parent_class)->finalize (cgroups);
+}
+
+static void
+cgroups_class_init (CgroupsClass *klass)
+{
+    GObjectClass *object_class;
+
+    object_class = G_OBJECT_CLASS (klass);
+    object_class->dispose = cgroups_dispose;
+    object_class->finalize = cgroups_finalize;
+}
+
+static void
+cgroups_init (Cgroups *self)
+{
+    self->priv = cgroups_get_instance_private (self);
+
+    self->priv->path = NULL;
+    self->priv->inotify_source = NULL;
+    self->priv->watches = g_hash_table_new_full (
+        g_direct_hash, g_direct_equal, NULL, g_free
+    );
+    self->priv->services = g_hash_table_new_full (
+        g_str_hash, g_str_equal, g_free, g_free
+    );
+    self->priv->scopes = g_hash_table_new_full (
+        g_str_hash, g_str_equal, g_free, g_free
+    );
+
+    self->priv->inotify_fd = inotify_init1 (IN_NONBLOCK | IN_CLOEXEC);
+    if (self->priv->inotify_fd < 0) {
+        g_warning ("Can't init inotify: %s", g_strerror (errno));
+        return;
+    }
+
+    /* Thread default context: system daemon runs us on a worker */
+    self->priv->inotify_source = g_unix_fd_source_new (
+        self->priv->inotify_fd, G_IO_IN
+    );
+    g_source_set_callback (
+        self->priv->inotify_source,
+        G_SOURCE_FUNC (on_inotify_event),
+        self,
+        NULL
+    );
+    g_source_attach (
+        self->priv->inotify_source, g_main_context_get_thread_default ()
+    );
+}
+
+/**
+ * cgroups_new:
+ *
+ * Creates a new #Cgroups index of slices, services and scopes
+ * found under path
+ *
+ * @path: cgroup directory to index
+ *
+ * Returns: (transfer full): a new #Cgroups
+ *
+ **/
+GObject *
+cgroups_new (const char *path)
+{
+    GObject *cgroups;
+
+    cgroups = g_object_new (TYPE_CGROUPS, NULL);
+
+    CGROUPS (cgroups)->priv->path = g_strdup (path);
+    cgroups_scan (CGROUPS (cgroups), path);
+
+    return cgroups;
+}
+
+static Cgroups *default_system_cgroups = NULL;
+static Cgroups *default_session_cgroups = NULL;
+/**
+ * cgroups_get_default:
+ *
+ * Gets the default #Cgroups: system.slice for G_BUS_TYPE_SYSTEM,
+ * current user manager for G_BUS_TYPE_SESSION.
+ *
+ * @bus_type: cgroups type, as in services_new()
+ *
+ * Return value: (transfer full): the default #Cgroups.
+ */
+Cgroups *
+cgroups_get_default (GBusType bus_type)
+{
+    if (bus_type == G_BUS_TYPE_SESSION) {
+        if (default_session_cgroups == NULL) {
+            g_autofree char *user_dir = g_strdup_printf (
+                CGROUPS_USER_DIR, getuid (), getuid ()
+            );
+            g_autofree char *path = get_root_path (user_dir);
+
+            default_session_cgroups = CGROUPS (cgroups_new (path));
+        }
+        return default_session_cgroups;
+    }
+
+    if (default_system_cgroups == NULL) {
+        g_autofree char *path = get_root_path (CGROUPS_SYSTEM_SERVICES_DIR);
+
+        default_system_cgroups = CGROUPS (cgroups_new (path));
+    }
+    return default_system_cgroups;
+}
+
+/**
+ * cgroups_free_default:
+ *
+ * Free the default #Cgroups.
+ *
+ */
+void
+cgroups_free_default (void)
+{
+    g_clear_object (&default_system_cgroups);
+    g_clear_object (&default_session_cgroups);
+}
+
+/**
+ * cgroups_get_path:
+ *
+ * Get indexed cgroup directory
+ *
+ * @self: a #Cgroups
+ *
+ * Returns: (transfer none): indexed path
+ */
+const char *
+cgroups_get_path (Cgroups *self)
+{
+    return self->priv->path;
+}
+
+/**
+ * cgroups_get_service_dir:
+ *
+ * Get cgroup directory of service
+ *
+ * @self: a #Cgroups
+ * @service: service name, ex: foo.service
+ *
+ * Returns: (transfer none): service directory or NULL
+ */
+const char *
+cgroups_get_service_dir (Cgroups    *self,
+                         const char *service)
+{
+    return g_hash_table_lookup (self->priv->services, service);
+}
+
+/**
+ * cgroups_get_scope_dir:
+ *
+ * Get cgroup directory of scope
+ *
+ * @self: a #Cgroups
+ * @scope: scope name, ex: app-foo-1234.scope
+ *
+ * Returns: (transfer none): scope directory or NULL
+ */
+const char *
+cgroups_get_scope_dir (Cgroups    *self,
+                       const char *scope)
+{
+    return g_hash_table_lookup (self->priv->scopes, scope);
+}
+
+/**
+ * cgroups_get_services:
+ *
+ * Get indexed services
+ *
+ * @self: a #Cgroups
+ *
+ * Returns: (transfer container): services names, free with g_list_free()
+ */
+GList *
+cgroups_get_services (Cgroups *self)
+{
+    return g_hash_table_get_keys (self->priv->services);
+}
+
+/**
+ * cgroups_get_child_services:
+ *
+ * Get indexed services directly under indexed path, services in nested
+ * slices (templates, ex: getty@tty1.service) excluded
+ *
+ * @self: a #Cgroups
+ *
+ * Returns: (transfer container): services names, free with g_list_free()
+ */
+GList *
+cgroups_get_child_services (Cgroups *self)
+{
+    GHashTableIter iter;
+    gpointer service;
+    gpointer cgroup;
+    GList *services = NULL;
+
+    g_hash_table_iter_init (&iter, self->priv->services);
+    while (g_hash_table_iter_next (&iter, &service, &cgroup)) {
+        g_autofree char *parent = g_path_get_dirname (cgroup);
+
+        if (g_strcmp0 (parent, self->priv->path) == 0)
+            services = g_list_prepend (services, service);
+    }
+
+    return services;
+}
+
+/**
+ * cgroups_get_scopes:
+ *
+ * Get indexed scopes
+ *
+ * @self: a #Cgroups
+ *
+ * Returns: (transfer container): scopes names, free with g_list_free()
+ */
+GList *
+cgroups_get_scopes (Cgroups *self)
+{
+    return g_hash_table_get_keys (self->priv->scopes);
+}
@@ -0,0 +1,61 @@
+/*
+ * Copyright Cedric Bellegarde <cedric.bellegarde@adishatz.org>
+ */
+
+#ifndef CGROUPS_H
+#define CGROUPS_H
+
+#include <glib.h>
+#include <glib-object.h>
+#include <gio/gio.h>
+
+#define TYPE_CGROUPS \
+    (cgroups_get_type ())
+#define CGROUPS(obj) \
+    (G_TYPE_CHECK_INSTANCE_CAST \
+    ((obj), TYPE_CGROUPS, Cgroups))
+#define CGROUPS_CLASS(cls) \
+    (G_TYPE_CHECK_CLASS_CAST \
+    ((cls), TYPE_CGROUPS, CgroupsClass))
+#define IS_CGROUPS(obj) \
+    (G_TYPE_CHECK_INSTANCE_TYPE \
+    ((obj), TYPE_CGROUPS))
+#define IS_CGROUPS_CLASS(cls) \
+    (G_TYPE_CHECK_CLASS_TYPE \
+    ((cls), TYPE_CGROUPS))
+#define CGROUPS_GET_CLASS(obj) \
+    (G_TYPE_INSTANCE_GET_CLASS \
+    ((obj), TYPE_CGROUPS, CgroupsClass))
+
+G_BEGIN_DECLS
+
+typedef struct _Cgroups Cgroups;
+typedef struct _CgroupsClass CgroupsClass;
+typedef struct _CgroupsPrivate CgroupsPrivate;
+
+struct _Cgroups {
+    GObject parent;
+    CgroupsPrivate *priv;
+};
+
+struct _CgroupsClass {
+    GObjectClass parent_class;
+};
+
+GType           cgroups_get_type            (void) G_GNUC_CONST;
+
+GObject*        cgroups_new                 (const char *path);
+Cgroups        *cgroups_get_default         (GBusType    bus_type);
+void            cgroups_free_default        (void);
+const char     *cgroups_get_path            (Cgroups    *self);
+const char     *cgroups_get_service_dir     (Cgroups    *self,
+                                             const char *service);
+const char     *cgroups_get_scope_dir       (Cgroups    *self,
+                                             const char *scope);
+GList          *cgroups_get_services        (Cgroups    *self);
+GList          *cgroups_get_child_services  (Cgroups    *self);
+GList          *cgroups_get_scopes          (Cgroups    *self);
+
+G_END_DECLS
+
+#endif
@@ -7,9 +7,14 @@
 
 #define CPUFREQ_POLICIES_DIR "/sys/devices/system/cpu/cpufreq/"
 #define DEVFREQ_DIR "/sys/class/devfreq/"
+#define CGROUPS_DIR "/sys/fs/cgroup"
 #define CGROUPS_USER_DIR "/sys/fs/cgroup/user.slice/user-%d.slice/user@%d.service"
-#define CGROUPS_USER_APPS_DIR "/sys/fs/cgroup/user.slice/user-%d.slice/user@%d.service/app.slice"
 #define CGROUPS_SYSTEM_SERVICES_DIR "/sys/fs/cgroup/system.slice"
+#define SYSTEM_UNIT "mobile-power-saver-system.service"
+/* Below SYSTEM_UNIT cgroup, delegated to us */
+#define FREEZER_CGROUP "/frozen"
+#define RUNTIME_DIR "/run/mobile-power-saver"
+#define CACHE_DIR "/var/cache/mobile-power-saver"
 
 #define DBUS_PROPERTIES_INTERFACE "org.freedesktop.DBus.Properties"
 
@@ -24,9 +29,26 @@ typedef enum {
     CPUSET_BACKGROUND,
     CPUSET_SYSTEM_BACKGROUND,
     CPUSET_FOREGROUND,
-    CPUSET_TOPAPP
+    CPUSET_TOPAPP,
+    CPUSET_LAST
 } CpuSet ;
 
+typedef enum {
+    CPU_CLUSTER_LITTLE,
+    CPU_CLUSTER_MID,
+    CPU_CLUSTER_PRIME,
+    CPU_CLUSTER_LAST
+} CpuCluster;
+
+typedef enum {
+    DOZE_LEVEL_SCREEN_ON,
+    DOZE_LEVEL_SCREEN_OFF,
+    DOZE_LEVEL_LIGHT,
+    DOZE_LEVEL_MEDIUM,
+    DOZE_LEVEL_FULL,
+    DOZE_LEVEL_LAST
+} DozeLevel;
+
 typedef enum {
     MM_MODEM_MODE_NONE = 0,
     MM_MODEM_MODE_CS   = 1 << 0,
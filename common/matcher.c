@@ -0,0 +1,316 @@
+/*
+ * Copyright Cedric Bellegarde <cedric.bellegarde@adishatz.org>
+ */
+
+#include <string.h>
+
+#include "matcher.h"
+#include "utils.h"
+
+/*
+ * Names list compiled once when a setting changes:
+ * - a hash set for exact names (services, scopes, ...)
+ * - an Aho-Corasick automaton for "pattern is a substring of text",
+ *   the g_strrstr() semantics used for cmdlines and app scopes.
+ *
+ * The automaton is a full DFA over byte classes: bytes not used by any
+ * pattern share class 0, so the table stays small and a lookup costs one
+ * read per text byte, whatever the patterns count.
+ */
+
+#define MATCHER_NO_OUTPUT -1
+
+struct _Matcher {
+    GPtrArray *patterns;
+    GHashTable *names;
+
+    guint8 classes[256];
+    guint classes_count;
+    guint *delta;
+    gint *output;
+};
+
+static void
+matcher_clear_automaton (Matcher *self)
+{
+    g_clear_pointer (&self->delta, g_free);
+    g_clear_pointer (&self->output, g_free);
+}
+
+static void
+matcher_compile (Matcher *self)
+{
+    g_autofree guint *fail = NULL;
+    g_autofree guint *queue = NULL;
+    guint states_max = 1;
+    guint states = 1;
+    guint head = 0;
+    guint tail = 0;
+    guint i;
+    guint c;
+
+    matcher_clear_automaton (self);
+    if (self->patterns->len == 0)
+        return;
+
+    memset (self->classes, 0, sizeof (self->classes));
+    self->classes_count = 1;
+
+    for (i = 0; i < self->patterns->len; i++) {
+        const guint8 *pattern = g_ptr_array_index (self->patterns, i);
+
+        for (; *pattern != '\0'; pattern++) {
+            if (self->classes[*pattern] == 0)
+                self->classes[*pattern] = self->classes_count++;
+            states_max++;
+        }
+    }
+
+    self->delta = g_new0 (guint, states_max * self->classes_count);
+    self->output = g_new (gint, states_max);
+    for (i = 0; i < states_max; i++)
+        self->output[i] = MATCHER_NO_OUTPUT;
+
+    /* Trie: 0 is root, so a 0 transition means "no child" for now */
+    for (i = 0; i < self->patterns->len; i++) {
+        const guint8 *pattern = g_ptr_array_index (self->patterns, i);
+        guint state = 0;
+
+        for (; *pattern != '\0'; pattern++) {
+            guint *next = &self->delta[
+                state * self->classes_count + self->classes[*pattern]
+            ];
+
+            if (*next == 0)
+                *next = states++;
+            state = *next;
+        }
+
+        if (self->output[state] == MATCHER_NO_OUTPUT)
+            self->output[state] = i;
+    }
+
+    /* Breadth first: failure links, then missing transitions */
+    fail = g_new0 (guint, states);
+    queue = g_new (guint, states);
+
+    for (c = 1; c < self->classes_count; c++) {
+        guint next = self->delta[c];
+
+        if (next != 0)
+            queue[tail++] = next;
+    }
+
+    while (head < tail) {
+        guint state = queue[head++];
+
+        if (self->output[state] == MATCHER_NO_OUTPUT)
+            self->output[state] = self->output[fail[state]];
+
+        for (c = 1; c < self->classes_count; c++) {
+            guint *next = &self->delta[state * self->classes_count + c];
+            guint fallback = self->delta[fail[state] * self->classes_count + c];
+
+            if (*next != 0) {
+                fail[*next] = fallback;
+                queue[tail++] = *next;
+            } else {
+                *next = fallback;
+            }
+        }
+    }
+}
+
+static gboolean
+matcher_insert (Matcher    *self,
+                const char *pattern)
+{
+    char *copy;
+
+    if (g_hash_table_contains (self->names, pattern))
+        return FALSE;
+
+    copy = g_strdup (pattern);
+    g_ptr_array_add (self->patterns, copy);
+    g_hash_table_add (self->names, copy);
+
+    return TRUE;
+}
+
+/**
+ * matcher_new:
+ *
+ * Creates a new empty #Matcher
+ *
+ * Returns: (transfer full): a new #Matcher
+ */
+Matcher *
+matcher_new (void)
+{
+    Matcher *self = g_new0 (Matcher, 1);
+
+    self->patterns = g_ptr_array_new_with_free_func (g_free);
+    self->names = g_hash_table_new (g_str_hash, g_str_equal);
+
+    return self;
+}
+
+/**
+ * matcher_new_from_list:
+ *
+ * Creates a new #Matcher from a strings list
+ *
+ * @patterns: strings list
+ *
+ * Returns: (transfer full): a new #Matcher
+ */
+Matcher *
+matcher_new_from_list (GList *patterns)
+{
+    Matcher *self = matcher_new ();
+    const char *pattern;
+
+    GFOREACH (patterns, pattern)
+        matcher_insert (self, pattern);
+    matcher_compile (self);
+
+    return self;
+}
+
+/**
+ * matcher_new_from_variant:
+ *
+ * Creates a new #Matcher from a strings array variant
+ *
+ * @value: a "as" #GVariant
+ *
+ * Returns: (transfer full): a new #Matcher
+ */
+Matcher *
+matcher_new_from_variant (GVariant *value)
+{
+    Matcher *self = matcher_new ();
+    g_autoptr (GVariantIter) iter = NULL;
+    const char *pattern;
+
+    g_variant_get (value, "as", &iter);
+    while (g_variant_iter_loop (iter, "s", &pattern))
+        matcher_insert (self, pattern);
+    matcher_compile (self);
+
+    return self;
+}
+
+/**
+ * matcher_add:
+ *
+ * Add a pattern to matcher. Automaton is rebuilt: matchers are searched
+ * from the transitions worker, they must not be changed once shared.
+ *
+ * @self: a #Matcher
+ * @pattern: a name
+ */
+void
+matcher_add (Matcher    *self,
+             const char *pattern)
+{
+    if (matcher_insert (self, pattern))
+        matcher_compile (self);
+}
+
+/**
+ * matcher_length:
+ *
+ * @self: a #Matcher
+ *
+ * Returns: patterns count
+ */
+guint
+matcher_length (Matcher *self)
+{
+    return self->patterns->len;
+}
+
+/**
+ * matcher_contains:
+ *
+ * Check if name is one of the patterns
+ *
+ * @self: a #Matcher
+ * @name: a name
+ *
+ * Returns: TRUE if name exactly matches a pattern
+ */
+gboolean
+matcher_contains (Matcher    *self,
+                  const char *name)
+{
+    return g_hash_table_contains (self->names, name);
+}
+
+/**
+ * matcher_search:
+ *
+ * Search for a pattern in text
+ *
+ * @self: a #Matcher
+ * @text: text to search in
+ *
+ * Returns: (transfer none): first pattern found in text or NULL
+ */
+const char *
+matcher_search (Matcher    *self,
+                const char *text)
+{
+    const guint8 *ptr = (const guint8 *) text;
+    guint state = 0;
+
+    if (self->patterns->len == 0)
+        return NULL;
+
+    /* An empty pattern matches anything, as g_strrstr() does */
+    if (self->output[0] != MATCHER_NO_OUTPUT)
+        return g_ptr_array_index (self->patterns, self->output[0]);
+
+    for (; *ptr != '\0'; ptr++) {
+        state = self->delta[state * self->classes_count + self->classes[*ptr]];
+
+        if (self->output[state] != MATCHER_NO_OUTPUT)
+            return g_ptr_array_index (self->patterns, self->output[state]);
+    }
+
+    return NULL;
+}
+
+/**
+ * matcher_match:
+ *
+ * Check if any pattern is found in text
+ *
+ * @self: a #Matcher
+ * @text: text to search in
+ *
+ * Returns: TRUE if a pattern is a substring of text
+ */
+gboolean
+matcher_match (Matcher    *self,
+               const char *text)
+{
+    return matcher_search (self, text) != NULL;
+}
+
+/**
+ * matcher_free:
+ *
+ * Free matcher
+ *
+ * @self: a #Matcher
+ */
+void
+matcher_free (Matcher *self)
+{
+    matcher_clear_automaton (self);
+    g_hash_table_destroy (self->names);
+    g_ptr_array_free (self->patterns, TRUE);
+    g_free (self);
+}
@@ -0,0 +1,32 @@
+/*
+ * Copyright Cedric Bellegarde <cedric.bellegarde@adishatz.org>
+ */
+
+#ifndef MATCHER_H
+#define MATCHER_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _Matcher Matcher;
+
+Matcher        *matcher_new                (void);
+Matcher        *matcher_new_from_list      (GList      *patterns);
+Matcher        *matcher_new_from_variant   (GVariant   *value);
+void            matcher_add                (Matcher    *self,
+                                            const char *pattern);
+guint           matcher_length             (Matcher    *self);
+gboolean        matcher_contains           (Matcher    *self,
+                                            const char *name);
+const char     *matcher_search             (Matcher    *self,
+                                            const char *text);
+gboolean        matcher_match              (Matcher    *self,
+                                            const char *text);
+void            matcher_free               (Matcher    *self);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (Matcher, matcher_free)
+
+G_END_DECLS
+
+#endif
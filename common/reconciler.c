@@ -0,0 +1,454 @@
+/*
+ * Copyright Cedric Bellegarde <cedric.bellegarde@adishatz.org>
+ */
+
+#include <stdio.h>
+#include <stdarg.h>
+
+#include <gio/gio.h>
+
+#include "reconciler.h"
+#include "writer.h"
+
+#define RECONCILER_VALUE_SIZE 256
+
+/*
+ * While the journal is open, first write to a path records its previous
+ * value: replaying it restores state without recomputing it.
+ */
+
+typedef struct {
+    char *path;
+    char *value;
+} JournalEntry;
+
+struct _ReconcilerPrivate {
+    GHashTable *applied;
+
+    gboolean journal_open;
+    ReconcilerPriority priority;
+    GHashTable *journaled;
+    GQueue journal[RECONCILER_PRIORITY_LAST];
+};
+
+G_DEFINE_TYPE_WITH_CODE (
+    Reconciler,
+    reconciler,
+    G_TYPE_OBJECT,
+    G_ADD_PRIVATE (Reconciler)
+)
+
+static void
+journal_entry_free (gpointer user_data)
+{
+    JournalEntry *entry = user_data;
+
+    g_free (entry->path);
+    g_free (entry->value);
+    g_free (entry);
+}
+
+static void
+journal_clear (Reconciler         *self,
+               ReconcilerPriority  priority)
+{
+    JournalEntry *entry;
+
+    while ((entry = g_queue_pop_head (&self->priv->journal[priority])) != NULL) {
+        g_hash_table_remove (self->priv->journaled, entry->path);
+        journal_entry_free (entry);
+    }
+}
+
+static void
+journal_record (Reconciler *self,
+                const char *path,
+                const char *current)
+{
+    char buffer[RECONCILER_VALUE_SIZE];
+    JournalEntry *entry;
+
+    if (!self->priv->journal_open ||
+            self->priv->priority == RECONCILER_PRIORITY_NONE ||
+            g_hash_table_contains (self->priv->journaled, path))
+        return;
+
+    if (current == NULL)
+        current = g_hash_table_lookup (self->priv->applied, path);
+    if (current == NULL) {
+        if (writer_read (writer_get_default (), path, buffer, sizeof (buffer)) != 0)
+            return;
+        current = buffer;
+    }
+
+    entry = g_new (JournalEntry, 1);
+    entry->path = g_strdup (path);
+    entry->value = g_strdup (current);
+
+    /* Undo in reverse order, keeps min <= max on frequencies */
+    g_queue_push_head (&self->priv->journal[self->priv->priority], entry);
+    g_hash_table_add (self->priv->journaled, entry->path);
+}
+
+static gboolean
+is_applied (Reconciler *self,
+            const char *path,
+            const char *value,
+            gboolean    owned,
+            char       *current)
+{
+    current[0] = '\0';
+
+    /* We are the only writer: trust what we applied last */
+    if (owned)
+        return g_strcmp0 (
+            g_hash_table_lookup (self->priv->applied, path), value
+        ) == 0;
+
+    /* Someone else may have changed it: ask the kernel */
+    if (writer_read (writer_get_default (), path, current, RECONCILER_VALUE_SIZE) != 0) {
+        current[0] = '\0';
+        return FALSE;
+    }
+
+    return g_strcmp0 (current, value) == 0;
+}
+
+static void
+reconciler_dispose (GObject *reconciler)
+{
+    G_OBJECT_CLASS (reconciler_parent_class)->dispose (reconciler);
+}
+
+static void
+reconciler_finalize (GObject *reconciler)
+{
+    Reconciler *self = RECONCILER (reconciler);
+    ReconcilerPriority priority;
+
+    for (priority = 0; priority < RECONCILER_PRIORITY_LAST; priority++)
+        journal_clear (self, priority);
+    g_hash_table_destroy (self->priv->journaled);
+    g_hash_table_destroy (self->priv->applied);
+
+    G_OBJECT_CLASS (reconciler_parent_class)->finalize (reconciler);
+}
+
+static void
+reconciler_class_init (ReconcilerClass *klass)
+{
+    GObjectClass *object_class;
+
+    object_class = G_OBJECT_CLASS (klass);
+    object_class->dispose = reconciler_dispose;
+    object_class->finalize = reconciler_finalize;
+}
+
+static void
+reconciler_init (Reconciler *self)
+{
+    ReconcilerPriority priority;
+
+    self->priv = reconciler_get_instance_private (self);
+
+    self->priv->applied = reconciler_state_new ();
+    self->priv->journal_open = FALSE;
+    self->priv->priority = RECONCILER_PRIORITY_NONE;
+    self->priv->journaled = g_hash_table_new (g_str_hash, g_str_equal);
+    for (priority = 0; priority < RECONCILER_PRIORITY_LAST; priority++)
+        g_queue_init (&self->priv->journal[priority]);
+}
+
+/**
+ * reconciler_new:
+ *
+ * Creates a new #Reconciler
+ *
+ * Returns: (transfer full): a new #Reconciler
+ *
+ **/
+GObject *
+reconciler_new (void)
+{
+    GObject *reconciler;
+
+    reconciler = g_object_new (TYPE_RECONCILER, NULL);
+
+    return reconciler;
+}
+
+static Reconciler *default_reconciler = NULL;
+/**
+ * reconciler_get_default:
+ *
+ * Gets the default #Reconciler.
+ *
+ * Return value: (transfer full): the default #Reconciler.
+ */
+Reconciler *
+reconciler_get_default (void)
+{
+    if (default_reconciler == NULL) {
+        default_reconciler = RECONCILER (reconciler_new ());
+    }
+    return default_reconciler;
+}
+
+/**
+ * reconciler_free_default:
+ *
+ * Free the default #Reconciler.
+ *
+ */
+void
+reconciler_free_default (void)
+{
+    if (default_reconciler != NULL) {
+        g_clear_object (&default_reconciler);
+        default_reconciler = NULL;
+    }
+}
+
+/**
+ * reconciler_state_new:
+ *
+ * Creates a new desired state: path -> value
+ *
+ * Returns: (transfer full): a new #GHashTable
+ */
+GHashTable *
+reconciler_state_new (void)
+{
+    return g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+}
+
+/**
+ * reconciler_state_add:
+ *
+ * Add a value to desired state
+ *
+ * @state: desired state
+ * @path: file to write
+ * @value: value to write
+ */
+void
+reconciler_state_add (GHashTable *state,
+                      const char *path,
+                      const char *value)
+{
+    g_hash_table_replace (state, g_strdup (path), g_strdup (value));
+}
+
+/**
+ * reconciler_apply:
+ *
+ * Write values from desired state that differ from current state
+ *
+ * @self: a #Reconciler
+ * @desired: desired state, see reconciler_state_new()
+ * @owned: TRUE if only us write these paths, current values are then
+ *         not read back from kernel
+ *
+ * Returns: writes count
+ */
+guint
+reconciler_apply (Reconciler *self,
+                  GHashTable *desired,
+                  gboolean    owned)
+{
+    g_autoptr (WriterBatch) batch = writer_batch_new ();
+    g_autoptr (GPtrArray) paths = g_ptr_array_new ();
+    char current[RECONCILER_VALUE_SIZE];
+    GHashTableIter iter;
+    gpointer path;
+    gpointer value;
+    guint i;
+
+    g_hash_table_iter_init (&iter, desired);
+    while (g_hash_table_iter_next (&iter, &path, &value)) {
+        if (is_applied (self, path, value, owned, current)) {
+            g_hash_table_replace (
+                self->priv->applied, g_strdup (path), g_strdup (value)
+            );
+            continue;
+        }
+
+        journal_record (self, path, current[0] != '\0' ? current : NULL);
+        writer_batch_add (batch, path, value);
+        g_ptr_array_add (paths, path);
+    }
+
+    if (paths->len == 0)
+        return 0;
+
+    writer_batch_submit (writer_get_default (), batch);
+
+    for (i = 0; i < paths->len; i++) {
+        const char *updated = g_ptr_array_index (paths, i);
+
+        if (writer_batch_get_error (batch, i) == 0)
+            g_hash_table_replace (
+                self->priv->applied,
+                g_strdup (updated),
+                g_strdup (g_hash_table_lookup (desired, updated))
+            );
+        else
+            g_hash_table_remove (self->priv->applied, updated);
+    }
+
+    return paths->len;
+}
+
+/**
+ * reconciler_set:
+ *
+ * Write value to path if it differs from current value
+ *
+ * @self: a #Reconciler
+ * @path: file to write
+ * @value: value to write
+ * @owned: TRUE if only us write this path
+ *
+ * Returns: 0 on success or if already applied, errno otherwise
+ */
+gint
+reconciler_set (Reconciler *self,
+                const char *path,
+                const char *value,
+                gboolean    owned)
+{
+    char current[RECONCILER_VALUE_SIZE];
+    gint error = 0;
+
+    if (!is_applied (self, path, value, owned, current)) {
+        journal_record (self, path, current[0] != '\0' ? current : NULL);
+        error = writer_write (writer_get_default (), path, value);
+    }
+
+    if (error == 0)
+        g_hash_table_replace (
+            self->priv->applied, g_strdup (path), g_strdup (value)
+        );
+    else
+        g_hash_table_remove (self->priv->applied, path);
+
+    return error;
+}
+
+/**
+ * reconciler_forget:
+ *
+ * Forget last applied value for path
+ *
+ * @self: a #Reconciler
+ * @path: file
+ */
+void
+reconciler_forget (Reconciler *self,
+                   const char *path)
+{
+    g_hash_table_remove (self->priv->applied, path);
+}
+
+/**
+ * reconciler_journal_open:
+ *
+ * Start recording previous values of journaled writes, see
+ * reconciler_journal_set_priority(). First write to a path wins.
+ *
+ * @self: a #Reconciler
+ */
+void
+reconciler_journal_open (Reconciler *self)
+{
+    self->priv->journal_open = TRUE;
+}
+
+/**
+ * reconciler_journal_is_open:
+ *
+ * Check if journal is recording
+ *
+ * @self: a #Reconciler
+ *
+ * Returns: TRUE if open
+ */
+gboolean
+reconciler_journal_is_open (Reconciler *self)
+{
+    return self->priv->journal_open;
+}
+
+/**
+ * reconciler_journal_set_priority:
+ *
+ * Journal next writes with priority, until reset to
+ * RECONCILER_PRIORITY_NONE
+ *
+ * @self: a #Reconciler
+ * @priority: a #ReconcilerPriority
+ */
+void
+reconciler_journal_set_priority (Reconciler         *self,
+                                 ReconcilerPriority  priority)
+{
+    g_return_if_fail (priority < RECONCILER_PRIORITY_LAST);
+
+    self->priv->priority = priority;
+}
+
+/**
+ * reconciler_journal_replay:
+ *
+ * Restore previous values journaled with priority, then drop them
+ *
+ * @self: a #Reconciler
+ * @priority: a #ReconcilerPriority
+ *
+ * Returns: writes count
+ */
+guint
+reconciler_journal_replay (Reconciler         *self,
+                           ReconcilerPriority  priority)
+{
+    JournalEntry *entry;
+    GList *item;
+    guint count = 0;
+
+    g_return_val_if_fail (priority < RECONCILER_PRIORITY_LAST, 0);
+
+    for (item = self->priv->journal[priority].head; item != NULL; item = item->next) {
+        entry = item->data;
+
+        if (writer_write (writer_get_default (), entry->path, entry->value) == 0)
+            g_hash_table_replace (
+                self->priv->applied,
+                g_strdup (entry->path),
+                g_strdup (entry->value)
+            );
+        else
+            g_hash_table_remove (self->priv->applied, entry->path);
+        count++;
+    }
+
+    journal_clear (self, priority);
+
+    return count;
+}
+
+/**
+ * reconciler_journal_close:
+ *
+ * Stop recording and drop journal not replayed
+ *
+ * @self: a #Reconciler
+ */
+void
+reconciler_journal_close (Reconciler *self)
+{
+    ReconcilerPriority priority;
+
+    self->priv->journal_open = FALSE;
+    for (priority = 0; priority < RECONCILER_PRIORITY_LAST; priority++)
+        journal_clear (self, priority);
+}
@@ -0,0 +1,82 @@
+/*
+ * Copyright Cedric Bellegarde <cedric.bellegarde@adishatz.org>
+ */
+
+#ifndef RECONCILER_H
+#define RECONCILER_H
+
+#include <glib.h>
+#include <glib-object.h>
+
+#define TYPE_RECONCILER \
+    (reconciler_get_type ())
+#define RECONCILER(obj) \
+    (G_TYPE_CHECK_INSTANCE_CAST \
+    ((obj), TYPE_RECONCILER, Reconciler))
+#define RECONCILER_CLASS(cls) \
+    (G_TYPE_CHECK_CLASS_CAST \
+    ((cls), TYPE_RECONCILER, ReconcilerClass))
+#define IS_RECONCILER(obj) \
+    (G_TYPE_CHECK_INSTANCE_TYPE \
+    ((obj), TYPE_RECONCILER))
+#define IS_RECONCILER_CLASS(cls) \
+    (G_TYPE_CHECK_CLASS_TYPE \
+    ((cls), TYPE_RECONCILER))
+#define RECONCILER_GET_CLASS(obj) \
+    (G_TYPE_INSTANCE_GET_CLASS \
+    ((obj), TYPE_RECONCILER, ReconcilerClass))
+
+G_BEGIN_DECLS
+
+/* Undo journal replay order, on screen on */
+typedef enum {
+    RECONCILER_PRIORITY_NONE,
+    RECONCILER_PRIORITY_CPUFREQ,
+    RECONCILER_PRIORITY_DEVFREQ,
+    RECONCILER_PRIORITY_KERNEL,
+    RECONCILER_PRIORITY_DEFERRED,
+    RECONCILER_PRIORITY_LAST
+} ReconcilerPriority;
+
+typedef struct _Reconciler Reconciler;
+typedef struct _ReconcilerClass ReconcilerClass;
+typedef struct _ReconcilerPrivate ReconcilerPrivate;
+
+struct _Reconciler {
+    GObject parent;
+    ReconcilerPrivate *priv;
+};
+
+struct _ReconcilerClass {
+    GObjectClass parent_class;
+};
+
+GType           reconciler_get_type            (void) G_GNUC_CONST;
+
+GObject*        reconciler_new                 (void);
+Reconciler     *reconciler_get_default         (void);
+void            reconciler_free_default        (void);
+GHashTable     *reconciler_state_new           (void);
+void            reconciler_state_add           (GHashTable *state,
+                                                const char *path,
+                                                const char *value);
+guint           reconciler_apply               (Reconciler *self,
+                                                GHashTable *desired,
+                                                gboolean    owned);
+gint            reconciler_set                 (Reconciler *self,
+                                                const char *path,
+                                                const char *value,
+                                                gboolean    owned);
+void            reconciler_forget              (Reconciler *self,
+                                                const char *path);
+void            reconciler_journal_open        (Reconciler *self);
+gboolean        reconciler_journal_is_open     (Reconciler *self);
+void            reconciler_journal_set_priority (Reconciler         *self,
+                                                 ReconcilerPriority  priority);
+guint           reconciler_journal_replay      (Reconciler         *self,
+                                                ReconcilerPriority  priority);
+void            reconciler_journal_close       (Reconciler *self);
+
+G_END_DECLS
+
+#endif
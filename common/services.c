@@ -9,11 +9,14 @@
 
 #include "bus.h"
 #include "services.h"
+#include "../common/cgroups.h"
 #include "../common/define.h"
+#include "../common/reconciler.h"
 #include "../common/utils.h"
 
 struct _ServicesPrivate {
-    GBusType service_type;
+    Cgroups *cgroups;
+    gboolean nested;
 };
 
 G_DEFINE_TYPE_WITH_CODE (
@@ -23,66 +26,51 @@ G_DEFINE_TYPE_WITH_CODE (
     G_ADD_PRIVATE (Services)
 )
 
-static GList *
-get_cgroups_paths (Services *self)
-{
-    GList *paths = NULL;
-
-    if (self->priv->service_type == G_BUS_TYPE_SESSION) {
-        paths = get_cgroup_slices (
-            g_strdup_printf(
-                CGROUPS_USER_DIR, getuid(), getuid()
-            )
-        );
-    } else {
-        paths = g_list_append (
-            paths,
-            g_strdup (CGROUPS_SYSTEM_SERVICES_DIR)
-        );
-    }
-
-    return paths;
-}
-
 static void
 services_set_service_freeze_state (Services   *self,
-                                   const char *path,
                                    const char *service,
                                    const char *state)
 {
+    const char *path = cgroups_get_service_dir (self->priv->cgroups, service);
     g_autofree char *filename = NULL;
 
-    filename = g_build_filename (
-        path, service, "cgroup.freeze", NULL
-    );
+    if (path == NULL)
+        return;
+
+    filename = g_build_filename (path, "cgroup.freeze", NULL);
 
-    if (g_file_test (filename, G_FILE_TEST_EXISTS))
-        write_to_file (filename, state);
+    /*
+     * A restarted service gets a new cgroup with a fresh cgroup.freeze,
+     * always compare against the file content
+     */
+    reconciler_set (reconciler_get_default (), filename, state, FALSE);
 }
 
 static void
 services_set_services_freeze_state (Services   *self,
-                                    GList      *blacklist,
+                                    Matcher    *blacklist,
                                     const char *state)
 {
-    GList *paths = get_cgroups_paths (self);
-    const char *path;
+    GList *services;
     const char *service;
 
-    GFOREACH (paths, path) {
-        GList *services = get_cgroup_services (path);
+    /*
+     * System services in nested slices are template instances (lxc@,
+     * getty@, ...): telephony may depend on them, only freeze them
+     * explicitly. User services all live in nested slices.
+     */
+    if (self->priv->nested)
+        services = cgroups_get_services (self->priv->cgroups);
+    else
+        services = cgroups_get_child_services (self->priv->cgroups);
 
-        GFOREACH_SUB (services, service) {
-            g_autofree char *filename = NULL;
-
-            if (in_list (blacklist, service))
-                continue;
+    GFOREACH (services, service) {
+        if (matcher_contains (blacklist, service))
+            continue;
 
-            services_set_service_freeze_state (self, path, service, state);
-        }
-        g_list_free_full (services, g_free);
+        services_set_service_freeze_state (self, service, state);
     }
-    g_list_free_full (paths, g_free);
+    g_list_free (services);
 }
 
 static void
@@ -94,6 +82,10 @@ services_dispose (GObject *services)
 static void
 services_finalize (GObject *services)
 {
+    Services *self = SERVICES (services);
+
+    g_object_unref (self->priv->cgroups);
+
     G_OBJECT_CLASS (services_parent_class)->finalize (services);
 }
 
@@ -131,7 +123,10 @@ services_new (GBusType service_type)
 
     services = g_object_new (TYPE_SERVICES, NULL);
 
-    SERVICES (services)->priv->service_type = service_type;
+    SERVICES (services)->priv->cgroups = g_object_ref (
+        cgroups_get_default (service_type)
+    );
+    SERVICES (services)->priv->nested = service_type == G_BUS_TYPE_SESSION;
 
     return services;
 }
@@ -149,17 +144,10 @@ void
 services_freeze (Services *self,
                  GList    *services)
 {
-    GList *paths = get_cgroups_paths (self);
     const char *service;
-    const char *path;
 
-    GFOREACH (services, service) {
-        GFOREACH_SUB (paths, path) {
-            services_set_service_freeze_state (self, path, service, "1");
-        }
-    }
-
-    g_list_free_full (paths, g_free);
+    GFOREACH (services, service)
+        services_set_service_freeze_state (self, service, "1");
 }
 
 /**
@@ -175,17 +163,10 @@ void
 services_unfreeze (Services *self,
                    GList   *services)
 {
-    GList *paths = get_cgroups_paths (self);
     const char *service;
-    const char *path;
-
-    GFOREACH (services, service) {
-        GFOREACH_SUB (paths, path) {
-            services_set_service_freeze_state (self, path, service, "0");
-        }
-    }
 
-    g_list_free_full (paths, g_free);
+    GFOREACH (services, service)
+        services_set_service_freeze_state (self, service, "0");
 }
 
 /**
@@ -199,7 +180,7 @@ services_unfreeze (Services *self,
  **/
 void
 services_freeze_all (Services *self,
-                     GList    *blacklist)
+                     Matcher  *blacklist)
 {
     services_set_services_freeze_state (self, blacklist, "1");
 }
@@ -215,7 +196,7 @@ services_freeze_all (Services *self,
  **/
 void
 services_unfreeze_all (Services *self,
-                       GList    *blacklist)
+                       Matcher  *blacklist)
 {
     services_set_services_freeze_state (self, blacklist, "0");
 }
\ No newline at end of file
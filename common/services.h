@@ -8,6 +8,8 @@
 #include <glib.h>
 #include <glib-object.h>
 
+#include "matcher.h"
+
 #define TYPE_SERVICES \
     (services_get_type ())
 #define SERVICES(obj) \
@@ -49,9 +51,9 @@ void            services_freeze              (Services *self,
 void            services_unfreeze            (Services *self,
                                               GList   *services);
 void            services_freeze_all          (Services *self,
-                                              GList   *blacklist);
+                                              Matcher *blacklist);
 void            services_unfreeze_all        (Services *self,
-                                              GList   *blacklist);
+                                              Matcher *blacklist);
 G_END_DECLS
 
 #endif
@@ -0,0 +1,258 @@
+/*
+ * Copyright Cedric Bellegarde <cedric.bellegarde@adishatz.org>
+ */
+
+#include <gio/gio.h>
+
+#include "throttle.h"
+#include "units.h"
+#include "utils.h"
+
+#define BLOCK_DIR "/sys/block"
+
+/*
+ * While dozing, background services I/O is weighted down and may be
+ * capped on each storage device: fewer requests mean fewer eMMC/UFS
+ * power state exits.
+ *
+ * Limits are unit properties, set through the systemd instance owning
+ * the services: it enables the io controller and picks io.weight or
+ * io.bfq.weight. Units own limits are saved before and given back.
+ */
+
+/* IOWeight=: t, others: a(st) of device node and value */
+static const char *io_properties[] = {
+    "IOWeight",
+    "IOReadIOPSMax",
+    "IOWriteIOPSMax",
+    "IOReadBandwidthMax",
+    "IOWriteBandwidthMax",
+    NULL
+};
+
+struct _ThrottlePrivate {
+    Units *units;
+    /* Storage device nodes */
+    GList *devices;
+
+    guint limits[THROTTLE_LAST];
+};
+
+G_DEFINE_TYPE_WITH_CODE (
+    Throttle,
+    throttle,
+    G_TYPE_OBJECT,
+    G_ADD_PRIVATE (Throttle)
+)
+
+static void
+detect_devices (Throttle *self)
+{
+    g_autofree char *block_dir = get_root_path (BLOCK_DIR);
+    g_autoptr (GDir) dir = g_dir_open (block_dir, 0, NULL);
+    const char *name;
+
+    if (dir == NULL)
+        return;
+
+    while ((name = g_dir_read_name (dir)) != NULL) {
+        g_autofree char *device = g_build_filename (
+            block_dir, name, "device", NULL
+        );
+
+        /* loop, ram, zram and dm have no backing device */
+        if (!g_file_test (device, G_FILE_TEST_EXISTS))
+            continue;
+
+        g_message ("I/O throttling on %s", name);
+        self->priv->devices = g_list_prepend (
+            self->priv->devices, g_build_filename ("/dev", name, NULL)
+        );
+    }
+}
+
+static GVariant *
+get_device_limits (Throttle *self,
+                   guint64   value)
+{
+    GVariantBuilder builder;
+    const char *device;
+
+    g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(st)"));
+    GFOREACH (self->priv->devices, device)
+        g_variant_builder_add (&builder, "(st)", device, value);
+
+    return g_variant_builder_end (&builder);
+}
+
+static GVariant *
+get_limits (Throttle *self)
+{
+    GVariantBuilder builder;
+    guint iops = self->priv->limits[THROTTLE_IOPS];
+    guint64 bandwidth = (guint64) self->priv->limits[THROTTLE_BANDWIDTH] * 1024;
+
+    g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(sv)"));
+    g_variant_builder_add (
+        &builder,
+        "(sv)",
+        "IOWeight",
+        g_variant_new_uint64 (MAX (self->priv->limits[THROTTLE_WEIGHT], 1))
+    );
+
+    /* 0 means no limit */
+    if (iops > 0) {
+        g_variant_builder_add (
+            &builder, "(sv)", "IOReadIOPSMax", get_device_limits (self, iops)
+        );
+        g_variant_builder_add (
+            &builder, "(sv)", "IOWriteIOPSMax", get_device_limits (self, iops)
+        );
+    }
+    if (bandwidth > 0) {
+        g_variant_builder_add (
+            &builder,
+            "(sv)",
+            "IOReadBandwidthMax",
+            get_device_limits (self, bandwidth)
+        );
+        g_variant_builder_add (
+            &builder,
+            "(sv)",
+            "IOWriteBandwidthMax",
+            get_device_limits (self, bandwidth)
+        );
+    }
+
+    return g_variant_builder_end (&builder);
+}
+
+static void
+throttle_dispose (GObject *throttle)
+{
+    Throttle *self = THROTTLE (throttle);
+
+    g_clear_object (&self->priv->units);
+
+    G_OBJECT_CLASS (throttle_parent_class)->dispose (throttle);
+}
+
+static void
+throttle_finalize (GObject *throttle)
+{
+    Throttle *self = THROTTLE (throttle);
+
+    g_list_free_full (self->priv->devices, g_free);
+
+    G_OBJECT_CLASS (throttle_parent_class)->finalize (throttle);
+}
+
+static void
+throttle_class_init (ThrottleClass *klass)
+{
+    GObjectClass *object_class;
+
+    object_class = G_OBJECT_CLASS (klass);
+    object_class->dispose = throttle_dispose;
+    object_class->finalize = throttle_finalize;
+}
+
+static void
+throttle_init (Throttle *self)
+{
+    self->priv = throttle_get_instance_private (self);
+
+    self->priv->units = NULL;
+    self->priv->devices = NULL;
+    self->priv->limits[THROTTLE_WEIGHT] = 100;
+    self->priv->limits[THROTTLE_IOPS] = 0;
+    self->priv->limits[THROTTLE_BANDWIDTH] = 0;
+
+    detect_devices (self);
+}
+
+/**
+ * throttle_new:
+ *
+ * Creates a new #Throttle
+ *
+ * @param #GBusType: systemd instance owning services, system or user
+ *
+ * Returns: (transfer full): a new #Throttle
+ *
+ **/
+GObject *
+throttle_new (GBusType bus_type)
+{
+    GObject *throttle;
+
+    throttle = g_object_new (TYPE_THROTTLE, NULL);
+    THROTTLE (throttle)->priv->units = g_object_ref (
+        units_get_default (bus_type)
+    );
+
+    return throttle;
+}
+
+/**
+ * throttle_set_limit:
+ *
+ * Set a limit applied to throttled cgroups, on next throttle_cgroups()
+ *
+ * @self: a #Throttle
+ * @limit: a #ThrottleLimit
+ * @value: IOWeight= (1-10000), IOPS or bandwidth in KiB/s, 0 for no limit
+ */
+void
+throttle_set_limit (Throttle      *self,
+                    ThrottleLimit  limit,
+                    guint          value)
+{
+    g_return_if_fail (limit < THROTTLE_LAST);
+
+    self->priv->limits[limit] = value;
+}
+
+/**
+ * throttle_cgroups:
+ *
+ * Throttle I/O of services, until throttle_restore()
+ *
+ * @self: a #Throttle
+ * @cgroups: services index, of throttle systemd instance
+ * @blacklist: services to leave alone
+ */
+void
+throttle_cgroups (Throttle *self,
+                  Cgroups  *cgroups,
+                  Matcher  *blacklist)
+{
+    GList *services = cgroups_get_services (cgroups);
+    const char *service;
+
+    GFOREACH (services, service) {
+        if (matcher_contains (blacklist, service))
+            continue;
+
+        /* Don't change what we can't give back */
+        if (!units_save_properties (self->priv->units, service, io_properties))
+            continue;
+
+        units_set_properties (self->priv->units, service, get_limits (self));
+    }
+    g_list_free (services);
+}
+
+/**
+ * throttle_restore:
+ *
+ * Give back their own I/O weight and limits to throttled services, even
+ * those throttled by a previous instance
+ *
+ * @self: a #Throttle
+ */
+void
+throttle_restore (Throttle *self)
+{
+    units_restore_all_properties (self->priv->units, io_properties);
+}
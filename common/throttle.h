@@ -0,0 +1,68 @@
+/*
+ * Copyright Cedric Bellegarde <cedric.bellegarde@adishatz.org>
+ */
+
+#ifndef THROTTLE_H
+#define THROTTLE_H
+
+#include <glib.h>
+#include <glib-object.h>
+#include <gio/gio.h>
+
+#include "cgroups.h"
+#include "matcher.h"
+
+#define TYPE_THROTTLE \
+    (throttle_get_type ())
+#define THROTTLE(obj) \
+    (G_TYPE_CHECK_INSTANCE_CAST \
+    ((obj), TYPE_THROTTLE, Throttle))
+#define THROTTLE_CLASS(cls) \
+    (G_TYPE_CHECK_CLASS_CAST \
+    ((cls), TYPE_THROTTLE, ThrottleClass))
+#define IS_THROTTLE(obj) \
+    (G_TYPE_CHECK_INSTANCE_TYPE \
+    ((obj), TYPE_THROTTLE))
+#define IS_THROTTLE_CLASS(cls) \
+    (G_TYPE_CHECK_CLASS_TYPE \
+    ((cls), TYPE_THROTTLE))
+#define THROTTLE_GET_CLASS(obj) \
+    (G_TYPE_INSTANCE_GET_CLASS \
+    ((obj), TYPE_THROTTLE, ThrottleClass))
+
+G_BEGIN_DECLS
+
+typedef enum {
+    THROTTLE_WEIGHT,
+    THROTTLE_IOPS,
+    THROTTLE_BANDWIDTH,
+    THROTTLE_LAST
+} ThrottleLimit;
+
+typedef struct _Throttle Throttle;
+typedef struct _ThrottleClass ThrottleClass;
+typedef struct _ThrottlePrivate ThrottlePrivate;
+
+struct _Throttle {
+    GObject parent;
+    ThrottlePrivate *priv;
+};
+
+struct _ThrottleClass {
+    GObjectClass parent_class;
+};
+
+GType            throttle_get_type            (void) G_GNUC_CONST;
+
+GObject*         throttle_new                 (GBusType       bus_type);
+void             throttle_set_limit           (Throttle      *self,
+                                               ThrottleLimit  limit,
+                                               guint          value);
+void             throttle_cgroups             (Throttle      *self,
+                                               Cgroups       *cgroups,
+                                               Matcher       *blacklist);
+void             throttle_restore             (Throttle      *self);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,660 @@
+/*
+ * Copyright Cedric Bellegarde <cedric.bellegarde@adishatz.org>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/utsname.h>
+
+#include <glib/gstdio.h>
+
+#include "define.h"
+#include "units.h"
+#include "utils.h"
+
+/*
+ * systemd owns unit cgroups: it rewrites cgroup.subtree_control and
+ * controller files on reload or when a sibling unit changes. Runtime
+ * unit properties are applied by systemd itself and survive this,
+ * they are dropped on reboot.
+ *
+ * Properties we change are read first, kept in a runtime file and given
+ * back later, even by a restarted daemon: unit files and admins may set
+ * their own.
+ *
+ * Idle units get CPUWeight=idle, systemd 252 and Linux 5.15, or a low
+ * weight.
+ */
+
+#define SYSTEMD_DBUS_NAME       "org.freedesktop.systemd1"
+#define SYSTEMD_DBUS_PATH       "/org/freedesktop/systemd1"
+#define SYSTEMD_DBUS_INTERFACE  "org.freedesktop.systemd1.Manager"
+#define SYSTEMD_UNIT_PATH       "/org/freedesktop/systemd1/unit/"
+
+#define UNITS_MAX_CPUS 1024
+
+/* One group per unit, one key per saved property */
+#define SAVED_PROPERTIES_FILE "unit-properties"
+
+/* CPUWeight=, as systemd D-Bus API (default is 100) */
+#define CPU_WEIGHT_IDLE 0
+#define CPU_WEIGHT_LOW 10
+
+/* First systemd accepting CPUWeight=idle */
+#define SYSTEMD_CPU_IDLE_VERSION 252
+
+/* Never idle: calls, SMS and the buses they go through */
+static const char *cpu_idle_exempt[] = {
+    "ModemManager.service",
+    "ofono.service",
+    "eg25-manager.service",
+    "dbus.service",
+    "dbus-broker.service",
+    "systemd-logind.service",
+    SYSTEM_UNIT
+};
+
+struct _UnitsPrivate {
+    GDBusProxy *systemd_proxy;
+
+    guint64 idle_weight;
+    /* Properties before we changed them, mirrors saved_file */
+    GKeyFile *saved;
+    char *saved_file;
+};
+
+G_DEFINE_TYPE_WITH_CODE (
+    Units,
+    units,
+    G_TYPE_OBJECT,
+    G_ADD_PRIVATE (Units)
+)
+
+static GVariant *
+get_cpus_mask (const char *cpus)
+{
+    guint8 mask[UNITS_MAX_CPUS / 8] = { 0 };
+    gsize length = 0;
+    const char *cpu = cpus;
+
+    /* 0-3,6,8-9, as a little endian bitmask */
+    while (cpu != NULL && *cpu != '\0') {
+        char *end;
+        gulong first = strtoul (cpu, &end, 10);
+        gulong last = first;
+        gulong i;
+
+        if (end == cpu)
+            break;
+        if (*end == '-')
+            last = strtoul (end + 1, &end, 10);
+
+        for (i = first; i <= last && i < UNITS_MAX_CPUS; i++) {
+            mask[i / 8] |= 1 << (i % 8);
+            length = MAX (length, i / 8 + 1);
+        }
+
+        cpu = *end == ',' ? end + 1 : NULL;
+    }
+
+    return g_variant_new_fixed_array (G_VARIANT_TYPE_BYTE, mask, length, 1);
+}
+
+static char *
+get_unit_path (const char *unit)
+{
+    GString *path = g_string_new (SYSTEMD_UNIT_PATH);
+    const char *c;
+
+    /* As systemd bus_label_escape(): foo_2dbar_2eservice */
+    for (c = unit; *c != '\0'; c++) {
+        if (g_ascii_isalpha (*c) || (c > unit && g_ascii_isdigit (*c)))
+            g_string_append_c (path, *c);
+        else
+            g_string_append_printf (path, "_%02x", (guchar) *c);
+    }
+
+    return g_string_free (path, FALSE);
+}
+
+static const char *
+get_unit_interface (const char *unit)
+{
+    if (g_str_has_suffix (unit, ".scope"))
+        return "org.freedesktop.systemd1.Scope";
+    if (g_str_has_suffix (unit, ".slice"))
+        return "org.freedesktop.systemd1.Slice";
+
+    return "org.freedesktop.systemd1.Service";
+}
+
+static gboolean
+has_cpu_idle (void)
+{
+    struct utsname name;
+    guint major = 0;
+    guint minor = 0;
+
+    /* No cpu.idle file to test before systemd enabled cpu */
+    if (uname (&name) != 0 ||
+            sscanf (name.release, "%u.%u", &major, &minor) != 2)
+        return FALSE;
+
+    return major > 5 || (major == 5 && minor >= 15);
+}
+
+static guint
+get_systemd_version (Units *self)
+{
+    g_autoptr (GVariant) result = NULL;
+    g_autoptr (GVariant) version = NULL;
+    const char *text;
+
+    result = g_dbus_connection_call_sync (
+        g_dbus_proxy_get_connection (self->priv->systemd_proxy),
+        SYSTEMD_DBUS_NAME,
+        SYSTEMD_DBUS_PATH,
+        "org.freedesktop.DBus.Properties",
+        "Get",
+        g_variant_new ("(ss)", SYSTEMD_DBUS_INTERFACE, "Version"),
+        G_VARIANT_TYPE ("(v)"),
+        G_DBUS_CALL_FLAGS_NONE,
+        -1,
+        NULL,
+        NULL
+    );
+    if (result == NULL)
+        return 0;
+
+    /* "252.5-1", "v255" */
+    g_variant_get (result, "(v)", &version);
+    if (!g_variant_is_of_type (version, G_VARIANT_TYPE_STRING))
+        return 0;
+
+    text = g_variant_get_string (version, NULL);
+    while (*text != '\0' && !g_ascii_isdigit (*text))
+        text++;
+
+    return strtoul (text, NULL, 10);
+}
+
+static void
+on_set_unit_properties (GObject      *source,
+                        GAsyncResult *result,
+                        gpointer      user_data)
+{
+    g_autofree char *unit = user_data;
+    g_autoptr (GError) error = NULL;
+    g_autoptr (GVariant) value = NULL;
+    g_autofree char *remote_error = NULL;
+
+    value = g_dbus_proxy_call_finish (G_DBUS_PROXY (source), result, &error);
+    if (error == NULL)
+        return;
+
+    /* Unit stopped since it was indexed */
+    remote_error = g_dbus_error_get_remote_error (error);
+    if (g_strcmp0 (remote_error, "org.freedesktop.systemd1.NoSuchUnit") == 0)
+        return;
+
+    g_warning ("Can't set %s properties: %s", unit, error->message);
+}
+
+static void
+save_properties_file (Units *self)
+{
+    g_autofree char *runtime_dir = g_path_get_dirname (self->priv->saved_file);
+    g_autoptr (GError) error = NULL;
+    gsize length = 0;
+    g_auto (GStrv) units = g_key_file_get_groups (self->priv->saved, &length);
+
+    if (length == 0) {
+        g_unlink (self->priv->saved_file);
+        return;
+    }
+
+    g_mkdir_with_parents (runtime_dir, 0755);
+    if (!g_key_file_save_to_file (self->priv->saved,
+                                  self->priv->saved_file,
+                                  &error))
+        g_warning ("Can't save unit properties: %s", error->message);
+}
+
+static GVariant *
+get_unit_properties (Units      *self,
+                     const char *unit)
+{
+    g_autofree char *path = get_unit_path (unit);
+    g_autoptr (GVariant) result = NULL;
+    GVariant *properties = NULL;
+
+    result = g_dbus_connection_call_sync (
+        g_dbus_proxy_get_connection (self->priv->systemd_proxy),
+        SYSTEMD_DBUS_NAME,
+        path,
+        "org.freedesktop.DBus.Properties",
+        "GetAll",
+        g_variant_new ("(s)", get_unit_interface (unit)),
+        G_VARIANT_TYPE ("(a{sv})"),
+        G_DBUS_CALL_FLAGS_NONE,
+        -1,
+        NULL,
+        NULL
+    );
+    if (result == NULL)
+        return NULL;
+
+    g_variant_get (result, "(@a{sv})", &properties);
+
+    return properties;
+}
+
+static void
+add_saved_property (Units           *self,
+                    GVariantBuilder *builder,
+                    const char      *unit,
+                    const char      *property)
+{
+    g_autofree char *text = g_key_file_get_string (
+        self->priv->saved, unit, property, NULL
+    );
+    g_autoptr (GVariant) value = NULL;
+
+    if (text == NULL)
+        return;
+
+    g_key_file_remove_key (self->priv->saved, unit, property, NULL);
+
+    value = g_variant_parse (NULL, text, NULL, NULL, NULL);
+    if (value == NULL)
+        return;
+
+    /* Device lists are merged by systemd: empty one first */
+    if (g_variant_is_of_type (value, G_VARIANT_TYPE_ARRAY))
+        g_variant_builder_add (
+            builder,
+            "(sv)",
+            property,
+            g_variant_new_array (
+                g_variant_type_element (g_variant_get_type (value)), NULL, 0
+            )
+        );
+    g_variant_builder_add (builder, "(sv)", property, value);
+}
+
+static void
+set_cpu_weight (Units      *self,
+                const char *unit,
+                guint64     weight)
+{
+    GVariantBuilder builder;
+
+    g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(sv)"));
+    g_variant_builder_add (
+        &builder, "(sv)", "CPUWeight", g_variant_new_uint64 (weight)
+    );
+
+    units_set_properties (self, unit, g_variant_builder_end (&builder));
+}
+
+static void
+units_dispose (GObject *units)
+{
+    Units *self = UNITS (units);
+
+    g_clear_object (&self->priv->systemd_proxy);
+
+    G_OBJECT_CLASS (units_parent_class)->dispose (units);
+}
+
+static void
+units_finalize (GObject *units)
+{
+    Units *self = UNITS (units);
+
+    g_key_file_unref (self->priv->saved);
+    g_free (self->priv->saved_file);
+
+    G_OBJECT_CLASS (units_parent_class)->finalize (units);
+}
+
+static void
+units_class_init (UnitsClass *klass)
+{
+    GObjectClass *object_class;
+
+    object_class = G_OBJECT_CLASS (klass);
+    object_class->dispose = units_dispose;
+    object_class->finalize = units_finalize;
+}
+
+static void
+units_init (Units *self)
+{
+    self->priv = units_get_instance_private (self);
+
+    self->priv->systemd_proxy = NULL;
+    self->priv->idle_weight = CPU_WEIGHT_LOW;
+    self->priv->saved = g_key_file_new ();
+    self->priv->saved_file = NULL;
+}
+
+/**
+ * units_new:
+ *
+ * Creates a new #Units
+ *
+ * @param #GBusType: systemd instance, system or user manager
+ *
+ * Returns: (transfer full): a new #Units
+ *
+ **/
+GObject *
+units_new (GBusType bus_type)
+{
+    GObject *units;
+    UnitsPrivate *priv;
+    g_autoptr (GError) error = NULL;
+
+    units = g_object_new (TYPE_UNITS, NULL);
+    priv = UNITS (units)->priv;
+
+    /* Left by a previous instance: given back on next restore */
+    if (bus_type == G_BUS_TYPE_SYSTEM)
+        priv->saved_file = get_root_path (
+            RUNTIME_DIR "/" SAVED_PROPERTIES_FILE
+        );
+    else
+        priv->saved_file = g_build_filename (
+            g_get_user_runtime_dir (),
+            "mobile-power-saver",
+            SAVED_PROPERTIES_FILE,
+            NULL
+        );
+    g_key_file_load_from_file (
+        priv->saved, priv->saved_file, G_KEY_FILE_NONE, NULL
+    );
+
+    /* Relocated trees have no systemd */
+    if (get_root_dir () != NULL)
+        return units;
+
+    UNITS (units)->priv->systemd_proxy = g_dbus_proxy_new_for_bus_sync (
+        bus_type,
+        G_DBUS_PROXY_FLAGS_DO_NOT_LOAD_PROPERTIES |
+        G_DBUS_PROXY_FLAGS_DO_NOT_CONNECT_SIGNALS,
+        NULL,
+        SYSTEMD_DBUS_NAME,
+        SYSTEMD_DBUS_PATH,
+        SYSTEMD_DBUS_INTERFACE,
+        NULL,
+        &error
+    );
+
+    if (error != NULL) {
+        g_warning ("Can't contact systemd: %s", error->message);
+        return units;
+    }
+
+    /* Older systemd rejects CPUWeight=idle, kernel needs cpu.idle */
+    if (has_cpu_idle () &&
+            get_systemd_version (UNITS (units)) >= SYSTEMD_CPU_IDLE_VERSION)
+        priv->idle_weight = CPU_WEIGHT_IDLE;
+
+    return units;
+}
+
+static Units *default_system_units = NULL;
+static Units *default_session_units = NULL;
+/**
+ * units_get_default:
+ *
+ * Gets the default #Units: one per systemd instance, so that all users
+ * in a daemon share its saved properties file.
+ *
+ * @bus_type: systemd instance, as in units_new()
+ *
+ * Return value: (transfer none): the default #Units.
+ */
+Units *
+units_get_default (GBusType bus_type)
+{
+    if (bus_type == G_BUS_TYPE_SESSION) {
+        if (default_session_units == NULL)
+            default_session_units = UNITS (units_new (G_BUS_TYPE_SESSION));
+        return default_session_units;
+    }
+
+    if (default_system_units == NULL)
+        default_system_units = UNITS (units_new (G_BUS_TYPE_SYSTEM));
+    return default_system_units;
+}
+
+/**
+ * units_free_default:
+ *
+ * Free the default #Units.
+ *
+ */
+void
+units_free_default (void)
+{
+    g_clear_object (&default_system_units);
+    g_clear_object (&default_session_units);
+}
+
+/**
+ * units_set_properties:
+ *
+ * Set unit runtime properties, asynchronously
+ *
+ * @self: a #Units
+ * @unit: unit name
+ * @properties: (transfer floating): properties as a(sv)
+ */
+void
+units_set_properties (Units      *self,
+                      const char *unit,
+                      GVariant   *properties)
+{
+    if (self->priv->systemd_proxy == NULL) {
+        g_variant_unref (g_variant_ref_sink (properties));
+        return;
+    }
+
+    g_dbus_proxy_call (
+        self->priv->systemd_proxy,
+        "SetUnitProperties",
+        g_variant_new ("(sb@a(sv))", unit, TRUE, properties),
+        G_DBUS_CALL_FLAGS_NONE,
+        -1,
+        NULL,
+        on_set_unit_properties,
+        g_strdup (unit)
+    );
+}
+
+/**
+ * units_set_allowed_cpus:
+ *
+ * Set cpus unit is allowed to run on (AllowedCPUs=)
+ *
+ * @self: a #Units
+ * @unit: unit name
+ * @cpus: cpus list, like 0-3,6, empty for all
+ */
+void
+units_set_allowed_cpus (Units      *self,
+                        const char *unit,
+                        const char *cpus)
+{
+    GVariantBuilder builder;
+
+    g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(sv)"));
+    g_variant_builder_add (
+        &builder, "(sv)", "AllowedCPUs", get_cpus_mask (cpus)
+    );
+
+    units_set_properties (self, unit, g_variant_builder_end (&builder));
+}
+
+/**
+ * units_save_properties:
+ *
+ * Save unit properties, synchronously, before changing them. Already
+ * saved ones are kept: they are the unit own values.
+ *
+ * @self: a #Units
+ * @unit: unit name
+ * @properties: NULL terminated property names
+ *
+ * Returns: TRUE if all properties are saved, do not change them otherwise
+ */
+gboolean
+units_save_properties (Units       *self,
+                       const char  *unit,
+                       const char **properties)
+{
+    g_autoptr (GVariant) values = NULL;
+    gboolean updated = FALSE;
+    guint i;
+
+    if (self->priv->systemd_proxy == NULL)
+        return FALSE;
+
+    for (i = 0; properties[i] != NULL; i++) {
+        g_autoptr (GVariant) value = NULL;
+        g_autofree char *text = NULL;
+
+        if (g_key_file_has_key (self->priv->saved, unit, properties[i], NULL))
+            continue;
+
+        if (values == NULL)
+            values = get_unit_properties (self, unit);
+        if (values != NULL)
+            value = g_variant_lookup_value (values, properties[i], NULL);
+        if (value == NULL)
+            break;
+
+        text = g_variant_print (value, TRUE);
+        g_key_file_set_string (self->priv->saved, unit, properties[i], text);
+        updated = TRUE;
+    }
+
+    if (updated)
+        save_properties_file (self);
+
+    return properties[i] == NULL;
+}
+
+/**
+ * units_restore_properties:
+ *
+ * Give back saved unit properties
+ *
+ * @self: a #Units
+ * @unit: unit name
+ * @properties: NULL terminated property names
+ */
+void
+units_restore_properties (Units       *self,
+                          const char  *unit,
+                          const char **properties)
+{
+    GVariantBuilder builder;
+    g_auto (GStrv) saved = NULL;
+    gsize length = 0;
+    gboolean updated = FALSE;
+    guint i;
+
+    if (!g_key_file_has_group (self->priv->saved, unit))
+        return;
+
+    g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(sv)"));
+    for (i = 0; properties[i] != NULL; i++) {
+        if (!g_key_file_has_key (self->priv->saved, unit, properties[i], NULL))
+            continue;
+
+        add_saved_property (self, &builder, unit, properties[i]);
+        updated = TRUE;
+    }
+
+    if (!updated) {
+        g_variant_builder_clear (&builder);
+        return;
+    }
+
+    /* Nothing left to give back */
+    saved = g_key_file_get_keys (self->priv->saved, unit, &length, NULL);
+    if (length == 0)
+        g_key_file_remove_group (self->priv->saved, unit, NULL);
+
+    units_set_properties (self, unit, g_variant_builder_end (&builder));
+    save_properties_file (self);
+}
+
+/**
+ * units_restore_all_properties:
+ *
+ * Give back saved properties of all units
+ *
+ * @self: a #Units
+ * @properties: NULL terminated property names
+ */
+void
+units_restore_all_properties (Units       *self,
+                              const char **properties)
+{
+    g_auto (GStrv) units = g_key_file_get_groups (self->priv->saved, NULL);
+    guint i;
+
+    for (i = 0; units[i] != NULL; i++)
+        units_restore_properties (self, units[i], properties);
+}
+
+/**
+ * units_is_cpu_idle_exempt:
+ *
+ * Check unit must never be slowed down: telephony and bus units
+ *
+ * @unit: unit name
+ *
+ * Returns: TRUE if unit is never idle
+ */
+gboolean
+units_is_cpu_idle_exempt (const char *unit)
+{
+    guint i;
+
+    for (i = 0; i < G_N_ELEMENTS (cpu_idle_exempt); i++)
+        if (g_strcmp0 (unit, cpu_idle_exempt[i]) == 0)
+            return TRUE;
+
+    return FALSE;
+}
+
+/**
+ * units_set_cpu_idle:
+ *
+ * Run unit at idle cpu priority, against its slice siblings, or give it
+ * back its own CPUWeight=. Telephony and bus units are never idle.
+ *
+ * @self: a #Units
+ * @unit: unit name
+ * @idle: TRUE to make unit idle
+ */
+void
+units_set_cpu_idle (Units      *self,
+                    const char *unit,
+                    gboolean    idle)
+{
+    const char *properties[] = { "CPUWeight", NULL };
+
+    if (idle && !units_is_cpu_idle_exempt (unit)) {
+        if (units_save_properties (self, unit, properties))
+            set_cpu_weight (self, unit, self->priv->idle_weight);
+    } else {
+        units_restore_properties (self, unit, properties);
+    }
+}
@@ -0,0 +1,71 @@
+/*
+ * Copyright Cedric Bellegarde <cedric.bellegarde@adishatz.org>
+ */
+
+#ifndef UNITS_H
+#define UNITS_H
+
+#include <glib.h>
+#include <glib-object.h>
+#include <gio/gio.h>
+
+#define TYPE_UNITS \
+    (units_get_type ())
+#define UNITS(obj) \
+    (G_TYPE_CHECK_INSTANCE_CAST \
+    ((obj), TYPE_UNITS, Units))
+#define UNITS_CLASS(cls) \
+    (G_TYPE_CHECK_CLASS_CAST \
+    ((cls), TYPE_UNITS, UnitsClass))
+#define IS_UNITS(obj) \
+    (G_TYPE_CHECK_INSTANCE_TYPE \
+    ((obj), TYPE_UNITS))
+#define IS_UNITS_CLASS(cls) \
+    (G_TYPE_CHECK_CLASS_TYPE \
+    ((cls), TYPE_UNITS))
+#define UNITS_GET_CLASS(obj) \
+    (G_TYPE_INSTANCE_GET_CLASS \
+    ((obj), TYPE_UNITS, UnitsClass))
+
+G_BEGIN_DECLS
+
+typedef struct _Units Units;
+typedef struct _UnitsClass UnitsClass;
+typedef struct _UnitsPrivate UnitsPrivate;
+
+struct _Units {
+    GObject parent;
+    UnitsPrivate *priv;
+};
+
+struct _UnitsClass {
+    GObjectClass parent_class;
+};
+
+GType           units_get_type               (void) G_GNUC_CONST;
+
+GObject*        units_new                    (GBusType     bus_type);
+Units*          units_get_default            (GBusType     bus_type);
+void            units_free_default           (void);
+void            units_set_properties         (Units       *self,
+                                              const char  *unit,
+                                              GVariant    *properties);
+gboolean        units_save_properties        (Units       *self,
+                                              const char  *unit,
+                                              const char **properties);
+void            units_restore_properties     (Units       *self,
+                                              const char  *unit,
+                                              const char **properties);
+void            units_restore_all_properties (Units       *self,
+                                              const char **properties);
+void            units_set_allowed_cpus       (Units       *self,
+                                              const char  *unit,
+                                              const char  *cpus);
+gboolean        units_is_cpu_idle_exempt     (const char  *unit);
+void            units_set_cpu_idle           (Units       *self,
+                                              const char  *unit,
+                                              gboolean     idle);
+
+G_END_DECLS
+
+#endif
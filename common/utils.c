@@ -7,117 +7,93 @@
 #include <glib.h>
 #include <unistd.h>
 
+#include "cgroups.h"
 #include "define.h"
 #include "utils.h"
+#include "writer.h"
 
-void write_to_file (const char *filename,
-                    const char *value)
-{
-    FILE *file;
-
-    if (!g_file_test (filename, G_FILE_TEST_EXISTS))
-        return;
-
-    file = fopen(filename, "w");
+static char *root = NULL;
 
-    g_return_if_fail (file != NULL);
+/**
+ * set_root_dir:
+ *
+ * Relocate sysfs/procfs/cgroupfs/devfs to another root, for testing
+ *
+ * @root_dir: new root, NULL or "/" for real system
+ */
+void
+set_root_dir (const char *root_dir)
+{
+    g_free (root);
+    root = NULL;
 
-    fprintf (file, "%s", value);
-    fclose (file);
+    if (root_dir != NULL && g_strcmp0 (root_dir, "/") != 0)
+        root = g_canonicalize_filename (root_dir, NULL);
 }
 
-
-GList *get_applications (void)
+/**
+ * get_root_dir:
+ *
+ * Returns: current root, NULL for real system
+ */
+const char *
+get_root_dir (void)
 {
-    g_autoptr (GDir) sys_dir = NULL;
-    g_autofree char *dirname = g_strdup_printf(
-        CGROUPS_USER_APPS_DIR, getuid(), getuid()
-    );
-    const char *app_dir;
-    GList *apps = NULL;
-
-    sys_dir = g_dir_open (dirname, 0, NULL);
-    if (sys_dir == NULL) {
-        g_warning ("Can't find cgroups user app slice: %s", dirname);
-        return NULL;
-    }
-
-    while ((app_dir = g_dir_read_name (sys_dir)) != NULL) {
-        if (g_str_has_prefix (app_dir, "app-") &&
-                g_str_has_suffix (app_dir, ".scope")) {
-            char *app = g_build_filename (
-                dirname, app_dir, "cgroup.freeze", NULL
-            );
-
-            if (!g_file_test (app, G_FILE_TEST_EXISTS)) {
-                g_free (app);
-                continue;
-            }
-
-            apps = g_list_prepend (apps, app);
-        }
-    }
-    return apps;
+    return root;
 }
 
-GList *get_cgroup_services (const char *path)
+/**
+ * get_root_path:
+ *
+ * Get path relocated to current root
+ *
+ * @path: absolute path on real system
+ *
+ * Returns: (transfer full): relocated path
+ */
+char *
+get_root_path (const char *path)
 {
-    g_autoptr (GDir) sys_dir = NULL;
-
-    const char *cgroup_dir;
-    GList *services = NULL;
-
-    sys_dir = g_dir_open (path, 0, NULL);
-    if (sys_dir == NULL) {
-        g_warning ("Can't find cgroup: %s", path);
-        return NULL;
-    }
-
-    while ((cgroup_dir = g_dir_read_name (sys_dir)) != NULL) {
-        g_autofree char *cgroup = NULL;
-
-        if (g_str_has_suffix (cgroup_dir, ".service")) {
-            cgroup = g_build_filename (
-                path, cgroup_dir, "cgroup.procs", NULL
-            );
+    if (root == NULL)
+        return g_strdup (path);
 
-            if (!g_file_test (cgroup, G_FILE_TEST_EXISTS)) {
-                g_warning ("cgroup not found: %s", cgroup);
-                continue;
-            }
-
-            services = g_list_prepend (services, g_strdup (cgroup_dir));
-        }
-    }
-    return services;
+    return g_build_filename (root, path, NULL);
 }
 
-GList*
-get_cgroup_slices (const char *path)
+gint
+write_to_file (const char *filename,
+               const char *value)
 {
-    g_autoptr (GDir) sys_dir = NULL;
+    return writer_write (writer_get_default (), filename, value);
+}
 
-    const char *cgroup_dir;
-    GList *slices = NULL;
 
-    sys_dir = g_dir_open (path, 0, NULL);
-    if (sys_dir == NULL) {
-        g_warning ("Can't find cgroup: %s", path);
-        return NULL;
-    }
+GList *get_applications (void)
+{
+    Cgroups *cgroups = cgroups_get_default (G_BUS_TYPE_SESSION);
+    GList *scopes = cgroups_get_scopes (cgroups);
+    const char *scope;
+    GList *apps = NULL;
 
-    while ((cgroup_dir = g_dir_read_name (sys_dir)) != NULL) {
+    GFOREACH (scopes, scope) {
+        const char *scope_dir;
         g_autofree char *slice = NULL;
 
-        if (g_str_has_suffix (cgroup_dir, ".slice")) {
-            slice = g_build_filename (
-                path, cgroup_dir, NULL
-            );
-            slices = g_list_concat (slices, get_cgroup_slices (slice));
-            slices = g_list_prepend (slices, g_strdup (slice));
-        }
+        if (!g_str_has_prefix (scope, "app-"))
+            continue;
+
+        scope_dir = cgroups_get_scope_dir (cgroups, scope);
+        slice = g_path_get_dirname (scope_dir);
+        if (!g_str_has_suffix (slice, "/app.slice"))
+            continue;
+
+        apps = g_list_prepend (
+            apps, g_build_filename (scope_dir, "cgroup.freeze", NULL)
+        );
     }
-    return slices;
+    g_list_free (scopes);
+
+    return apps;
 }
 
 GList*
@@ -156,16 +132,3 @@ get_list_from_variant (GVariant *value)
 
     return list;
 }
-
-gboolean
-in_list (GList      *list,
-         const char *value)
-{
-    const char *item;
-
-    GFOREACH (list, item) {
-        if (g_strcmp0 (item, value) == 0)
-            return TRUE;
-    }
-    return FALSE;
-}
\ No newline at end of file
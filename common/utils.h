@@ -12,10 +12,10 @@
         __glist_sub && (item = __glist_sub->data, TRUE); \
         __glist_sub = __glist_sub->next)
 
-void write_to_file (const char *filename, const char *value);
+void set_root_dir (const char *root_dir);
+const char *get_root_dir (void);
+char *get_root_path (const char *path);
+gint write_to_file (const char *filename, const char *value);
 GList *get_applications (void);
-GList *get_cgroup_services (const char *path);
-GList *get_cgroup_slices (const char *path);
 GList *get_cgroup_pids (const char *path);
 GList *get_list_from_variant (GVariant *value);
-gboolean in_list (GList *list, const char *value);
@@ -0,0 +1,712 @@
+/*
+ * Copyright Cedric Bellegarde <cedric.bellegarde@adishatz.org>
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/vfs.h>
+
+#include <linux/magic.h>
+
+#include <gio/gio.h>
+
+#ifdef IO_URING_ENABLED
+#include <liburing.h>
+#endif
+
+#include "config.h"
+#include "writer.h"
+
+/* sysfs/procfs/cgroupfs knobs we keep open, cpuset tasks included */
+#define WRITER_MAX_FDS 512
+#define WRITER_URING_ENTRIES 64
+
+struct WriterRequest {
+    char *path;
+    char *value;
+    gint fd;
+    gboolean truncate;
+    gint error;
+};
+
+struct _WriterBatch {
+    GPtrArray *requests;
+};
+
+struct _WriterPrivate {
+    GHashTable *fds;
+    GHashTable *dirfds;
+    /* cached paths that are regular files, see get_fd() */
+    GHashTable *regular;
+
+#ifdef IO_URING_ENABLED
+    struct io_uring ring;
+    gboolean ring_ready;
+#endif
+};
+
+G_DEFINE_TYPE_WITH_CODE (
+    Writer,
+    writer,
+    G_TYPE_OBJECT,
+    G_ADD_PRIVATE (Writer)
+)
+
+static void
+close_fd (gpointer user_data)
+{
+    close (GPOINTER_TO_INT (user_data));
+}
+
+static void
+request_free (gpointer user_data)
+{
+    struct WriterRequest *request = user_data;
+
+    g_free (request->path);
+    g_free (request->value);
+    g_free (request);
+}
+
+static gint
+get_dirfd (Writer     *self,
+           const char *dirname)
+{
+    gpointer value;
+    gint dirfd;
+
+    if (g_hash_table_lookup_extended (self->priv->dirfds, dirname, NULL, &value))
+        return GPOINTER_TO_INT (value);
+
+    dirfd = open (dirname, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirfd == -1)
+        return -1;
+
+    g_hash_table_insert (
+        self->priv->dirfds, g_strdup (dirname), GINT_TO_POINTER (dirfd)
+    );
+
+    return dirfd;
+}
+
+static gboolean
+is_regular_file (gint fd)
+{
+    struct statfs sfs;
+    struct stat st;
+
+    if (fstat (fd, &st) == -1 || !S_ISREG (st.st_mode))
+        return FALSE;
+
+    /* Kernel knobs are S_ISREG too */
+    if (fstatfs (fd, &sfs) == -1)
+        return FALSE;
+
+    switch (sfs.f_type) {
+    case SYSFS_MAGIC:
+    case PROC_SUPER_MAGIC:
+    case CGROUP_SUPER_MAGIC:
+    case CGROUP2_SUPER_MAGIC:
+    case DEBUGFS_MAGIC:
+    case TRACEFS_MAGIC:
+        return FALSE;
+    default:
+        return TRUE;
+    }
+}
+
+static gint
+get_fd (Writer     *self,
+        const char *path,
+        gboolean   *regular,
+        gint       *error)
+{
+    g_autofree char *dirname = NULL;
+    g_autofree char *basename = NULL;
+    gpointer value;
+    gint dirfd;
+    gint fd;
+
+    if (g_hash_table_lookup_extended (self->priv->fds, path, NULL, &value)) {
+        *regular = g_hash_table_contains (self->priv->regular, path);
+        return GPOINTER_TO_INT (value);
+    }
+
+    dirname = g_path_get_dirname (path);
+    basename = g_path_get_basename (path);
+
+    dirfd = get_dirfd (self, dirname);
+    if (dirfd == -1) {
+        *error = errno;
+        return -1;
+    }
+
+    /* Keep knobs readable when possible, values can then be verified */
+    fd = openat (dirfd, basename, O_RDWR | O_CLOEXEC);
+    if (fd == -1 && (errno == EACCES || errno == EPERM || errno == EISDIR))
+        fd = openat (dirfd, basename, O_WRONLY | O_CLOEXEC);
+    if (fd == -1) {
+        *error = errno;
+        /* Directory may be gone (cgroup removed), retry on next call */
+        if (errno == ENOENT || errno == ENODEV)
+            g_hash_table_remove (self->priv->dirfds, dirname);
+        return -1;
+    }
+
+    /*
+     * Regular files (relocated root, tests) keep their old tail on a
+     * shorter write: they are truncated first. sysfs/procfs are not.
+     */
+    *regular = is_regular_file (fd);
+    if (*regular)
+        g_hash_table_add (self->priv->regular, g_strdup (path));
+
+    g_hash_table_insert (
+        self->priv->fds, g_strdup (path), GINT_TO_POINTER (fd)
+    );
+
+    return fd;
+}
+
+static void
+trim_cache (Writer *self)
+{
+    /* Transient cgroups (apps, services) would grow the cache forever */
+    if (g_hash_table_size (self->priv->fds) >= WRITER_MAX_FDS) {
+        g_hash_table_remove_all (self->priv->fds);
+        g_hash_table_remove_all (self->priv->dirfds);
+        g_hash_table_remove_all (self->priv->regular);
+    }
+}
+
+static gint
+write_fd (gint        fd,
+          const char *value,
+          gboolean    truncate)
+{
+    gsize length = strlen (value);
+    gssize written;
+
+    if (truncate && ftruncate (fd, 0) == -1)
+        return errno;
+
+    do {
+        written = pwrite (fd, value, length, 0);
+    } while (written == -1 && errno == EINTR);
+
+    if (written == -1)
+        return errno;
+
+    /* Kernel knobs take a value in one write, a partial one is lost */
+    if ((gsize) written != length)
+        return EIO;
+
+    return 0;
+}
+
+static gboolean
+is_stale_error (gint error)
+{
+    /*
+     * Object behind the descriptor is gone: cgroup removed, device
+     * unbound, process exited
+     */
+    return error == ENODEV || error == ENOENT || error == ESRCH;
+}
+
+static void
+log_error (const char *path,
+           const char *value,
+           gint        error)
+{
+    /* Missing knobs are expected: not every kernel provides all of them */
+    if (error == ENOENT)
+        return;
+
+    g_warning ("Can't write %s to %s: %s", value, path, g_strerror (error));
+}
+
+#ifdef IO_URING_ENABLED
+static gint
+get_uring_error (struct WriterRequest *request,
+                 gint                  res)
+{
+    if (res < 0)
+        return -res;
+
+    /* Same as write_fd(): a partial write is lost */
+    if ((gsize) res != strlen (request->value))
+        return EIO;
+
+    return 0;
+}
+
+static void
+submit_uring (Writer    *self,
+              GPtrArray *requests)
+{
+    struct io_uring_cqe *cqe;
+    guint submitted = 0;
+    guint i;
+
+    for (i = 0; i < requests->len; i++) {
+        struct WriterRequest *request = g_ptr_array_index (requests, i);
+        struct io_uring_sqe *sqe;
+
+        if (request->fd == -1)
+            continue;
+
+        /* Regular files only, not worth a linked ring request */
+        if (request->truncate && ftruncate (request->fd, 0) == -1) {
+            request->error = errno;
+            continue;
+        }
+
+        sqe = io_uring_get_sqe (&self->priv->ring);
+        if (sqe == NULL) {
+            io_uring_submit_and_wait (&self->priv->ring, submitted);
+            while (submitted > 0 &&
+                    io_uring_peek_cqe (&self->priv->ring, &cqe) == 0) {
+                struct WriterRequest *done = io_uring_cqe_get_data (cqe);
+
+                done->error = get_uring_error (done, cqe->res);
+                io_uring_cqe_seen (&self->priv->ring, cqe);
+                submitted--;
+            }
+            sqe = io_uring_get_sqe (&self->priv->ring);
+        }
+
+        io_uring_prep_write (
+            sqe, request->fd, request->value, strlen (request->value), 0
+        );
+        io_uring_sqe_set_data (sqe, request);
+        submitted++;
+    }
+
+    io_uring_submit_and_wait (&self->priv->ring, submitted);
+    while (submitted > 0) {
+        struct WriterRequest *done;
+
+        if (io_uring_wait_cqe (&self->priv->ring, &cqe) != 0)
+            break;
+
+        done = io_uring_cqe_get_data (cqe);
+        done->error = get_uring_error (done, cqe->res);
+        io_uring_cqe_seen (&self->priv->ring, cqe);
+        submitted--;
+    }
+}
+#endif
+
+static void
+submit_sync (Writer    *self,
+             GPtrArray *requests)
+{
+    guint i;
+
+    for (i = 0; i < requests->len; i++) {
+        struct WriterRequest *request = g_ptr_array_index (requests, i);
+
+        if (request->fd != -1)
+            request->error = write_fd (
+                request->fd, request->value, request->truncate
+            );
+    }
+}
+
+static void
+writer_dispose (GObject *writer)
+{
+    G_OBJECT_CLASS (writer_parent_class)->dispose (writer);
+}
+
+static void
+writer_finalize (GObject *writer)
+{
+    Writer *self = WRITER (writer);
+
+    g_hash_table_destroy (self->priv->fds);
+    g_hash_table_destroy (self->priv->dirfds);
+    g_hash_table_destroy (self->priv->regular);
+
+#ifdef IO_URING_ENABLED
+    if (self->priv->ring_ready)
+        io_uring_queue_exit (&self->priv->ring);
+#endif
+
+    G_OBJECT_CLASS (writer_parent_class)->finalize (writer);
+}
+
+static void
+writer_class_init (WriterClass *klass)
+{
+    GObjectClass *object_class;
+
+    object_class = G_OBJECT_CLASS (klass);
+    object_class->dispose = writer_dispose;
+    object_class->finalize = writer_finalize;
+}
+
+static void
+writer_init (Writer *self)
+{
+    self->priv = writer_get_instance_private (self);
+
+    self->priv->fds = g_hash_table_new_full (
+        g_str_hash, g_str_equal, g_free, close_fd
+    );
+    self->priv->dirfds = g_hash_table_new_full (
+        g_str_hash, g_str_equal, g_free, close_fd
+    );
+    self->priv->regular = g_hash_table_new_full (
+        g_str_hash, g_str_equal, g_free, NULL
+    );
+
+#ifdef IO_URING_ENABLED
+    self->priv->ring_ready = io_uring_queue_init (
+        WRITER_URING_ENTRIES, &self->priv->ring, 0
+    ) == 0;
+    if (!self->priv->ring_ready)
+        g_message ("io_uring not available, using plain syscalls");
+#endif
+}
+
+/**
+ * writer_new:
+ *
+ * Creates a new #Writer
+ *
+ * Returns: (transfer full): a new #Writer
+ *
+ **/
+GObject *
+writer_new (void)
+{
+    GObject *writer;
+
+    writer = g_object_new (TYPE_WRITER, NULL);
+
+    return writer;
+}
+
+static Writer *default_writer = NULL;
+/**
+ * writer_get_default:
+ *
+ * Gets the default #Writer.
+ *
+ * Return value: (transfer full): the default #Writer.
+ */
+Writer *
+writer_get_default (void)
+{
+    if (default_writer == NULL) {
+        default_writer = WRITER (writer_new ());
+    }
+    return default_writer;
+}
+
+/**
+ * writer_free_default:
+ *
+ * Free the default #Writer.
+ *
+ */
+void
+writer_free_default (void)
+{
+    if (default_writer != NULL) {
+        g_clear_object (&default_writer);
+        default_writer = NULL;
+    }
+}
+
+/**
+ * writer_try_write:
+ *
+ * Same as writer_write(), errors are left to caller: for writes
+ * expected to fail (exited processes, probes)
+ *
+ * @self: a #Writer
+ * @path: file to write
+ * @value: value to write
+ *
+ * Returns: 0 on success, errno otherwise (ENOENT if file does not exist)
+ */
+gint
+writer_try_write (Writer     *self,
+                  const char *path,
+                  const char *value)
+{
+    gboolean regular = FALSE;
+    gint error = 0;
+    gint fd;
+
+    trim_cache (self);
+
+    fd = get_fd (self, path, &regular, &error);
+    if (fd == -1)
+        return error;
+
+    error = write_fd (fd, value, regular);
+    if (is_stale_error (error)) {
+        writer_forget (self, path);
+        fd = get_fd (self, path, &regular, &error);
+        if (fd == -1)
+            return error;
+        error = write_fd (fd, value, regular);
+    }
+
+    return error;
+}
+
+/**
+ * writer_write:
+ *
+ * Write value to a sysfs/procfs file, keeping its descriptor open
+ *
+ * @self: a #Writer
+ * @path: file to write
+ * @value: value to write
+ *
+ * Returns: 0 on success, errno otherwise (ENOENT if file does not exist)
+ */
+gint
+writer_write (Writer     *self,
+              const char *path,
+              const char *value)
+{
+    gint error = writer_try_write (self, path, value);
+
+    if (error != 0)
+        log_error (path, value, error);
+
+    return error;
+}
+
+/**
+ * writer_read:
+ *
+ * Read current value of a sysfs/procfs file, using cached descriptor
+ *
+ * @self: a #Writer
+ * @path: file to read
+ * @buffer: buffer to fill, stripped of surrounding spaces
+ * @size: buffer size
+ *
+ * Returns: 0 on success, errno otherwise
+ */
+gint
+writer_read (Writer     *self,
+             const char *path,
+             char       *buffer,
+             gsize       size)
+{
+    gboolean regular = FALSE;
+    gint error = 0;
+    gssize length;
+    gint fd;
+
+    g_return_val_if_fail (size > 0, EINVAL);
+
+    trim_cache (self);
+
+    fd = get_fd (self, path, &regular, &error);
+    if (fd == -1)
+        return error;
+
+    do {
+        length = pread (fd, buffer, size - 1, 0);
+    } while (length == -1 && errno == EINTR);
+
+    if (length == -1) {
+        error = errno;
+        if (is_stale_error (error))
+            writer_forget (self, path);
+        return error;
+    }
+
+    buffer[length] = '\0';
+    g_strstrip (buffer);
+
+    return 0;
+}
+
+/**
+ * writer_forget:
+ *
+ * Close cached descriptor for path
+ *
+ * @self: a #Writer
+ * @path: cached file
+ */
+void
+writer_forget (Writer     *self,
+               const char *path)
+{
+    g_autofree char *dirname = g_path_get_dirname (path);
+
+    g_hash_table_remove (self->priv->fds, path);
+    g_hash_table_remove (self->priv->dirfds, dirname);
+    g_hash_table_remove (self->priv->regular, path);
+}
+
+/**
+ * writer_batch_new:
+ *
+ * Creates a new #WriterBatch: writes submitted together, in any order
+ *
+ * Returns: (transfer full): a new #WriterBatch
+ */
+WriterBatch *
+writer_batch_new (void)
+{
+    WriterBatch *batch = g_malloc (sizeof (WriterBatch));
+
+    batch->requests = g_ptr_array_new_with_free_func (request_free);
+
+    return batch;
+}
+
+/**
+ * writer_batch_add:
+ *
+ * Queue a write in batch
+ *
+ * @batch: a #WriterBatch
+ * @path: file to write
+ * @value: value to write
+ */
+void
+writer_batch_add (WriterBatch *batch,
+                  const char  *path,
+                  const char  *value)
+{
+    struct WriterRequest *request = g_malloc (sizeof (struct WriterRequest));
+
+    request->path = g_strdup (path);
+    request->value = g_strdup (value);
+    request->fd = -1;
+    request->truncate = FALSE;
+    request->error = 0;
+
+    g_ptr_array_add (batch->requests, request);
+}
+
+/**
+ * writer_batch_length:
+ *
+ * Get queued writes count
+ *
+ * @batch: a #WriterBatch
+ *
+ * Returns: queued writes count
+ */
+guint
+writer_batch_length (WriterBatch *batch)
+{
+    return batch->requests->len;
+}
+
+/**
+ * writer_batch_submit:
+ *
+ * Submit all writes in batch, with io_uring if available
+ *
+ * @self: a #Writer
+ * @batch: a #WriterBatch
+ *
+ * Returns: failed writes count, missing files excluded
+ */
+guint
+writer_batch_submit (Writer      *self,
+                     WriterBatch *batch)
+{
+    gint64 start = g_get_monotonic_time ();
+    guint failures = 0;
+    guint i;
+
+    trim_cache (self);
+
+    for (i = 0; i < batch->requests->len; i++) {
+        struct WriterRequest *request = g_ptr_array_index (batch->requests, i);
+
+        request->error = 0;
+        request->fd = get_fd (
+            self, request->path, &request->truncate, &request->error
+        );
+    }
+
+#ifdef IO_URING_ENABLED
+    if (self->priv->ring_ready)
+        submit_uring (self, batch->requests);
+    else
+        submit_sync (self, batch->requests);
+#else
+    submit_sync (self, batch->requests);
+#endif
+
+    for (i = 0; i < batch->requests->len; i++) {
+        struct WriterRequest *request = g_ptr_array_index (batch->requests, i);
+
+        if (request->fd != -1 && is_stale_error (request->error)) {
+            request->error = writer_write (self, request->path, request->value);
+            if (request->error != 0 && request->error != ENOENT)
+                failures++;
+            continue;
+        }
+
+        if (request->error == 0)
+            continue;
+
+        log_error (request->path, request->value, request->error);
+        if (request->error != ENOENT)
+            failures++;
+    }
+
+    g_debug ("Batch: %u writes in %" G_GINT64_FORMAT "us",
+             batch->requests->len,
+             g_get_monotonic_time () - start);
+
+    return failures;
+}
+
+/**
+ * writer_batch_get_error:
+ *
+ * Get errno of a submitted write
+ *
+ * @batch: a #WriterBatch
+ * @index: write index, in queued order
+ *
+ * Returns: 0 on success, errno otherwise
+ */
+gint
+writer_batch_get_error (WriterBatch *batch,
+                        guint        index)
+{
+    struct WriterRequest *request;
+
+    g_return_val_if_fail (index < batch->requests->len, EINVAL);
+
+    request = g_ptr_array_index (batch->requests, index);
+
+    return request->error;
+}
+
+/**
+ * writer_batch_free:
+ *
+ * Free batch
+ *
+ * @batch: a #WriterBatch
+ */
+void
+writer_batch_free (WriterBatch *batch)
+{
+    g_ptr_array_unref (batch->requests);
+    g_free (batch);
+}
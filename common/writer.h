@@ -0,0 +1,77 @@
+/*
+ * Copyright Cedric Bellegarde <cedric.bellegarde@adishatz.org>
+ */
+
+#ifndef WRITER_H
+#define WRITER_H
+
+#include <glib.h>
+#include <glib-object.h>
+
+#define TYPE_WRITER \
+    (writer_get_type ())
+#define WRITER(obj) \
+    (G_TYPE_CHECK_INSTANCE_CAST \
+    ((obj), TYPE_WRITER, Writer))
+#define WRITER_CLASS(cls) \
+    (G_TYPE_CHECK_CLASS_CAST \
+    ((cls), TYPE_WRITER, WriterClass))
+#define IS_WRITER(obj) \
+    (G_TYPE_CHECK_INSTANCE_TYPE \
+    ((obj), TYPE_WRITER))
+#define IS_WRITER_CLASS(cls) \
+    (G_TYPE_CHECK_CLASS_TYPE \
+    ((cls), TYPE_WRITER))
+#define WRITER_GET_CLASS(obj) \
+    (G_TYPE_INSTANCE_GET_CLASS \
+    ((obj), TYPE_WRITER, WriterClass))
+
+G_BEGIN_DECLS
+
+typedef struct _Writer Writer;
+typedef struct _WriterClass WriterClass;
+typedef struct _WriterPrivate WriterPrivate;
+typedef struct _WriterBatch WriterBatch;
+
+struct _Writer {
+    GObject parent;
+    WriterPrivate *priv;
+};
+
+struct _WriterClass {
+    GObjectClass parent_class;
+};
+
+GType           writer_get_type            (void) G_GNUC_CONST;
+
+GObject*        writer_new                 (void);
+Writer         *writer_get_default         (void);
+void            writer_free_default        (void);
+gint            writer_write               (Writer      *self,
+                                            const char  *path,
+                                            const char  *value);
+gint            writer_try_write           (Writer      *self,
+                                            const char  *path,
+                                            const char  *value);
+gint            writer_read                (Writer      *self,
+                                            const char  *path,
+                                            char        *buffer,
+                                            gsize        size);
+void            writer_forget              (Writer      *self,
+                                            const char  *path);
+WriterBatch    *writer_batch_new           (void);
+void            writer_batch_add           (WriterBatch *batch,
+                                            const char  *path,
+                                            const char  *value);
+guint           writer_batch_length        (WriterBatch *batch);
+guint           writer_batch_submit        (Writer      *self,
+                                            WriterBatch *batch);
+gint            writer_batch_get_error     (WriterBatch *batch,
+                                            guint        index);
+void            writer_batch_free          (WriterBatch *batch);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (WriterBatch, writer_batch_free)
+
+G_END_DECLS
+
+#endif
@@ -35,6 +35,8 @@ struct _BusPrivate {
     guint hadess_owner_id;
 
     PowerProfile power_profile;
+    GVariant *cpuset_layout;
+    GVariant *pressure;
 };
 
 G_DEFINE_TYPE_WITH_CODE (Bus, bus, G_TYPE_OBJECT,
@@ -169,6 +171,12 @@ handle_get_property (GDBusConnection *connection,
     if (g_strcmp0 (property_name, "Profiles") == 0)
         return get_profiles_variant ();
 
+    if (g_strcmp0 (property_name, "CpusetLayout") == 0)
+        return g_variant_ref (self->priv->cpuset_layout);
+
+    if (g_strcmp0 (property_name, "Pressure") == 0)
+        return g_variant_ref (self->priv->pressure);
+
     /* On mobile devices, we use in kernel mitigation methods */
     if (g_strcmp0 (property_name, "PerformanceDegraded") == 0)
         return g_variant_new_boolean (FALSE);
@@ -340,6 +348,11 @@ bus_dispose (GObject *bus)
 static void
 bus_finalize (GObject *bus)
 {
+    Bus *self = BUS (bus);
+
+    g_variant_unref (self->priv->cpuset_layout);
+    g_variant_unref (self->priv->pressure);
+
     G_OBJECT_CLASS (bus_parent_class)->finalize (bus);
 }
 
@@ -396,6 +409,12 @@ bus_init (Bus *self)
     );
 
     self->priv->power_profile = POWER_PROFILE_BALANCED;
+    self->priv->cpuset_layout = g_variant_ref_sink (
+        g_variant_new_array (G_VARIANT_TYPE ("{ss}"), NULL, 0)
+    );
+    self->priv->pressure = g_variant_ref_sink (
+        g_variant_new_array (G_VARIANT_TYPE ("{sd}"), NULL, 0)
+    );
     self->priv->adishatz_connection = NULL;
     self->priv->hadess_connection = NULL;
 }
@@ -466,4 +485,78 @@ bus_screen_state_changed (Bus      *self,
         g_variant_new ("(b)", enabled),
         NULL
     );
-}
\ No newline at end of file
+}
+
+/**
+ * bus_set_cpuset_layout:
+ *
+ * Publish cpusets layout
+ *
+ * @self: a #Bus
+ * @layout: cpus by cpuset name, as a{ss}
+ */
+void
+bus_set_cpuset_layout (Bus      *self,
+                       GVariant *layout)
+{
+    GVariantBuilder builder;
+
+    g_variant_unref (self->priv->cpuset_layout);
+    self->priv->cpuset_layout = g_variant_ref_sink (layout);
+
+    if (self->priv->adishatz_connection == NULL)
+        return;
+
+    g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{sv}"));
+    g_variant_builder_add (
+        &builder, "{sv}", "CpusetLayout", self->priv->cpuset_layout
+    );
+    g_dbus_connection_emit_signal (
+        self->priv->adishatz_connection,
+        NULL,
+        ADISHATZ_DBUS_PATH,
+        DBUS_PROPERTIES_INTERFACE,
+        "PropertiesChanged",
+        g_variant_new (
+            "(sa{sv}as)", ADISHATZ_DBUS_NAME, &builder, NULL
+        ),
+        NULL
+    );
+}
+
+/**
+ * bus_set_pressure:
+ *
+ * Publish pressure readings
+ *
+ * @self: a #Bus
+ * @readings: stall averages by resource name, as a{sd}
+ */
+void
+bus_set_pressure (Bus      *self,
+                  GVariant *readings)
+{
+    GVariantBuilder builder;
+
+    g_variant_unref (self->priv->pressure);
+    self->priv->pressure = g_variant_ref_sink (readings);
+
+    if (self->priv->adishatz_connection == NULL)
+        return;
+
+    g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{sv}"));
+    g_variant_builder_add (
+        &builder, "{sv}", "Pressure", self->priv->pressure
+    );
+    g_dbus_connection_emit_signal (
+        self->priv->adishatz_connection,
+        NULL,
+        ADISHATZ_DBUS_PATH,
+        DBUS_PROPERTIES_INTERFACE,
+        "PropertiesChanged",
+        g_variant_new (
+            "(sa{sv}as)", ADISHATZ_DBUS_NAME, &builder, NULL
+        ),
+        NULL
+    );
+}
@@ -46,6 +46,10 @@ GObject*    bus_new                  (void);
 Bus        *bus_get_default          (void);
 void        bus_screen_state_changed (Bus      *self,
                                       gboolean  enabled);
+void        bus_set_cpuset_layout    (Bus      *self,
+                                      GVariant *layout);
+void        bus_set_pressure         (Bus      *self,
+                                      GVariant *readings);
 void        bus_free_default         (void);
 
 G_END_DECLS
@@ -0,0 +1,387 @@
+/*
+ * Copyright Cedric Bellegarde <cedric.bellegarde@adishatz.org>
+ */
+
+#include <string.h>
+
+#include <gio/gio.h>
+
+#include "capabilities.h"
+#include "../common/define.h"
+#include "../common/utils.h"
+
+#define CAPABILITIES_FILE CACHE_DIR "/capabilities"
+
+/*
+ * Sysfs nodes we only read (available governors, frequency tables,
+ * topology...) and knobs existence do not change for a given kernel on
+ * a given device: cache them on disk, keyed by kernel release and
+ * device model, so next starts skip probing. Directories are still
+ * listed at each start: drivers may be loaded late.
+ *
+ * Groups:
+ * - device: kernel and model the cache is for
+ * - files: path -> contents
+ * - exists: path -> TRUE/FALSE
+ * - probes: probe name -> values
+ */
+
+struct _CapabilitiesPrivate {
+    GKeyFile *cache;
+    gboolean dirty;
+};
+
+G_DEFINE_TYPE_WITH_CODE (
+    Capabilities,
+    capabilities,
+    G_TYPE_OBJECT,
+    G_ADD_PRIVATE (Capabilities)
+)
+
+static char *
+read_kernel_release (void)
+{
+    g_autofree char *path = get_root_path ("/proc/sys/kernel/osrelease");
+    char *contents = NULL;
+
+    if (!g_file_get_contents (path, &contents, NULL, NULL))
+        return g_strdup ("unknown");
+
+    return g_strstrip (contents);
+}
+
+static char *
+read_device_model (void)
+{
+    g_autofree char *compatible_path = get_root_path (
+        "/proc/device-tree/compatible"
+    );
+    g_autofree char *product_path = get_root_path (
+        "/sys/class/dmi/id/product_name"
+    );
+    char *contents = NULL;
+
+    /* First entry of a NUL separated list, most specific one */
+    if (g_file_get_contents (compatible_path, &contents, NULL, NULL))
+        return contents;
+
+    if (g_file_get_contents (product_path, &contents, NULL, NULL))
+        return g_strstrip (contents);
+
+    return g_strdup ("unknown");
+}
+
+static void
+load_cache (Capabilities *self)
+{
+    g_autofree char *filename = get_root_path (CAPABILITIES_FILE);
+    g_autofree char *kernel = read_kernel_release ();
+    g_autofree char *model = read_device_model ();
+    g_autofree char *cached_kernel = NULL;
+    g_autofree char *cached_model = NULL;
+
+    if (g_key_file_load_from_file (
+            self->priv->cache, filename, G_KEY_FILE_NONE, NULL)) {
+        cached_kernel = g_key_file_get_string (
+            self->priv->cache, "device", "kernel", NULL
+        );
+        cached_model = g_key_file_get_string (
+            self->priv->cache, "device", "model", NULL
+        );
+
+        if (g_strcmp0 (kernel, cached_kernel) == 0 &&
+                g_strcmp0 (model, cached_model) == 0) {
+            g_message ("Using capabilities from %s", filename);
+            return;
+        }
+
+        g_message ("Kernel or device changed: probing capabilities");
+        g_key_file_free (self->priv->cache);
+        self->priv->cache = g_key_file_new ();
+    }
+
+    g_key_file_set_string (self->priv->cache, "device", "kernel", kernel);
+    g_key_file_set_string (self->priv->cache, "device", "model", model);
+    self->priv->dirty = TRUE;
+}
+
+static void
+capabilities_dispose (GObject *capabilities)
+{
+    Capabilities *self = CAPABILITIES (capabilities);
+
+    /* Nodes probed after startup, like available governors */
+    capabilities_save (self);
+
+    G_OBJECT_CLASS (capabilities_parent_class)->dispose (capabilities);
+}
+
+static void
+capabilities_finalize (GObject *capabilities)
+{
+    Capabilities *self = CAPABILITIES (capabilities);
+
+    g_key_file_free (self->priv->cache);
+
+    G_OBJECT_CLASS (capabilities_parent_class)->finalize (capabilities);
+}
+
+static void
+capabilities_class_init (CapabilitiesClass *klass)
+{
+    GObjectClass *object_class;
+
+    object_class = G_OBJECT_CLASS (klass);
+    object_class->dispose = capabilities_dispose;
+    object_class->finalize = capabilities_finalize;
+}
+
+static void
+capabilities_init (Capabilities *self)
+{
+    self->priv = capabilities_get_instance_private (self);
+
+    self->priv->cache = g_key_file_new ();
+    self->priv->dirty = FALSE;
+
+    load_cache (self);
+}
+
+/**
+ * capabilities_new:
+ *
+ * Creates a new #Capabilities
+ *
+ * Returns: (transfer full): a new #Capabilities
+ *
+ **/
+GObject *
+capabilities_new (void)
+{
+    GObject *capabilities;
+
+    capabilities = g_object_new (TYPE_CAPABILITIES, NULL);
+
+    return capabilities;
+}
+
+static Capabilities *default_capabilities = NULL;
+/**
+ * capabilities_get_default:
+ *
+ * Gets the default #Capabilities.
+ *
+ * Return value: (transfer none): the default #Capabilities.
+ */
+Capabilities *
+capabilities_get_default (void)
+{
+    if (default_capabilities == NULL)
+        default_capabilities = CAPABILITIES (capabilities_new ());
+
+    return default_capabilities;
+}
+
+/**
+ * capabilities_free_default:
+ *
+ * Free the default #Capabilities.
+ *
+ */
+void
+capabilities_free_default (void)
+{
+    g_clear_object (&default_capabilities);
+}
+
+/**
+ * capabilities_save:
+ *
+ * Save probed capabilities, if any
+ *
+ * @self: a #Capabilities
+ */
+void
+capabilities_save (Capabilities *self)
+{
+    g_autofree char *cache_dir = get_root_path (CACHE_DIR);
+    g_autofree char *filename = get_root_path (CAPABILITIES_FILE);
+    g_autoptr (GError) error = NULL;
+
+    if (!self->priv->dirty)
+        return;
+
+    g_mkdir_with_parents (cache_dir, 0755);
+
+    if (!g_key_file_save_to_file (self->priv->cache, filename, &error)) {
+        g_warning ("Can't save %s: %s", filename, error->message);
+        return;
+    }
+
+    self->priv->dirty = FALSE;
+}
+
+/**
+ * capabilities_read:
+ *
+ * Read a sysfs node that never changes for this kernel
+ *
+ * @self: a #Capabilities
+ * @path: node path
+ *
+ * Returns: (transfer full) (nullable): contents without trailing
+ *          newline, NULL if node can't be read
+ */
+char *
+capabilities_read (Capabilities *self,
+                   const char   *path)
+{
+    g_autofree char *contents = NULL;
+
+    if (g_key_file_has_key (self->priv->cache, "files", path, NULL))
+        return g_key_file_get_string (self->priv->cache, "files", path, NULL);
+
+    if (g_key_file_has_key (self->priv->cache, "exists", path, NULL) &&
+            !g_key_file_get_boolean (self->priv->cache, "exists", path, NULL))
+        return NULL;
+
+    if (!g_file_get_contents (path, &contents, NULL, NULL)) {
+        g_key_file_set_boolean (self->priv->cache, "exists", path, FALSE);
+        self->priv->dirty = TRUE;
+        return NULL;
+    }
+
+    g_strchomp (contents);
+    g_key_file_set_string (self->priv->cache, "files", path, contents);
+    self->priv->dirty = TRUE;
+
+    return g_steal_pointer (&contents);
+}
+
+/**
+ * capabilities_exists:
+ *
+ * Check a sysfs node exists
+ *
+ * @self: a #Capabilities
+ * @path: node path
+ *
+ * Returns: TRUE if node exists
+ */
+gboolean
+capabilities_exists (Capabilities *self,
+                     const char   *path)
+{
+    gboolean exists;
+
+    if (g_key_file_has_key (self->priv->cache, "exists", path, NULL))
+        return g_key_file_get_boolean (
+            self->priv->cache, "exists", path, NULL
+        );
+
+    if (g_key_file_has_key (self->priv->cache, "files", path, NULL))
+        return TRUE;
+
+    exists = g_file_test (path, G_FILE_TEST_EXISTS);
+    g_key_file_set_boolean (self->priv->cache, "exists", path, exists);
+    self->priv->dirty = TRUE;
+
+    return exists;
+}
+
+/**
+ * capabilities_has_governor:
+ *
+ * Check governor is available
+ *
+ * @self: a #Capabilities
+ * @available_path: available governors node
+ * @governor: a governor
+ *
+ * Returns: FALSE if governor is known to be unavailable
+ */
+gboolean
+capabilities_has_governor (Capabilities *self,
+                           const char   *available_path,
+                           const char   *governor)
+{
+    g_autofree char *available = capabilities_read (self, available_path);
+    g_autofree char *padded_available = NULL;
+    g_autofree char *padded_governor = NULL;
+
+    /* Can't tell: let the kernel decide */
+    if (available == NULL)
+        return TRUE;
+
+    padded_available = g_strdup_printf (" %s ", available);
+    padded_governor = g_strdup_printf (" %s ", governor);
+
+    return strstr (padded_available, padded_governor) != NULL;
+}
+
+/**
+ * capabilities_get_probe:
+ *
+ * Get values of an expensive probe
+ *
+ * @self: a #Capabilities
+ * @probe: probe name
+ * @values: (out) (transfer full) (element-type utf8): probe values
+ *
+ * Returns: TRUE if probe is cached
+ */
+gboolean
+capabilities_get_probe (Capabilities  *self,
+                        const char    *probe,
+                        GList        **values)
+{
+    char **strings;
+    gsize length;
+    gsize i;
+
+    *values = NULL;
+
+    if (!g_key_file_has_key (self->priv->cache, "probes", probe, NULL))
+        return FALSE;
+
+    strings = g_key_file_get_string_list (
+        self->priv->cache, "probes", probe, &length, NULL
+    );
+    if (strings == NULL)
+        return TRUE;
+
+    for (i = 0; i < length; i++)
+        *values = g_list_append (*values, strings[i]);
+    g_free (strings);
+
+    return TRUE;
+}
+
+/**
+ * capabilities_set_probe:
+ *
+ * Set values of an expensive probe
+ *
+ * @self: a #Capabilities
+ * @probe: probe name
+ * @values: (element-type utf8): probe values
+ */
+void
+capabilities_set_probe (Capabilities *self,
+                        const char   *probe,
+                        GList        *values)
+{
+    g_autofree const char **strings = g_new0 (
+        const char *, g_list_length (values) + 1
+    );
+    const char *value;
+    guint i = 0;
+
+    GFOREACH (values, value)
+        strings[i++] = value;
+
+    g_key_file_set_string_list (
+        self->priv->cache, "probes", probe, strings, i
+    );
+    self->priv->dirty = TRUE;
+}
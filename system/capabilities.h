@@ -0,0 +1,66 @@
+/*
+ * Copyright Cedric Bellegarde <cedric.bellegarde@adishatz.org>
+ */
+
+#ifndef CAPABILITIES_H
+#define CAPABILITIES_H
+
+#include <glib.h>
+#include <glib-object.h>
+
+#define TYPE_CAPABILITIES \
+    (capabilities_get_type ())
+#define CAPABILITIES(obj) \
+    (G_TYPE_CHECK_INSTANCE_CAST \
+    ((obj), TYPE_CAPABILITIES, Capabilities))
+#define CAPABILITIES_CLASS(cls) \
+    (G_TYPE_CHECK_CLASS_CAST \
+    ((cls), TYPE_CAPABILITIES, CapabilitiesClass))
+#define IS_CAPABILITIES(obj) \
+    (G_TYPE_CHECK_INSTANCE_TYPE \
+    ((obj), TYPE_CAPABILITIES))
+#define IS_CAPABILITIES_CLASS(cls) \
+    (G_TYPE_CHECK_CLASS_TYPE \
+    ((cls), TYPE_CAPABILITIES))
+#define CAPABILITIES_GET_CLASS(obj) \
+    (G_TYPE_INSTANCE_GET_CLASS \
+    ((obj), TYPE_CAPABILITIES, CapabilitiesClass))
+
+G_BEGIN_DECLS
+
+typedef struct _Capabilities Capabilities;
+typedef struct _CapabilitiesClass CapabilitiesClass;
+typedef struct _CapabilitiesPrivate CapabilitiesPrivate;
+
+struct _Capabilities {
+    GObject parent;
+    CapabilitiesPrivate *priv;
+};
+
+struct _CapabilitiesClass {
+    GObjectClass parent_class;
+};
+
+GType           capabilities_get_type           (void) G_GNUC_CONST;
+
+GObject*        capabilities_new                (void);
+Capabilities   *capabilities_get_default        (void);
+void            capabilities_free_default       (void);
+void            capabilities_save               (Capabilities *self);
+char           *capabilities_read               (Capabilities *self,
+                                                 const char   *path);
+gboolean        capabilities_exists             (Capabilities *self,
+                                                 const char   *path);
+gboolean        capabilities_has_governor       (Capabilities *self,
+                                                 const char   *available_path,
+                                                 const char   *governor);
+gboolean        capabilities_get_probe          (Capabilities *self,
+                                                 const char   *probe,
+                                                 GList       **values);
+void            capabilities_set_probe          (Capabilities *self,
+                                                 const char   *probe,
+                                                 GList        *values);
+
+G_END_DECLS
+
+#endif
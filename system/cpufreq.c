@@ -7,13 +7,22 @@
 
 #include <gio/gio.h>
 
+#include "capabilities.h"
 #include "cpufreq.h"
 #include "cpufreq_device.h"
+#include "hotplug.h"
+#include "topology.h"
 #include "../common/define.h"
+#include "../common/reconciler.h"
 #include "../common/utils.h"
 
 struct _CpufreqPrivate {
     GList *cpufreq_devices;
+    Hotplug *hotplug;
+
+    DozeLevel doze_level;
+    PowerProfile power_profile;
+    gboolean little_powersave;
 };
 
 G_DEFINE_TYPE_WITH_CODE (
@@ -23,32 +32,197 @@ G_DEFINE_TYPE_WITH_CODE (
     G_ADD_PRIVATE (Cpufreq)
 )
 
+/*
+ * Per cluster maximal frequency, in percent of cluster maximal
+ * frequency, snapped to an available frequency: 100 is uncapped, 0 is
+ * lowest frequency. Governor is kept, so capped clusters still scale
+ * under their cap instead of being pinned by powersave governor.
+ *
+ * Prime cluster is capped first, mid cluster follows when dozing.
+ * Little cluster is only capped when user daemon reports no active
+ * application.
+ */
+static const guint doze_caps[DOZE_LEVEL_LAST][CPU_CLUSTER_LAST] = {
+    /*                          little mid  prime */
+    [DOZE_LEVEL_SCREEN_ON]  = { 100,   100, 100 },
+    [DOZE_LEVEL_SCREEN_OFF] = { 100,   70,  50  },
+    [DOZE_LEVEL_LIGHT]      = { 100,   50,  30  },
+    [DOZE_LEVEL_MEDIUM]     = { 100,   40,  0   },
+    [DOZE_LEVEL_FULL]       = { 100,   30,  0   },
+};
+
+static const guint profile_caps[POWER_PROFILE_LAST][CPU_CLUSTER_LAST] = {
+    /*                               little mid  prime */
+    [POWER_PROFILE_POWER_SAVER]  = { 60,    50,  40  },
+    [POWER_PROFILE_BALANCED]     = { 100,   100, 100 },
+    [POWER_PROFILE_PERFORMANCE]  = { 100,   100, 100 },
+};
+
+/* NULL means default governor */
+static const char *profile_governors[POWER_PROFILE_LAST][CPU_CLUSTER_LAST] = {
+    /*                               little         mid            prime */
+    [POWER_PROFILE_POWER_SAVER]  = { NULL,          NULL,          NULL },
+    [POWER_PROFILE_BALANCED]     = { NULL,          NULL,          NULL },
+    [POWER_PROFILE_PERFORMANCE]  = { "performance", "performance", "performance" },
+};
+
+/*
+ * Governor tunables: rate limits are in us. CAF kernels split
+ * rate_limit_us in up/down rate limits and add iowait_boost_enable.
+ * Missing nodes are ignored.
+ */
+static const CpufreqTunable screen_on_tunables[] = {
+    /* Ramp up fast, stay at OPP for a while: avoids frame drops */
+    { "schedutil", "up_rate_limit_us",    "500"   },
+    { "schedutil", "down_rate_limit_us",  "20000" },
+    { NULL }
+};
+
+static const CpufreqTunable screen_off_tunables[] = {
+    /* Ramp up lazily, leave high OPPs as soon as possible */
+    { "schedutil", "rate_limit_us",       "10000" },
+    { "schedutil", "up_rate_limit_us",    "10000" },
+    { "schedutil", "down_rate_limit_us",  "0"     },
+    { "schedutil", "iowait_boost_enable", "0"     },
+    { NULL }
+};
+
+static const CpufreqTunable power_saver_tunables[] = {
+    { "schedutil", "rate_limit_us",       "5000"  },
+    { "schedutil", "up_rate_limit_us",    "5000"  },
+    { "schedutil", "down_rate_limit_us",  "0"     },
+    { "schedutil", "iowait_boost_enable", "0"     },
+    { NULL }
+};
+
+static const CpufreqTunable *profile_tunables[POWER_PROFILE_LAST][2] = {
+    /*                               screen on             screen off */
+    [POWER_PROFILE_POWER_SAVER]  = { power_saver_tunables, screen_off_tunables },
+    [POWER_PROFILE_BALANCED]     = { screen_on_tunables,   screen_off_tunables },
+    [POWER_PROFILE_PERFORMANCE]  = { NULL,                 NULL },
+};
+
+static CpuCluster
+get_cluster_role (guint capacity,
+                  guint min_capacity,
+                  guint max_capacity)
+{
+    if (capacity == min_capacity)
+        return CPU_CLUSTER_LITTLE;
+    if (capacity == max_capacity)
+        return CPU_CLUSTER_PRIME;
+    return CPU_CLUSTER_MID;
+}
+
+static guint
+get_cap (Cpufreq    *self,
+         CpuCluster  cluster)
+{
+    guint cap = doze_caps[self->priv->doze_level][cluster];
+
+    if (cluster == CPU_CLUSTER_LITTLE &&
+            self->priv->little_powersave &&
+            self->priv->doze_level >= DOZE_LEVEL_LIGHT)
+        cap = 0;
+
+    return MIN (cap, profile_caps[self->priv->power_profile][cluster]);
+}
+
+static void
+apply_policies (Cpufreq *self)
+{
+    CpufreqDevice *cpufreq_device;
+    gboolean screen_off = self->priv->doze_level != DOZE_LEVEL_SCREEN_ON;
+    const CpufreqTunable *tunables =
+        profile_tunables[self->priv->power_profile][screen_off];
+
+    reconciler_journal_set_priority (
+        reconciler_get_default (), RECONCILER_PRIORITY_CPUFREQ
+    );
+
+    GFOREACH (self->priv->cpufreq_devices, cpufreq_device) {
+        FreqDevice *freq_device = FREQ_DEVICE (cpufreq_device);
+        CpuCluster cluster = cpufreq_device_get_cluster (cpufreq_device);
+
+        cpufreq_device_set_tunables (cpufreq_device, tunables);
+
+        freq_device_set_limits (
+            freq_device,
+            0,
+            freq_device_get_frequency (freq_device, get_cap (self, cluster))
+        );
+    }
+
+    reconciler_journal_set_priority (
+        reconciler_get_default (), RECONCILER_PRIORITY_NONE
+    );
+}
+
+static void
+park_cores (Cpufreq *self)
+{
+    CpufreqDevice *cpufreq_device;
+    g_autoptr (GArray) cpu_ids = g_array_new (FALSE, FALSE, sizeof (guint));
+
+    /* Little cluster handles deep doze alone */
+    GFOREACH (self->priv->cpufreq_devices, cpufreq_device) {
+        const guint *cpus;
+        guint count;
+
+        if (cpufreq_device_get_cluster (cpufreq_device) == CPU_CLUSTER_LITTLE)
+            continue;
+
+        cpus = cpufreq_device_get_cpus (cpufreq_device, &count);
+        g_array_append_vals (cpu_ids, cpus, count);
+    }
+
+    hotplug_park (self->priv->hotplug, (guint *) cpu_ids->data, cpu_ids->len);
+}
+
 static void
 detect_devices (Cpufreq *self)
 {
-    g_autoptr (GDir) policies_dir = NULL;
-    const char *policy_dir;
+    GList *clusters = topology_get_clusters (topology_get_default ());
+    g_autofree char *sysfs_dir = get_root_path (CPUFREQ_POLICIES_DIR);
+    TopologyCluster *cluster;
+    guint min_capacity = G_MAXUINT;
+    guint max_capacity = 0;
 
-    policies_dir = g_dir_open (CPUFREQ_POLICIES_DIR, 0, NULL);
-    if (policies_dir == NULL) {
-        g_warning ("No cpufreq sysfs dir: %s", CPUFREQ_POLICIES_DIR);
+    if (clusters == NULL) {
+        g_warning ("No cpufreq sysfs dir: %s", sysfs_dir);
         return;
     }
 
-    while ((policy_dir = g_dir_read_name (policies_dir)) != NULL) {
-        CpufreqDevice *cpufreq_device = CPUFREQ_DEVICE (cpufreq_device_new ());
+    GFOREACH (clusters, cluster) {
+        min_capacity = MIN (min_capacity, cluster->capacity);
+        max_capacity = MAX (max_capacity, cluster->capacity);
+    }
+
+    GFOREACH (clusters, cluster) {
+        CpufreqDevice *cpufreq_device;
+        CpuCluster role;
         g_autofree char *filename = g_build_filename (
-            CPUFREQ_POLICIES_DIR, policy_dir, "scaling_governor", NULL
+            sysfs_dir, cluster->policy, "scaling_governor", NULL
         );
 
-        if (!g_file_test (filename, G_FILE_TEST_EXISTS)) {
-            g_object_unref (cpufreq_device);
+        if (!capabilities_exists (capabilities_get_default (), filename))
             continue;
-        }
 
-        freq_device_set_name (FREQ_DEVICE (cpufreq_device), policy_dir);
+        role = get_cluster_role (
+            cluster->capacity, min_capacity, max_capacity
+        );
+        cpufreq_device = CPUFREQ_DEVICE (cpufreq_device_new ());
+        freq_device_set_name (FREQ_DEVICE (cpufreq_device), cluster->policy);
+        cpufreq_device_set_cluster (cpufreq_device, role, cluster);
+
+        g_message (
+            "CPU cluster %s: %s",
+            cluster->policy,
+            role == CPU_CLUSTER_LITTLE ? "little" :
+                role == CPU_CLUSTER_MID ? "mid" : "prime"
+        );
 
-        self->priv->cpufreq_devices = g_list_prepend (
+        self->priv->cpufreq_devices = g_list_append (
             self->priv->cpufreq_devices, cpufreq_device
         );
     }
@@ -57,6 +231,10 @@ detect_devices (Cpufreq *self)
 static void
 cpufreq_dispose (GObject *cpufreq)
 {
+    Cpufreq *self = CPUFREQ (cpufreq);
+
+    g_clear_object (&self->priv->hotplug);
+
     G_OBJECT_CLASS (cpufreq_parent_class)->dispose (cpufreq);
 }
 
@@ -86,6 +264,10 @@ cpufreq_init (Cpufreq *self)
     self->priv = cpufreq_get_instance_private (self);
 
     self->priv->cpufreq_devices = NULL;
+    self->priv->hotplug = HOTPLUG (hotplug_new ());
+    self->priv->doze_level = DOZE_LEVEL_SCREEN_ON;
+    self->priv->power_profile = POWER_PROFILE_BALANCED;
+    self->priv->little_powersave = FALSE;
 
     detect_devices (self);
 }
@@ -109,38 +291,101 @@ cpufreq_new (void)
 }
 
 /**
- * cpufreq_set_powersave:
+ * cpufreq_set_doze_level:
  *
- * Set cpufreq devices to powersave
+ * Apply cluster caps for doze level
  *
  * @param #Cpufreq
- * @param powersave: True to enable powersave
- * @param little_cluster: if TRUE, apply to little cluster too
+ * @param doze_level: a #DozeLevel
  */
 void
-cpufreq_set_powersave (Cpufreq  *cpufreq,
-                       gboolean  powersave,
-                       gboolean    little_cluster) {
-    CpufreqDevice *cpufreq_device;
+cpufreq_set_doze_level (Cpufreq   *cpufreq,
+                        DozeLevel  doze_level)
+{
+    g_return_if_fail (doze_level < DOZE_LEVEL_LAST);
+
+    /* User daemon reports little cluster state on each doze */
+    if (doze_level == DOZE_LEVEL_SCREEN_ON)
+        cpufreq->priv->little_powersave = FALSE;
+
+    /* Cores first: screen on and maintenance work need them */
+    if (doze_level != DOZE_LEVEL_FULL)
+        hotplug_unpark (cpufreq->priv->hotplug);
+
+    /* Then frequencies we had before screen off, without reading them */
+    if (doze_level == DOZE_LEVEL_SCREEN_ON)
+        reconciler_journal_replay (
+            reconciler_get_default (), RECONCILER_PRIORITY_CPUFREQ
+        );
 
-    GFOREACH (cpufreq->priv->cpufreq_devices, cpufreq_device)
-        if (little_cluster || !cpufreq_is_little (cpufreq_device))
-            freq_device_set_powersave (FREQ_DEVICE (cpufreq_device), powersave);
+    cpufreq->priv->doze_level = doze_level;
+    apply_policies (cpufreq);
+
+    /* Inactive policies reject limits: park last */
+    if (doze_level == DOZE_LEVEL_FULL)
+        park_cores (cpufreq);
+}
+
+/**
+ * cpufreq_set_little_powersave:
+ *
+ * Allow little cluster to be capped while dozing
+ *
+ * @param #Cpufreq
+ * @param powersave: True to allow capping
+ */
+void
+cpufreq_set_little_powersave (Cpufreq  *cpufreq,
+                              gboolean  powersave)
+{
+    cpufreq->priv->little_powersave = powersave;
+    apply_policies (cpufreq);
 }
 
 /**
- * cpufreq_set_governor:
+ * cpufreq_set_power_profile:
  *
- * Set cpufreq devices governor
+ * Apply cluster governors and caps for power profile
  *
  * @param #Cpufreq
- * @param governor: new governor to set
+ * @param power_profile: a #PowerProfile
  */
 void
-cpufreq_set_governor (Cpufreq    *cpufreq,
-                      const char *governor) {
+cpufreq_set_power_profile (Cpufreq      *cpufreq,
+                           PowerProfile  power_profile)
+{
     CpufreqDevice *cpufreq_device;
 
-    GFOREACH (cpufreq->priv->cpufreq_devices, cpufreq_device)
-        freq_device_set_governor (FREQ_DEVICE (cpufreq_device), governor);
-}
\ No newline at end of file
+    g_return_if_fail (power_profile < POWER_PROFILE_LAST);
+
+    cpufreq->priv->power_profile = power_profile;
+
+    GFOREACH (cpufreq->priv->cpufreq_devices, cpufreq_device) {
+        CpuCluster cluster = cpufreq_device_get_cluster (cpufreq_device);
+
+        freq_device_set_governor (
+            FREQ_DEVICE (cpufreq_device),
+            profile_governors[power_profile][cluster]
+        );
+    }
+
+    apply_policies (cpufreq);
+}
+
+/**
+ * cpufreq_set_core_parking:
+ *
+ * Set how cores are parked in deep doze
+ *
+ * @param #Cpufreq
+ * @param mode: a #HotplugMode
+ */
+void
+cpufreq_set_core_parking (Cpufreq     *cpufreq,
+                          HotplugMode  mode)
+{
+    hotplug_set_mode (cpufreq->priv->hotplug, mode);
+
+    if (cpufreq->priv->doze_level == DOZE_LEVEL_FULL)
+        park_cores (cpufreq);
+}
@@ -8,6 +8,9 @@
 #include <glib.h>
 #include <glib-object.h>
 
+#include "hotplug.h"
+#include "../common/define.h"
+
 #define TYPE_CPUFREQ \
     (cpufreq_get_type ())
 #define CPUFREQ(obj) \
@@ -44,11 +47,14 @@ struct _CpufreqClass {
 GType           cpufreq_get_type            (void) G_GNUC_CONST;
 
 GObject*        cpufreq_new                 (void);
-void            cpufreq_set_powersave       (Cpufreq  *cpufreq,
-                                             gboolean  powersave,
-                                             gboolean  little_cluster);
-void            cpufreq_set_governor        (Cpufreq    *cpufreq,
-                                             const char *governor);
+void            cpufreq_set_doze_level      (Cpufreq      *cpufreq,
+                                             DozeLevel     doze_level);
+void            cpufreq_set_little_powersave(Cpufreq      *cpufreq,
+                                             gboolean      powersave);
+void            cpufreq_set_power_profile   (Cpufreq      *cpufreq,
+                                             PowerProfile  power_profile);
+void            cpufreq_set_core_parking    (Cpufreq      *cpufreq,
+                                             HotplugMode   mode);
 
 G_END_DECLS
 
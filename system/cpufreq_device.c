@@ -4,31 +4,215 @@
 
 #include <stdio.h>
 #include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include <gio/gio.h>
 
+#include "capabilities.h"
 #include "cpufreq_device.h"
 #include "../common/define.h"
+#include "../common/reconciler.h"
+#include "../common/utils.h"
 
-/* struct _CpufreqDevicePrivate { */
-/* }; */
+#define TUNABLES_FILE RUNTIME_DIR "/tunables-defaults"
+#define TUNABLES_GROUP "defaults"
+
+struct _CpufreqDevicePrivate {
+    CpuCluster cluster;
+    guint *cpu_ids;
+    guint cpus_count;
+
+    guint min_freq;
+    guint max_freq;
+
+    /* Tunable path -> value before we touched it */
+    GHashTable *saved_tunables;
+};
 
 G_DEFINE_TYPE_WITH_CODE (
     CpufreqDevice,
     cpufreq_device,
     TYPE_FREQ_DEVICE,
-    /* G_ADD_PRIVATE (CpufreqDevice) */
+    G_ADD_PRIVATE (CpufreqDevice)
 )
 
+static guint
+read_frequency (CpufreqDevice *self,
+                const char    *node)
+{
+    g_autofree char *sysfs_dir = get_root_path (CPUFREQ_POLICIES_DIR);
+    g_autofree char *filename = NULL;
+    g_autofree char *contents = NULL;
+
+    filename = g_build_filename (
+        sysfs_dir, freq_device_get_name (FREQ_DEVICE (self)), node, NULL
+    );
+    contents = capabilities_read (capabilities_get_default (), filename);
+    if (contents == NULL)
+        return 0;
+
+    return strtoul (contents, NULL, 10);
+}
+
+static void
+read_frequencies (CpufreqDevice *self)
+{
+    self->priv->min_freq = read_frequency (self, "cpuinfo_min_freq");
+    self->priv->max_freq = read_frequency (self, "cpuinfo_max_freq");
+
+    freq_device_load_frequencies (
+        FREQ_DEVICE (self),
+        "scaling_available_frequencies",
+        self->priv->min_freq,
+        self->priv->max_freq
+    );
+}
+
+static char *
+get_tunable_path (CpufreqDevice *self,
+                  const char    *governor,
+                  const char    *node)
+{
+    g_autofree char *sysfs_dir = get_root_path (CPUFREQ_POLICIES_DIR);
+
+    return g_build_filename (
+        sysfs_dir,
+        freq_device_get_name (FREQ_DEVICE (self)),
+        governor,
+        node,
+        NULL
+    );
+}
+
+/*
+ * Tunables values before we first touched them are snapshotted in
+ * /run: a restarted daemon restores them instead of taking its
+ * predecessor values for defaults.
+ */
+static void
+load_saved_tunables (CpufreqDevice *self)
+{
+    g_autoptr (GKeyFile) key_file = g_key_file_new ();
+    g_autofree char *filename = get_root_path (TUNABLES_FILE);
+    g_autofree char *sysfs_dir = get_root_path (CPUFREQ_POLICIES_DIR);
+    g_autofree char *device_dir = g_build_filename (
+        sysfs_dir, freq_device_get_name (FREQ_DEVICE (self)), "", NULL
+    );
+    g_auto (GStrv) paths = NULL;
+    gint i;
+
+    if (!g_key_file_load_from_file (key_file, filename, G_KEY_FILE_NONE, NULL))
+        return;
+
+    paths = g_key_file_get_keys (key_file, TUNABLES_GROUP, NULL, NULL);
+    for (i = 0; paths != NULL && paths[i] != NULL; i++) {
+        if (!g_str_has_prefix (paths[i], device_dir))
+            continue;
+
+        g_hash_table_insert (
+            self->priv->saved_tunables,
+            g_strdup (paths[i]),
+            g_key_file_get_string (key_file, TUNABLES_GROUP, paths[i], NULL)
+        );
+    }
+}
+
+static char *
+read_saved_tunable (const char *path)
+{
+    g_autoptr (GKeyFile) key_file = g_key_file_new ();
+    g_autofree char *runtime_dir = get_root_path (RUNTIME_DIR);
+    g_autofree char *filename = get_root_path (TUNABLES_FILE);
+    g_autofree char *contents = NULL;
+    g_autoptr (GError) error = NULL;
+    char *value;
+
+    g_key_file_load_from_file (key_file, filename, G_KEY_FILE_NONE, NULL);
+
+    /* Saved by a previous instance: tunable may hold our value */
+    value = g_key_file_get_string (key_file, TUNABLES_GROUP, path, NULL);
+    if (value != NULL)
+        return value;
+
+    if (!g_file_get_contents (path, &contents, NULL, NULL))
+        return NULL;
+
+    g_key_file_set_string (
+        key_file, TUNABLES_GROUP, path, g_strchomp (contents)
+    );
+    g_mkdir_with_parents (runtime_dir, 0755);
+    if (!g_key_file_save_to_file (key_file, filename, &error))
+        g_warning ("Can't save tunables defaults: %s", error->message);
+
+    return g_steal_pointer (&contents);
+}
+
+static gboolean
+tunables_contain (CpufreqDevice        *self,
+                  const CpufreqTunable *tunables,
+                  const char           *path)
+{
+    const char *governor = freq_device_get_governor (FREQ_DEVICE (self));
+
+    for (; tunables != NULL && tunables->governor != NULL; tunables++) {
+        g_autofree char *tunable_path = NULL;
+
+        if (g_strcmp0 (tunables->governor, governor) != 0)
+            continue;
+
+        tunable_path = get_tunable_path (self, governor, tunables->node);
+        if (g_strcmp0 (tunable_path, path) == 0)
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
+static void
+restore_tunables (CpufreqDevice        *self,
+                  const CpufreqTunable *tunables)
+{
+    GHashTableIter iter;
+    gpointer path;
+    gpointer value;
+
+    g_hash_table_iter_init (&iter, self->priv->saved_tunables);
+    while (g_hash_table_iter_next (&iter, &path, &value)) {
+        if (tunables_contain (self, tunables, path))
+            continue;
+
+        /* Governor changed: kernel dropped its tunables */
+        if (g_file_test (path, G_FILE_TEST_EXISTS)) {
+            g_message ("%s -> %s", (char *) path, (char *) value);
+            reconciler_set (reconciler_get_default (), path, value, FALSE);
+        } else {
+            reconciler_forget (reconciler_get_default (), path);
+        }
+
+        g_hash_table_iter_remove (&iter);
+    }
+}
+
 static void
 cpufreq_device_dispose (GObject *cpufreq_device)
 {
+    CpufreqDevice *self = CPUFREQ_DEVICE (cpufreq_device);
+
+    if (self->priv->saved_tunables != NULL)
+        restore_tunables (self, NULL);
+
     G_OBJECT_CLASS (cpufreq_device_parent_class)->dispose (cpufreq_device);
 }
 
 static void
 cpufreq_device_finalize (GObject *cpufreq_device)
 {
+    CpufreqDevice *self = CPUFREQ_DEVICE (cpufreq_device);
+
+    g_free (self->priv->cpu_ids);
+    g_clear_pointer (&self->priv->saved_tunables, g_hash_table_destroy);
+
     G_OBJECT_CLASS (cpufreq_device_parent_class)->finalize (cpufreq_device);
 }
 
@@ -45,10 +229,27 @@ cpufreq_device_class_init (CpufreqDeviceClass *klass)
 static void
 cpufreq_device_init (CpufreqDevice *self)
 {
+    g_autofree char *sysfs_dir = get_root_path (CPUFREQ_POLICIES_DIR);
+
     self->priv = cpufreq_device_get_instance_private (self);
 
+    self->priv->cluster = CPU_CLUSTER_LITTLE;
+    self->priv->cpu_ids = NULL;
+    self->priv->cpus_count = 0;
+    self->priv->min_freq = 0;
+    self->priv->max_freq = 0;
+    self->priv->saved_tunables = g_hash_table_new_full (
+        g_str_hash, g_str_equal, g_free, g_free
+    );
+
     freq_device_set_sysfs_settings (
-        FREQ_DEVICE (self), CPUFREQ_POLICIES_DIR, "scaling_governor"
+        FREQ_DEVICE (self),
+        sysfs_dir,
+        "scaling_governor",
+        "scaling_available_governors"
+    );
+    freq_device_set_limit_nodes (
+        FREQ_DEVICE (self), "scaling_min_freq", "scaling_max_freq"
     );
 }
 
@@ -71,19 +272,147 @@ cpufreq_device_new (void)
 }
 
 /**
- * cpufreq_is_little:
+ * cpufreq_device_set_cluster:
+ *
+ * Bind #CpufreqDevice to a topology cluster and load its frequency
+ * table. Device name must be set.
+ *
+ * @param #CpufreqDevice
+ * @param cluster: cluster role
+ * @param topology_cluster: a #TopologyCluster
+ *
+ **/
+void
+cpufreq_device_set_cluster (CpufreqDevice         *self,
+                            CpuCluster             cluster,
+                            const TopologyCluster *topology_cluster)
+{
+    self->priv->cluster = cluster;
+
+    g_free (self->priv->cpu_ids);
+    self->priv->cpus_count = topology_cluster->cpus_count;
+    self->priv->cpu_ids = g_new (guint, topology_cluster->cpus_count);
+    memcpy (
+        self->priv->cpu_ids,
+        topology_cluster->cpu_ids,
+        topology_cluster->cpus_count * sizeof (guint)
+    );
+
+    read_frequencies (self);
+    load_saved_tunables (self);
+}
+
+/**
+ * cpufreq_device_get_cluster:
+ *
+ * Get #CpufreqDevice cluster role
+ *
+ * @param #CpufreqDevice
+ *
+ * Returns: a #CpuCluster
+ *
+ **/
+CpuCluster
+cpufreq_device_get_cluster (CpufreqDevice *self)
+{
+    return self->priv->cluster;
+}
+
+/**
+ * cpufreq_device_get_cpus:
+ *
+ * Get #CpufreqDevice cpus
+ *
+ * @param #CpufreqDevice
+ * @param count: (out): cpus count
+ *
+ * Returns: (transfer none): ascending cpu ids
+ *
+ **/
+const guint *
+cpufreq_device_get_cpus (CpufreqDevice *self,
+                         guint         *count)
+{
+    *count = self->priv->cpus_count;
+    return self->priv->cpu_ids;
+}
+
+/**
+ * cpufreq_device_get_min_freq:
  *
- * check #CpufreqDevice type
+ * Get #CpufreqDevice hardware minimal frequency
  *
  * @param #CpufreqDevice
  *
- * Returns: True if #CpufreqDevice is little cluster
+ * Returns: frequency in kHz, 0 if unknown
+ *
+ **/
+guint
+cpufreq_device_get_min_freq (CpufreqDevice *self)
+{
+    return self->priv->min_freq;
+}
+
+/**
+ * cpufreq_device_get_max_freq:
+ *
+ * Get #CpufreqDevice hardware maximal frequency
+ *
+ * @param #CpufreqDevice
+ *
+ * Returns: frequency in kHz, 0 if unknown
+ *
+ **/
+guint
+cpufreq_device_get_max_freq (CpufreqDevice *self)
+{
+    return self->priv->max_freq;
+}
+
+/**
+ * cpufreq_device_set_tunables:
+ *
+ * Apply governor tunables matching current governor, previous values
+ * are saved and restored once no more in @tunables.
+ *
+ * @param #CpufreqDevice
+ * @param tunables: (nullable): tunables, ended by an empty entry
  *
  **/
-gboolean
-cpufreq_is_little (CpufreqDevice *self)
+void
+cpufreq_device_set_tunables (CpufreqDevice        *self,
+                             const CpufreqTunable *tunables)
 {
-    const char *devname = freq_device_get_name (FREQ_DEVICE (self));
+    const char *governor = freq_device_get_governor (FREQ_DEVICE (self));
+    const CpufreqTunable *tunable;
+
+    restore_tunables (self, tunables);
 
-    return g_strcmp0 (devname, "policy0") == 0;
-}
\ No newline at end of file
+    for (tunable = tunables;
+            tunable != NULL && tunable->governor != NULL;
+            tunable++) {
+        g_autofree char *path = NULL;
+
+        if (g_strcmp0 (tunable->governor, governor) != 0)
+            continue;
+
+        /* Tunables differ between mainline and vendor kernels */
+        path = get_tunable_path (self, governor, tunable->node);
+        if (!g_file_test (path, G_FILE_TEST_EXISTS))
+            continue;
+
+        if (!g_hash_table_contains (self->priv->saved_tunables, path)) {
+            char *value = read_saved_tunable (path);
+
+            if (value == NULL)
+                continue;
+
+            g_hash_table_insert (
+                self->priv->saved_tunables, g_strdup (path), value
+            );
+        }
+
+        g_message ("%s -> %s", path, tunable->value);
+        reconciler_set (reconciler_get_default (), path, tunable->value, FALSE);
+    }
+}
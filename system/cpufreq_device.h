@@ -9,6 +9,8 @@
 #include <glib-object.h>
 
 #include "freq_device.h"
+#include "topology.h"
+#include "../common/define.h"
 
 #define TYPE_CPUFREQ_DEVICE \
     (cpufreq_device_get_type ())
@@ -30,6 +32,12 @@
 
 G_BEGIN_DECLS
 
+typedef struct {
+    const char *governor;
+    const char *node;
+    const char *value;
+} CpufreqTunable;
+
 typedef struct _CpufreqDevice CpufreqDevice;
 typedef struct _CpufreqDeviceClass CpufreqDeviceClass;
 typedef struct _CpufreqDevicePrivate CpufreqDevicePrivate;
@@ -46,7 +54,16 @@ struct _CpufreqDeviceClass {
 GType           cpufreq_device_get_type         (void) G_GNUC_CONST;
 
 GObject*        cpufreq_device_new              (void);
-gboolean        cpufreq_is_little               (CpufreqDevice *self);
+void            cpufreq_device_set_cluster      (CpufreqDevice         *self,
+                                                 CpuCluster             cluster,
+                                                 const TopologyCluster *topology_cluster);
+CpuCluster      cpufreq_device_get_cluster      (CpufreqDevice *self);
+const guint    *cpufreq_device_get_cpus         (CpufreqDevice *self,
+                                                 guint         *count);
+guint           cpufreq_device_get_min_freq     (CpufreqDevice *self);
+guint           cpufreq_device_get_max_freq     (CpufreqDevice *self);
+void            cpufreq_device_set_tunables     (CpufreqDevice        *self,
+                                                 const CpufreqTunable *tunables);
 
 G_END_DECLS
 
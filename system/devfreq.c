@@ -7,13 +7,18 @@
 
 #include <gio/gio.h>
 
+#include "capabilities.h"
 #include "devfreq.h"
 #include "devfreq_device.h"
 #include "../common/define.h"
+#include "../common/reconciler.h"
 #include "../common/utils.h"
 
 struct _DevfreqPrivate {
     GList *devfreq_devices;
+
+    DozeLevel doze_level;
+    PowerProfile power_profile;
 };
 
 G_DEFINE_TYPE_WITH_CODE (
@@ -23,30 +28,60 @@ G_DEFINE_TYPE_WITH_CODE (
     G_ADD_PRIVATE (Devfreq)
 )
 
+/*
+ * Maximal frequency in percent, see cpufreq.c: governor is kept, devices
+ * still scale under their cap.
+ */
+static const guint doze_caps[DOZE_LEVEL_LAST] = {
+    [DOZE_LEVEL_SCREEN_ON]  = 100,
+    [DOZE_LEVEL_SCREEN_OFF] = 70,
+    [DOZE_LEVEL_LIGHT]      = 50,
+    [DOZE_LEVEL_MEDIUM]     = 30,
+    [DOZE_LEVEL_FULL]       = 0,
+};
+
+static const guint profile_caps[POWER_PROFILE_LAST] = {
+    [POWER_PROFILE_POWER_SAVER]  = 50,
+    [POWER_PROFILE_BALANCED]     = 100,
+    [POWER_PROFILE_PERFORMANCE]  = 100,
+};
+
+/* NULL means default governor */
+static const char *profile_governors[POWER_PROFILE_LAST] = {
+    [POWER_PROFILE_POWER_SAVER]  = NULL,
+    [POWER_PROFILE_BALANCED]     = NULL,
+    [POWER_PROFILE_PERFORMANCE]  = "performance",
+};
+
 static void
 detect_devices (Devfreq *self)
 {
+    Capabilities *capabilities = capabilities_get_default ();
     g_autoptr (GDir) devfreq_dir = NULL;
+    g_autofree char *sysfs_dir = get_root_path (DEVFREQ_DIR);
     const char *device_dir;
 
-    devfreq_dir = g_dir_open (DEVFREQ_DIR, 0, NULL);
+    devfreq_dir = g_dir_open (sysfs_dir, 0, NULL);
     if (devfreq_dir == NULL) {
-        g_warning ("No devfreq sysfs dir: %s", DEVFREQ_DIR);
+        g_warning ("No devfreq sysfs dir: %s", sysfs_dir);
         return;
     }
 
     while ((device_dir = g_dir_read_name (devfreq_dir)) != NULL) {
         DevfreqDevice *devfreq_device = DEVFREQ_DEVICE (devfreq_device_new ());
         g_autofree char *filename = g_build_filename (
-            DEVFREQ_DIR, device_dir, "governor", NULL
+            sysfs_dir, device_dir, "governor", NULL
         );
 
-        if (!g_file_test (filename, G_FILE_TEST_EXISTS)) {
+        if (!capabilities_exists (capabilities, filename)) {
             g_object_unref (devfreq_device);
             continue;
         }
 
         freq_device_set_name (FREQ_DEVICE (devfreq_device), device_dir);
+        freq_device_load_frequencies (
+            FREQ_DEVICE (devfreq_device), "available_frequencies", 0, 0
+        );
 
         self->priv->devfreq_devices = g_list_prepend (
             self->priv->devfreq_devices, devfreq_device
@@ -54,6 +89,30 @@ detect_devices (Devfreq *self)
     }
 }
 
+static void
+apply_limits (Devfreq *self)
+{
+    DevfreqDevice *devfreq_device;
+    guint cap = MIN (
+        doze_caps[self->priv->doze_level],
+        profile_caps[self->priv->power_profile]
+    );
+
+    reconciler_journal_set_priority (
+        reconciler_get_default (), RECONCILER_PRIORITY_DEVFREQ
+    );
+    GFOREACH (self->priv->devfreq_devices, devfreq_device) {
+        FreqDevice *freq_device = FREQ_DEVICE (devfreq_device);
+
+        freq_device_set_limits (
+            freq_device, 0, freq_device_get_frequency (freq_device, cap)
+        );
+    }
+    reconciler_journal_set_priority (
+        reconciler_get_default (), RECONCILER_PRIORITY_NONE
+    );
+}
+
 static void
 devfreq_dispose (GObject *devfreq)
 {
@@ -86,6 +145,8 @@ devfreq_init (Devfreq *self)
     self->priv = devfreq_get_instance_private (self);
 
     self->priv->devfreq_devices = NULL;
+    self->priv->doze_level = DOZE_LEVEL_SCREEN_ON;
+    self->priv->power_profile = POWER_PROFILE_BALANCED;
 
     detect_devices (self);
 }
@@ -136,35 +197,55 @@ devfreq_blacklist (Devfreq    *self,
 }
 
 /**
- * devfreq_set_powersave:
+ * devfreq_set_doze_level:
  *
- * Set devfreq devices to powersave
+ * Apply devfreq devices caps for doze level
  *
  * @param #Devfreq
- * @param powersave: True to enable powersave
+ * @param doze_level: a #DozeLevel
  */
 void
-devfreq_set_powersave (Devfreq  *self,
-                       gboolean  powersave) {
-    DevfreqDevice *devfreq_device;
+devfreq_set_doze_level (Devfreq   *self,
+                        DozeLevel  doze_level) {
+    g_return_if_fail (doze_level < DOZE_LEVEL_LAST);
+
+    /* Restore previous state first, then check nothing changed meanwhile */
+    if (doze_level == DOZE_LEVEL_SCREEN_ON)
+        reconciler_journal_replay (
+            reconciler_get_default (), RECONCILER_PRIORITY_DEVFREQ
+        );
 
-    GFOREACH (self->priv->devfreq_devices, devfreq_device)
-        freq_device_set_powersave (FREQ_DEVICE (devfreq_device), powersave);
+    self->priv->doze_level = doze_level;
+    apply_limits (self);
 }
 
 /**
- * devfreq_set_governor:
+ * devfreq_set_power_profile:
  *
- * Set devfreq devices governor
+ * Set devfreq devices governor and caps for power profile
  *
  * @param #Devfreq
- * @param governor: new governor to set
+ * @param power_profile: a #PowerProfile
  */
 void
-devfreq_set_governor (Devfreq    *self,
-                      const char *governor) {
+devfreq_set_power_profile (Devfreq      *self,
+                           PowerProfile  power_profile) {
     DevfreqDevice *devfreq_device;
 
+    g_return_if_fail (power_profile < POWER_PROFILE_LAST);
+
+    self->priv->power_profile = power_profile;
+
+    reconciler_journal_set_priority (
+        reconciler_get_default (), RECONCILER_PRIORITY_DEVFREQ
+    );
     GFOREACH (self->priv->devfreq_devices, devfreq_device)
-        freq_device_set_governor (FREQ_DEVICE (devfreq_device), governor);
-}
\ No newline at end of file
+        freq_device_set_governor (
+            FREQ_DEVICE (devfreq_device), profile_governors[power_profile]
+        );
+    reconciler_journal_set_priority (
+        reconciler_get_default (), RECONCILER_PRIORITY_NONE
+    );
+
+    apply_limits (self);
+}
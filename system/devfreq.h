@@ -8,6 +8,8 @@
 #include <glib.h>
 #include <glib-object.h>
 
+#include "../common/define.h"
+
 #define TYPE_DEVFREQ \
     (devfreq_get_type ())
 #define DEVFREQ(obj) \
@@ -46,10 +48,10 @@ GType           devfreq_get_type            (void) G_GNUC_CONST;
 GObject*        devfreq_new                 (void);
 void            devfreq_blacklist           (Devfreq    *self,
                                              const char *device_name);
-void            devfreq_set_powersave       (Devfreq     *self,
-                                             gboolean     powersave);
-void            devfreq_set_governor        (Devfreq    *self,
-                                             const char *governor);
+void            devfreq_set_doze_level      (Devfreq     *self,
+                                             DozeLevel    doze_level);
+void            devfreq_set_power_profile   (Devfreq      *self,
+                                             PowerProfile  power_profile);
 G_END_DECLS
 
 #endif
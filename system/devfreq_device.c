@@ -9,6 +9,7 @@
 
 #include "devfreq_device.h"
 #include "../common/define.h"
+#include "../common/utils.h"
 
 /* struct _DevfreqDevicePrivate { */
 /* }; */
@@ -45,10 +46,15 @@ devfreq_device_class_init (DevfreqDeviceClass *klass)
 static void
 devfreq_device_init (DevfreqDevice *self)
 {
+    g_autofree char *sysfs_dir = get_root_path (DEVFREQ_DIR);
+
     self->priv = devfreq_device_get_instance_private (self);
 
     freq_device_set_sysfs_settings (
-        FREQ_DEVICE (self), DEVFREQ_DIR, "governor"
+        FREQ_DEVICE (self), sysfs_dir, "governor", "available_governors"
+    );
+    freq_device_set_limit_nodes (
+        FREQ_DEVICE (self), "min_freq", "max_freq"
     );
 }
 
@@ -0,0 +1,717 @@
+/*
+ * Copyright Cedric Bellegarde <cedric.bellegarde@adishatz.org>
+ */
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include <glib/gstdio.h>
+
+#include "freezer.h"
+#include "../common/define.h"
+#include "../common/reconciler.h"
+#include "../common/utils.h"
+#include "../common/writer.h"
+
+#ifndef SYS_pidfd_open
+#define SYS_pidfd_open 434
+#endif
+
+#ifndef SYS_pidfd_send_signal
+#define SYS_pidfd_send_signal 424
+#endif
+
+/*
+ * On first freeze, processes are moved into a cgroup below the one
+ * systemd delegates to our unit (Delegate=yes): freezing or thawing all
+ * of them is then a single cgroup.freeze write. They stay there for the
+ * whole screen off session, doze windows only toggle cgroup.freeze, and
+ * go back to their own cgroup on release (screen on, exit), so systemd
+ * accounts them to their unit again.
+ * Original cgroups are saved in /run before moving: a new instance
+ * moves back processes a crashed one left behind.
+ * Without a delegated cgroup v2 subtree (or if a process can't be moved),
+ * a pidfd is kept instead and the process gets SIGSTOP/SIGCONT: a pidfd
+ * can't signal another process if the pid is reused.
+ */
+
+#define FROZEN_CGROUPS_FILE RUNTIME_DIR "/frozen-cgroups"
+#define FROZEN_CGROUPS_GROUP "cgroups"
+
+struct FrozenProcess {
+    pid_t pid;
+    /* Cgroup to move back to, relative to cgroupfs, NULL if not moved in */
+    char *cgroup;
+    /* Signal fallback */
+    gint pidfd;
+};
+
+struct _FreezerPrivate {
+    /* Relative to cgroupfs */
+    char *cgroup;
+    char *cgroup_procs;
+    char *cgroup_freeze;
+
+    GHashTable *processes;
+    gboolean frozen;
+};
+
+G_DEFINE_TYPE_WITH_CODE (
+    Freezer,
+    freezer,
+    G_TYPE_OBJECT,
+    G_ADD_PRIVATE (Freezer)
+)
+
+static void
+frozen_process_free (gpointer user_data)
+{
+    struct FrozenProcess *process = user_data;
+
+    if (process->pidfd >= 0)
+        close (process->pidfd);
+    g_free (process->cgroup);
+    g_free (process);
+}
+
+static gint
+pidfd_open (pid_t pid)
+{
+    return syscall (SYS_pidfd_open, pid, 0);
+}
+
+static gint
+pidfd_send_signal (gint pidfd,
+                   gint signal)
+{
+    return syscall (SYS_pidfd_send_signal, pidfd, signal, NULL, 0);
+}
+
+static char *
+read_cgroup (const char *proc_cgroup)
+{
+    g_autofree char *path = get_root_path (proc_cgroup);
+    g_autofree char *contents = NULL;
+    char *cgroup;
+
+    if (!g_file_get_contents (path, &contents, NULL, NULL))
+        return NULL;
+
+    /* cgroup v2 entry: 0::/system.slice/foo.service */
+    if (g_str_has_prefix (contents, "0::"))
+        cgroup = contents + 3;
+    else if ((cgroup = strstr (contents, "\n0::")) != NULL)
+        cgroup += 4;
+    else
+        return NULL;
+
+    return g_strndup (cgroup, strcspn (cgroup, "\n"));
+}
+
+static char *
+get_process_cgroup (pid_t pid)
+{
+    g_autofree char *proc_cgroup = g_strdup_printf ("/proc/%d/cgroup", pid);
+
+    return read_cgroup (proc_cgroup);
+}
+
+static pid_t
+get_parent_pid (pid_t pid)
+{
+    g_autofree char *proc_stat = g_strdup_printf ("/proc/%d/stat", pid);
+    g_autofree char *path = get_root_path (proc_stat);
+    g_autofree char *contents = NULL;
+    char *fields;
+    pid_t parent;
+
+    if (!g_file_get_contents (path, &contents, NULL, NULL))
+        return 0;
+
+    /* pid (comm) state ppid ...: comm may contain spaces and parentheses */
+    fields = strrchr (contents, ')');
+    if (fields == NULL || sscanf (fields + 1, " %*c %d", &parent) != 1)
+        return 0;
+
+    return parent;
+}
+
+static gint
+move_to_cgroup (const char *cgroup,
+                pid_t       pid)
+{
+    g_autofree char *relative_path = NULL;
+    g_autofree char *cgroup_procs = NULL;
+    g_autofree char *pid_str = g_strdup_printf ("%d", pid);
+    gint error;
+
+    relative_path = g_build_filename (
+        CGROUPS_DIR, cgroup, "cgroup.procs", NULL
+    );
+    cgroup_procs = get_root_path (relative_path);
+
+    error = writer_try_write (writer_get_default (), cgroup_procs, pid_str);
+
+    /* Exited meanwhile */
+    if (error != 0 && error != ESRCH)
+        g_warning (
+            "Can't move %d to %s: %s", pid, cgroup, g_strerror (error)
+        );
+
+    return error;
+}
+
+static void
+save_cgroups (Freezer *self)
+{
+    g_autoptr (GKeyFile) key_file = g_key_file_new ();
+    g_autofree char *runtime_dir = get_root_path (RUNTIME_DIR);
+    g_autofree char *filename = get_root_path (FROZEN_CGROUPS_FILE);
+    g_autoptr (GError) error = NULL;
+    GHashTableIter iter;
+    gpointer value;
+    gboolean empty = TRUE;
+
+    g_hash_table_iter_init (&iter, self->priv->processes);
+    while (g_hash_table_iter_next (&iter, NULL, &value)) {
+        struct FrozenProcess *process = value;
+        char pid_str[16];
+
+        if (process->cgroup == NULL)
+            continue;
+
+        g_snprintf (pid_str, sizeof (pid_str), "%d", process->pid);
+        g_key_file_set_string (
+            key_file, FROZEN_CGROUPS_GROUP, pid_str, process->cgroup
+        );
+        empty = FALSE;
+    }
+
+    if (empty) {
+        g_unlink (filename);
+        return;
+    }
+
+    g_mkdir_with_parents (runtime_dir, 0755);
+    if (!g_key_file_save_to_file (key_file, filename, &error))
+        g_warning ("Can't save frozen cgroups: %s", error->message);
+}
+
+static gboolean
+set_original_cgroup (Freezer              *self,
+                     struct FrozenProcess *process,
+                     pid_t                 parent)
+{
+    g_autofree char *cgroup = get_process_cgroup (process->pid);
+    struct FrozenProcess *parent_process;
+
+    if (cgroup == NULL)
+        return FALSE;
+
+    if (g_strcmp0 (cgroup, self->priv->cgroup) != 0) {
+        process->cgroup = g_steal_pointer (&cgroup);
+        return TRUE;
+    }
+
+    /* Forked from a process we moved: goes back with its parent */
+    if (parent == 0)
+        parent = get_parent_pid (process->pid);
+    parent_process = g_hash_table_lookup (
+        self->priv->processes, GINT_TO_POINTER (parent)
+    );
+    if (parent_process == NULL || parent_process->cgroup == NULL) {
+        g_warning ("Can't find cgroup of %d", process->pid);
+        return FALSE;
+    }
+
+    process->cgroup = g_strdup (parent_process->cgroup);
+
+    return TRUE;
+}
+
+static gboolean
+attach_pidfd (Freezer              *self,
+              struct FrozenProcess *process)
+{
+    /* Relocated pids are not real processes */
+    if (get_root_dir () != NULL)
+        return FALSE;
+
+    process->pidfd = pidfd_open (process->pid);
+
+    if (process->pidfd < 0)
+        return FALSE;
+
+    if (self->priv->frozen)
+        pidfd_send_signal (process->pidfd, SIGSTOP);
+
+    return TRUE;
+}
+
+static void
+move_in (Freezer              *self,
+         struct FrozenProcess *process)
+{
+    gint error;
+
+    if (process->cgroup == NULL || process->pidfd >= 0)
+        return;
+
+    error = move_to_cgroup (self->priv->cgroup, process->pid);
+    if (error == 0)
+        return;
+
+    g_clear_pointer (&process->cgroup, g_free);
+    if (error != ESRCH)
+        attach_pidfd (self, process);
+}
+
+static void
+move_out (Freezer              *self,
+          struct FrozenProcess *process)
+{
+    if (process->cgroup == NULL)
+        return;
+
+    /* Original cgroup gone: stays with us, thawed with our cgroup */
+    move_to_cgroup (process->cgroup, process->pid);
+    g_clear_pointer (&process->cgroup, g_free);
+}
+
+static void
+release_process (Freezer              *self,
+                 struct FrozenProcess *process)
+{
+    if (process->pidfd >= 0) {
+        if (self->priv->frozen)
+            pidfd_send_signal (process->pidfd, SIGCONT);
+    } else {
+        move_out (self, process);
+    }
+}
+
+static void
+restore_processes (Freezer *self)
+{
+    g_autoptr (GKeyFile) key_file = g_key_file_new ();
+    g_autofree char *filename = get_root_path (FROZEN_CGROUPS_FILE);
+    GList *pids = get_cgroup_pids (self->priv->cgroup_procs);
+    pid_t *pid;
+
+    g_key_file_load_from_file (key_file, filename, G_KEY_FILE_NONE, NULL);
+
+    /* Left by a previous instance */
+    GFOREACH (pids, pid) {
+        g_autofree char *pid_str = g_strdup_printf ("%d", *pid);
+        g_autofree char *cgroup = g_key_file_get_string (
+            key_file, FROZEN_CGROUPS_GROUP, pid_str, NULL
+        );
+
+        if (cgroup == NULL)
+            g_warning ("Can't find cgroup of %d", *pid);
+        else
+            move_to_cgroup (cgroup, *pid);
+    }
+    g_list_free_full (pids, g_free);
+
+    g_unlink (filename);
+}
+
+static void
+setup_cgroup (Freezer *self)
+{
+    g_autofree char *controllers = get_root_path (
+        CGROUPS_DIR "/cgroup.controllers"
+    );
+    g_autofree char *unit_cgroup = NULL;
+    g_autofree char *relative_dir = NULL;
+    g_autofree char *cgroup_dir = NULL;
+    g_autofree char *cgroup_freeze = NULL;
+
+    if (!g_file_test (controllers, G_FILE_TEST_EXISTS))
+        return;
+
+    /* Never create cgroups systemd did not delegate to us */
+    unit_cgroup = read_cgroup ("/proc/self/cgroup");
+
+    /* ExecStopPost= runs from a subgroup of delegated units */
+    if (unit_cgroup != NULL && g_str_has_suffix (unit_cgroup, "/.control"))
+        *strrchr (unit_cgroup, '/') = '\0';
+
+    if (unit_cgroup == NULL ||
+            !g_str_has_suffix (unit_cgroup, "/" SYSTEM_UNIT)) {
+        g_message ("Not running from %s, freezing with signals", SYSTEM_UNIT);
+        return;
+    }
+
+    self->priv->cgroup = g_build_filename (unit_cgroup, FREEZER_CGROUP, NULL);
+    relative_dir = g_build_filename (CGROUPS_DIR, self->priv->cgroup, NULL);
+    cgroup_dir = get_root_path (relative_dir);
+
+    if (g_mkdir_with_parents (cgroup_dir, 0755) != 0) {
+        g_warning ("Can't create %s: %s", cgroup_dir, g_strerror (errno));
+        g_clear_pointer (&self->priv->cgroup, g_free);
+        return;
+    }
+
+    cgroup_freeze = g_build_filename (cgroup_dir, "cgroup.freeze", NULL);
+    if (!g_file_test (cgroup_freeze, G_FILE_TEST_EXISTS)) {
+        g_clear_pointer (&self->priv->cgroup, g_free);
+        return;
+    }
+
+    self->priv->cgroup_freeze = g_steal_pointer (&cgroup_freeze);
+    self->priv->cgroup_procs = g_build_filename (
+        cgroup_dir, "cgroup.procs", NULL
+    );
+
+    /* Previous instance may have exited while frozen */
+    writer_write (writer_get_default (), self->priv->cgroup_freeze, "0");
+    restore_processes (self);
+}
+
+static void
+freezer_dispose (GObject *freezer)
+{
+    Freezer *self = FREEZER (freezer);
+    GHashTableIter iter;
+    gpointer value;
+
+    freezer_thaw (self);
+    freezer_release (self);
+
+    g_hash_table_iter_init (&iter, self->priv->processes);
+    while (g_hash_table_iter_next (&iter, NULL, &value))
+        release_process (self, value);
+    g_hash_table_remove_all (self->priv->processes);
+
+    G_OBJECT_CLASS (freezer_parent_class)->dispose (freezer);
+}
+
+static void
+freezer_finalize (GObject *freezer)
+{
+    Freezer *self = FREEZER (freezer);
+
+    g_hash_table_destroy (self->priv->processes);
+    g_free (self->priv->cgroup);
+    g_free (self->priv->cgroup_procs);
+    g_free (self->priv->cgroup_freeze);
+
+    G_OBJECT_CLASS (freezer_parent_class)->finalize (freezer);
+}
+
+static void
+freezer_class_init (FreezerClass *klass)
+{
+    GObjectClass *object_class;
+
+    object_class = G_OBJECT_CLASS (klass);
+    object_class->dispose = freezer_dispose;
+    object_class->finalize = freezer_finalize;
+}
+
+static void
+freezer_init (Freezer *self)
+{
+    self->priv = freezer_get_instance_private (self);
+
+    self->priv->cgroup = NULL;
+    self->priv->cgroup_procs = NULL;
+    self->priv->cgroup_freeze = NULL;
+    self->priv->frozen = FALSE;
+    self->priv->processes = g_hash_table_new_full (
+        g_direct_hash, g_direct_equal, NULL, frozen_process_free
+    );
+
+    setup_cgroup (self);
+}
+
+/**
+ * freezer_new:
+ *
+ * Creates a new #Freezer
+ *
+ * Returns: (transfer full): a new #Freezer
+ *
+ **/
+GObject *
+freezer_new (void)
+{
+    GObject *freezer;
+
+    freezer = g_object_new (TYPE_FREEZER, NULL);
+
+    return freezer;
+}
+
+/**
+ * freezer_add:
+ *
+ * Add a process to freezer, moved and frozen now if freezer is frozen
+ *
+ * @self: a #Freezer
+ * @pid: process id
+ * @parent: parent process id, 0 if unknown
+ *
+ * Returns: TRUE if process is handled by freezer
+ */
+gboolean
+freezer_add (Freezer *self,
+             pid_t    pid,
+             pid_t    parent)
+{
+    struct FrozenProcess *process;
+
+    if (freezer_contains (self, pid))
+        return TRUE;
+
+    process = g_new0 (struct FrozenProcess, 1);
+    process->pid = pid;
+    process->pidfd = -1;
+
+    if (self->priv->cgroup == NULL && !attach_pidfd (self, process)) {
+        frozen_process_free (process);
+        return FALSE;
+    }
+
+    g_hash_table_replace (
+        self->priv->processes, GINT_TO_POINTER (pid), process
+    );
+
+    if (self->priv->frozen && process->pidfd < 0 &&
+            set_original_cgroup (self, process, parent)) {
+        save_cgroups (self);
+        move_in (self, process);
+    }
+
+    return TRUE;
+}
+
+/**
+ * freezer_remove:
+ *
+ * Remove a process from freezer, running again from its own cgroup
+ *
+ * @self: a #Freezer
+ * @pid: process id
+ */
+void
+freezer_remove (Freezer *self,
+                pid_t    pid)
+{
+    struct FrozenProcess *process = g_hash_table_lookup (
+        self->priv->processes, GINT_TO_POINTER (pid)
+    );
+
+    if (process == NULL)
+        return;
+
+    release_process (self, process);
+    g_hash_table_remove (self->priv->processes, GINT_TO_POINTER (pid));
+}
+
+/**
+ * freezer_forget:
+ *
+ * Forget an exited process
+ *
+ * @self: a #Freezer
+ * @pid: process id
+ */
+void
+freezer_forget (Freezer *self,
+                pid_t    pid)
+{
+    g_hash_table_remove (self->priv->processes, GINT_TO_POINTER (pid));
+}
+
+/**
+ * freezer_contains:
+ *
+ * @self: a #Freezer
+ * @pid: process id
+ *
+ * Returns: TRUE if process is handled by freezer
+ */
+gboolean
+freezer_contains (Freezer *self,
+                  pid_t    pid)
+{
+    return g_hash_table_contains (
+        self->priv->processes, GINT_TO_POINTER (pid)
+    );
+}
+
+/**
+ * freezer_update:
+ *
+ * Set processes handled by freezer: only missing processes are added,
+ * only processes not in @pids anymore are removed
+ *
+ * @self: a #Freezer
+ * @pids: (element-type pid_t): set of process ids
+ *
+ * Returns: processes added or removed
+ */
+guint
+freezer_update (Freezer    *self,
+                GHashTable *pids)
+{
+    g_autoptr (GList) current = g_hash_table_get_keys (self->priv->processes);
+    GHashTableIter iter;
+    gpointer key;
+    GList *item;
+    guint changes = 0;
+
+    for (item = current; item != NULL; item = item->next) {
+        if (!g_hash_table_contains (pids, item->data)) {
+            freezer_remove (self, GPOINTER_TO_INT (item->data));
+            changes++;
+        }
+    }
+
+    g_hash_table_iter_init (&iter, pids);
+    while (g_hash_table_iter_next (&iter, &key, NULL)) {
+        if (!freezer_contains (self, GPOINTER_TO_INT (key)) &&
+                freezer_add (self, GPOINTER_TO_INT (key), 0))
+            changes++;
+    }
+
+    return changes;
+}
+
+static void
+signal_processes (Freezer *self,
+                  gint     signal)
+{
+    GHashTableIter iter;
+    gpointer value;
+
+    g_hash_table_iter_init (&iter, self->priv->processes);
+    while (g_hash_table_iter_next (&iter, NULL, &value)) {
+        struct FrozenProcess *process = value;
+
+        if (process->pidfd >= 0)
+            pidfd_send_signal (process->pidfd, signal);
+    }
+}
+
+/**
+ * freezer_freeze:
+ *
+ * Freeze processes
+ *
+ * @self: a #Freezer
+ */
+void
+freezer_freeze (Freezer *self)
+{
+    GHashTableIter iter;
+    gpointer value;
+
+    if (self->priv->frozen)
+        return;
+
+    self->priv->frozen = TRUE;
+
+    if (self->priv->cgroup_freeze != NULL) {
+        g_autoptr (GPtrArray) moving = g_ptr_array_new ();
+        guint i;
+
+        /* Only processes not moved in yet, others stay for the session */
+        g_hash_table_iter_init (&iter, self->priv->processes);
+        while (g_hash_table_iter_next (&iter, NULL, &value)) {
+            struct FrozenProcess *process = value;
+
+            if (process->pidfd < 0 && process->cgroup == NULL &&
+                    set_original_cgroup (self, process, 0))
+                g_ptr_array_add (moving, process);
+        }
+
+        /* Saved before moving: a crash must not lose them */
+        if (moving->len > 0)
+            save_cgroups (self);
+
+        for (i = 0; i < moving->len; i++)
+            move_in (self, g_ptr_array_index (moving, i));
+
+        reconciler_set (
+            reconciler_get_default (), self->priv->cgroup_freeze, "1", TRUE
+        );
+    }
+    signal_processes (self, SIGSTOP);
+}
+
+/**
+ * freezer_thaw:
+ *
+ * Thaw processes
+ *
+ * @self: a #Freezer
+ */
+void
+freezer_thaw (Freezer *self)
+{
+    if (!self->priv->frozen)
+        return;
+
+    self->priv->frozen = FALSE;
+
+    /* Processes stay in our cgroup until released */
+    if (self->priv->cgroup_freeze != NULL)
+        reconciler_set (
+            reconciler_get_default (), self->priv->cgroup_freeze, "0", TRUE
+        );
+    signal_processes (self, SIGCONT);
+}
+
+/**
+ * freezer_release:
+ *
+ * Move processes back to their own cgroup, running again, until next
+ * freeze. Processes handled with signals are left as they are.
+ *
+ * @self: a #Freezer
+ */
+void
+freezer_release (Freezer *self)
+{
+    GHashTableIter iter;
+    gpointer value;
+    gboolean moved = FALSE;
+
+    if (self->priv->cgroup_freeze == NULL)
+        return;
+
+    /* Moving to a running cgroup thaws them */
+    g_hash_table_iter_init (&iter, self->priv->processes);
+    while (g_hash_table_iter_next (&iter, NULL, &value)) {
+        struct FrozenProcess *process = value;
+
+        if (process->cgroup != NULL) {
+            move_out (self, process);
+            moved = TRUE;
+        }
+    }
+
+    if (moved)
+        save_cgroups (self);
+}
+
+/**
+ * freezer_length:
+ *
+ * @self: a #Freezer
+ *
+ * Returns: processes count handled by freezer
+ */
+guint
+freezer_length (Freezer *self)
+{
+    return g_hash_table_size (self->priv->processes);
+}
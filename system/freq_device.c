@@ -2,18 +2,39 @@
  * Copyright Cedric Bellegarde <cedric.bellegarde@adishatz.org>
  */
 
+#include <stdlib.h>
+
 #include <gio/gio.h>
 
+#include "capabilities.h"
 #include "freq_device.h"
+#include "../common/define.h"
+#include "../common/reconciler.h"
 #include "../common/utils.h"
 
+#define DEFAULTS_FILE RUNTIME_DIR "/freq-defaults"
+#define DEFAULTS_GROUP "defaults"
+
 struct _FreqDevicePrivate {
     char *sysfs_dir;
     char *device_name;
     char *governor_node;
+    char *available_governors_node;
 
     char *default_governor;
     char *current_governor;
+
+    char *min_freq_node;
+    char *max_freq_node;
+    char *default_min_freq;
+    char *default_max_freq;
+    /* 0: default */
+    guint min_freq;
+    guint max_freq;
+
+    /* Ascending */
+    guint *frequencies;
+    guint frequencies_count;
 };
 
 G_DEFINE_TYPE_WITH_CODE (
@@ -33,15 +54,118 @@ set_governor (FreqDevice *freq_device,
         freq_device->priv->governor_node,
         NULL
     );
+    g_autofree char *available_path = g_build_filename (
+        freq_device->priv->sysfs_dir,
+        freq_device->priv->device_name,
+        freq_device->priv->available_governors_node,
+        NULL
+    );
+
+    if (!capabilities_has_governor (
+            capabilities_get_default (), available_path, governor)) {
+        g_message ("%s: %s not available", filename, governor);
+        return;
+    }
 
     g_message ("%s -> %s", filename, governor);
 
-    write_to_file (filename, governor);
+    reconciler_set (reconciler_get_default (), filename, governor, FALSE);
+}
+
+static char *
+get_node_path (FreqDevice *self,
+               const char *node)
+{
+    return g_build_filename (
+        self->priv->sysfs_dir, self->priv->device_name, node, NULL
+    );
+}
+
+static char *
+read_node (FreqDevice *self,
+           const char *node)
+{
+    g_autofree char *filename = get_node_path (self, node);
+    char *contents = NULL;
+
+    if (!g_file_get_contents (filename, &contents, NULL, NULL))
+        return NULL;
+
+    return g_strchomp (contents);
+}
+
+/*
+ * Limits are restored as read before we first capped them. They are
+ * snapshotted in /run, so a restarted daemon does not take capped
+ * limits for defaults.
+ */
+static char *
+read_default_node (FreqDevice *self,
+                   const char *node)
+{
+    g_autoptr (GKeyFile) key_file = g_key_file_new ();
+    g_autofree char *runtime_dir = get_root_path (RUNTIME_DIR);
+    g_autofree char *filename = get_root_path (DEFAULTS_FILE);
+    g_autofree char *path = get_node_path (self, node);
+    g_autoptr (GError) error = NULL;
+    char *value;
+
+    g_key_file_load_from_file (key_file, filename, G_KEY_FILE_NONE, NULL);
+
+    /* We already ran since boot, node may hold a capped value */
+    value = g_key_file_get_string (key_file, DEFAULTS_GROUP, path, NULL);
+    if (value != NULL)
+        return value;
+
+    value = read_node (self, node);
+    if (value == NULL)
+        return NULL;
+
+    g_key_file_set_string (key_file, DEFAULTS_GROUP, path, value);
+    g_mkdir_with_parents (runtime_dir, 0755);
+    if (!g_key_file_save_to_file (key_file, filename, &error))
+        g_warning ("Can't save frequency defaults: %s", error->message);
+
+    return value;
+}
+
+static void
+write_limit (FreqDevice *self,
+             const char *node,
+             guint       frequency,
+             const char *default_frequency)
+{
+    g_autofree char *filename = get_node_path (self, node);
+    g_autofree char *value = NULL;
+
+    if (frequency == 0)
+        value = g_strdup (default_frequency);
+    else
+        value = g_strdup_printf ("%u", frequency);
+
+    g_message ("%s -> %s", filename, value);
+
+    reconciler_set (reconciler_get_default (), filename, value, FALSE);
+}
+
+static gint
+compare_frequencies (gconstpointer a,
+                     gconstpointer b)
+{
+    guint freq_a = *(const guint *) a;
+    guint freq_b = *(const guint *) b;
+
+    return freq_a < freq_b ? -1 : freq_a > freq_b;
 }
 
 static void
 freq_device_dispose (GObject *freq_device)
 {
+    FreqDevice *self = FREQ_DEVICE (freq_device);
+
+    if (self->priv->min_freq != 0 || self->priv->max_freq != 0)
+        freq_device_set_limits (self, 0, 0);
+
     G_OBJECT_CLASS (freq_device_parent_class)->dispose (freq_device);
 }
 
@@ -54,7 +178,13 @@ freq_device_finalize (GObject *freq_device)
     g_free (self->priv->current_governor);
     g_free (self->priv->device_name);
     g_free (self->priv->governor_node);
+    g_free (self->priv->available_governors_node);
     g_free (self->priv->sysfs_dir);
+    g_free (self->priv->min_freq_node);
+    g_free (self->priv->max_freq_node);
+    g_free (self->priv->default_min_freq);
+    g_free (self->priv->default_max_freq);
+    g_free (self->priv->frequencies);
 
     G_OBJECT_CLASS (freq_device_parent_class)->finalize (freq_device);
 }
@@ -77,8 +207,17 @@ freq_device_init (FreqDevice *self)
     self->priv->device_name = NULL;
     self->priv->sysfs_dir = NULL;
     self->priv->governor_node = NULL;
+    self->priv->available_governors_node = NULL;
     self->priv->default_governor = NULL;
     self->priv->current_governor = NULL;
+    self->priv->min_freq_node = NULL;
+    self->priv->max_freq_node = NULL;
+    self->priv->default_min_freq = NULL;
+    self->priv->default_max_freq = NULL;
+    self->priv->min_freq = 0;
+    self->priv->max_freq = 0;
+    self->priv->frequencies = NULL;
+    self->priv->frequencies_count = 0;
 }
 
 /**
@@ -107,6 +246,7 @@ freq_device_new (void)
  * @self: #FreqDevice
  * @sys_dir: path to freq device policy dir
  * @governor_node: sysfs governor node
+ * @available_governors_node: sysfs available governors node
  *
  * Returns: (transfer full): a new #FreqDevice
  *
@@ -114,13 +254,38 @@ freq_device_new (void)
 void
 freq_device_set_sysfs_settings (FreqDevice *self,
                                 const char *directory,
-                                const char *governor_node)
+                                const char *governor_node,
+                                const char *available_governors_node)
 {
     if (self->priv->sysfs_dir != NULL)
         g_free (self->priv->sysfs_dir);
 
     self->priv->sysfs_dir = g_strdup (directory);
     self->priv->governor_node = g_strdup (governor_node);
+    self->priv->available_governors_node = g_strdup (available_governors_node);
+}
+
+/**
+ * freq_device_set_limit_nodes:
+ *
+ * Set #FreqDevice frequency limits nodes, must be called before
+ * freq_device_set_name()
+ *
+ * @self: #FreqDevice
+ * @min_freq_node: sysfs minimal frequency node
+ * @max_freq_node: sysfs maximal frequency node
+ *
+ **/
+void
+freq_device_set_limit_nodes (FreqDevice *self,
+                             const char *min_freq_node,
+                             const char *max_freq_node)
+{
+    g_free (self->priv->min_freq_node);
+    g_free (self->priv->max_freq_node);
+
+    self->priv->min_freq_node = g_strdup (min_freq_node);
+    self->priv->max_freq_node = g_strdup (max_freq_node);
 }
 
 /**
@@ -158,6 +323,16 @@ freq_device_set_name (FreqDevice *self,
                   filename,
                   self->priv->default_governor);
     }
+
+    /* Restored as is when limits are dropped */
+    if (self->priv->min_freq_node != NULL)
+        self->priv->default_min_freq = read_default_node (
+            self, self->priv->min_freq_node
+        );
+    if (self->priv->max_freq_node != NULL)
+        self->priv->default_max_freq = read_default_node (
+            self, self->priv->max_freq_node
+        );
 }
 
 /**
@@ -176,26 +351,6 @@ freq_device_get_name (FreqDevice  *self)
     return self->priv->device_name;
 }
 
-/**
- * freq_device_set_powersave:
- *
- * Set freq device to powersave
- *
- * @param #FreqDevice
- * @param powersave: True to enable powersave
- */
-void
-freq_device_set_powersave (FreqDevice *self,
-                           gboolean    powersave)
-{
-    if (powersave)
-        set_governor (self, "powersave");
-    else if (self->priv->current_governor != NULL)
-        set_governor (self, self->priv->current_governor);
-    else if (self->priv->default_governor != NULL)
-        set_governor (self, self->priv->default_governor);
-}
-
 /**
  * freq_device_set_governor:
  *
@@ -216,4 +371,180 @@ freq_device_set_governor (FreqDevice *self,
     else
         self->priv->current_governor = g_strdup (governor);
     set_governor (self, self->priv->current_governor);
-}
\ No newline at end of file
+}
+/**
+ * freq_device_get_governor:
+ *
+ * Get freq device governor, as set by freq_device_set_governor()
+ *
+ * @self: #FreqDevice
+ *
+ * Returns: (transfer none): governor name
+ */
+const char *
+freq_device_get_governor (FreqDevice *self)
+{
+    if (self->priv->current_governor != NULL)
+        return self->priv->current_governor;
+
+    return self->priv->default_governor;
+}
+
+/**
+ * freq_device_load_frequencies:
+ *
+ * Load #FreqDevice available frequencies
+ *
+ * @self: #FreqDevice
+ * @node: sysfs node listing available frequencies
+ * @min_freq: hardware minimal frequency, used as fallback
+ * @max_freq: hardware maximal frequency, used as fallback
+ */
+void
+freq_device_load_frequencies (FreqDevice *self,
+                              const char *node,
+                              guint       min_freq,
+                              guint       max_freq)
+{
+    g_autofree char *filename = get_node_path (self, node);
+    g_autofree char *contents = capabilities_read (
+        capabilities_get_default (), filename
+    );
+    GArray *frequencies = g_array_new (FALSE, FALSE, sizeof (guint));
+    char *frequency;
+    char *end;
+
+    /* Not exposed by all drivers (intel_pstate, cppc...) */
+    if (contents != NULL) {
+        for (frequency = contents; ; frequency = end) {
+            guint value = strtoul (frequency, &end, 10);
+
+            if (end == frequency)
+                break;
+            g_array_append_val (frequencies, value);
+        }
+    }
+
+    if (frequencies->len == 0) {
+        if (min_freq != 0)
+            g_array_append_val (frequencies, min_freq);
+        if (max_freq > min_freq)
+            g_array_append_val (frequencies, max_freq);
+    }
+
+    g_array_sort (frequencies, compare_frequencies);
+
+    g_free (self->priv->frequencies);
+    self->priv->frequencies_count = frequencies->len;
+    self->priv->frequencies = (guint *) g_array_free (frequencies, FALSE);
+}
+
+/**
+ * freq_device_get_frequencies:
+ *
+ * Get #FreqDevice available frequencies
+ *
+ * @self: #FreqDevice
+ * @count: (out): frequencies count
+ *
+ * Returns: (transfer none): ascending frequencies
+ */
+const guint *
+freq_device_get_frequencies (FreqDevice *self,
+                             guint      *count)
+{
+    *count = self->priv->frequencies_count;
+    return self->priv->frequencies;
+}
+
+/**
+ * freq_device_get_frequency:
+ *
+ * Get highest available frequency under a percentage of maximal
+ * frequency
+ *
+ * @self: #FreqDevice
+ * @percent: percentage of maximal frequency
+ *
+ * Returns: a frequency, 0 if uncapped or unknown
+ */
+guint
+freq_device_get_frequency (FreqDevice *self,
+                           guint       percent)
+{
+    guint count = self->priv->frequencies_count;
+    guint target;
+    gint i;
+
+    if (percent >= 100 || count == 0)
+        return 0;
+
+    target = (guint64) self->priv->frequencies[count - 1] * percent / 100;
+
+    for (i = count - 1; i > 0; i--)
+        if (self->priv->frequencies[i] <= target)
+            break;
+
+    return self->priv->frequencies[i];
+}
+
+/**
+ * freq_device_set_limits:
+ *
+ * Set freq device frequency limits
+ *
+ * @self: #FreqDevice
+ * @min_freq: minimal frequency, 0 for default
+ * @max_freq: maximal frequency, 0 for default
+ */
+void
+freq_device_set_limits (FreqDevice *self,
+                        guint       min_freq,
+                        guint       max_freq)
+{
+    guint default_min;
+    guint current_max;
+
+    if (self->priv->min_freq_node == NULL ||
+            self->priv->max_freq_node == NULL ||
+            self->priv->default_min_freq == NULL ||
+            self->priv->default_max_freq == NULL)
+        return;
+
+    if (min_freq == self->priv->min_freq && max_freq == self->priv->max_freq)
+        return;
+
+    default_min = strtoul (self->priv->default_min_freq, NULL, 10);
+
+    /* Never ask for min > max */
+    if (max_freq != 0 && (min_freq != 0 ? min_freq : default_min) > max_freq)
+        min_freq = max_freq;
+
+    current_max = self->priv->max_freq;
+    if (current_max == 0)
+        current_max = strtoul (self->priv->default_max_freq, NULL, 10);
+
+    /* Kernel may reject min above max: raise max first */
+    if ((min_freq != 0 ? min_freq : default_min) > current_max) {
+        write_limit (
+            self, self->priv->max_freq_node,
+            max_freq, self->priv->default_max_freq
+        );
+        write_limit (
+            self, self->priv->min_freq_node,
+            min_freq, self->priv->default_min_freq
+        );
+    } else {
+        write_limit (
+            self, self->priv->min_freq_node,
+            min_freq, self->priv->default_min_freq
+        );
+        write_limit (
+            self, self->priv->max_freq_node,
+            max_freq, self->priv->default_max_freq
+        );
+    }
+
+    self->priv->min_freq = min_freq;
+    self->priv->max_freq = max_freq;
+}
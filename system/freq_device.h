@@ -46,14 +46,28 @@ GType           freq_device_get_type            (void) G_GNUC_CONST;
 GObject*        freq_device_new                 (void);
 void            freq_device_set_sysfs_settings  (FreqDevice *self,
                                                  const char *directory,
-                                                 const char *governor_node);
+                                                 const char *governor_node,
+                                                 const char *available_governors_node);
+void            freq_device_set_limit_nodes     (FreqDevice *self,
+                                                 const char *min_freq_node,
+                                                 const char *max_freq_node);
 void            freq_device_set_name            (FreqDevice *self,
                                                  const char *device_name);
 const char*     freq_device_get_name            (FreqDevice  *self);
-void            freq_device_set_powersave       (FreqDevice  *self,
-                                                 gboolean     powersave);
 void            freq_device_set_governor        (FreqDevice *self,
                                                  const char *governor);
+const char     *freq_device_get_governor        (FreqDevice *self);
+void            freq_device_load_frequencies    (FreqDevice *self,
+                                                 const char *node,
+                                                 guint       min_freq,
+                                                 guint       max_freq);
+const guint    *freq_device_get_frequencies     (FreqDevice *self,
+                                                 guint      *count);
+guint           freq_device_get_frequency       (FreqDevice *self,
+                                                 guint       percent);
+void            freq_device_set_limits          (FreqDevice *self,
+                                                 guint       min_freq,
+                                                 guint       max_freq);
 G_END_DECLS
 
 #endif
@@ -0,0 +1,306 @@
+/*
+ * Copyright Cedric Bellegarde <cedric.bellegarde@adishatz.org>
+ */
+
+#include <string.h>
+
+#include <gio/gio.h>
+#include <glib/gstdio.h>
+
+#include "hotplug.h"
+#include "../common/define.h"
+#include "../common/utils.h"
+#include "../common/writer.h"
+
+#define CPU_DIR "/sys/devices/system/cpu"
+#define SMT_CONTROL CPU_DIR "/smt/control"
+#define PARKED_JOURNAL RUNTIME_DIR "/parked"
+
+/* Above this, parking costs more than it saves on screen on */
+#define UNPARK_BUDGET_MS 150
+
+/*
+ * Everything we put offline is first written to a journal in /run:
+ * if we crash while parked, ExecStopPost= (--restore) or next start
+ * brings cores back online.
+ */
+
+struct _HotplugPrivate {
+    HotplugMode mode;
+
+    GArray *parked_cpus;
+    char *smt_control;
+};
+
+G_DEFINE_TYPE_WITH_CODE (
+    Hotplug,
+    hotplug,
+    G_TYPE_OBJECT,
+    G_ADD_PRIVATE (Hotplug)
+)
+
+static char *
+get_cpu_online_path (guint cpu_id)
+{
+    g_autofree char *path = g_strdup_printf (
+        CPU_DIR "/cpu%u/online", cpu_id
+    );
+
+    return get_root_path (path);
+}
+
+static void
+write_journal (GString *journal)
+{
+    g_autofree char *runtime_dir = get_root_path (RUNTIME_DIR);
+    g_autofree char *filename = get_root_path (PARKED_JOURNAL);
+    g_autoptr (GError) error = NULL;
+
+    g_mkdir_with_parents (runtime_dir, 0755);
+
+    if (!g_file_set_contents (filename, journal->str, journal->len, &error))
+        g_warning ("Can't write %s: %s", filename, error->message);
+}
+
+static void
+remove_journal (void)
+{
+    g_autofree char *filename = get_root_path (PARKED_JOURNAL);
+
+    g_unlink (filename);
+}
+
+static void
+replay_journal (void)
+{
+    g_autofree char *filename = get_root_path (PARKED_JOURNAL);
+    g_autofree char *contents = NULL;
+    char *line;
+    char *next;
+
+    if (!g_file_get_contents (filename, &contents, NULL, NULL))
+        return;
+
+    g_warning ("Restoring parked cores from a previous run");
+
+    /* path value */
+    for (line = contents; *line != '\0'; line = next) {
+        char *value;
+
+        next = line + strcspn (line, "\n");
+        if (*next != '\0')
+            *next++ = '\0';
+
+        value = strrchr (line, ' ');
+        if (value == NULL)
+            continue;
+        *value++ = '\0';
+
+        writer_write (writer_get_default (), line, value);
+        writer_forget (writer_get_default (), line);
+    }
+
+    remove_journal ();
+}
+
+static void
+hotplug_dispose (GObject *hotplug)
+{
+    Hotplug *self = HOTPLUG (hotplug);
+
+    hotplug_unpark (self);
+
+    G_OBJECT_CLASS (hotplug_parent_class)->dispose (hotplug);
+}
+
+static void
+hotplug_finalize (GObject *hotplug)
+{
+    Hotplug *self = HOTPLUG (hotplug);
+
+    g_array_free (self->priv->parked_cpus, TRUE);
+    g_free (self->priv->smt_control);
+
+    G_OBJECT_CLASS (hotplug_parent_class)->finalize (hotplug);
+}
+
+static void
+hotplug_class_init (HotplugClass *klass)
+{
+    GObjectClass *object_class;
+
+    object_class = G_OBJECT_CLASS (klass);
+    object_class->dispose = hotplug_dispose;
+    object_class->finalize = hotplug_finalize;
+}
+
+static void
+hotplug_init (Hotplug *self)
+{
+    self->priv = hotplug_get_instance_private (self);
+
+    self->priv->mode = HOTPLUG_MODE_NONE;
+    self->priv->parked_cpus = g_array_new (FALSE, FALSE, sizeof (guint));
+    self->priv->smt_control = NULL;
+
+    replay_journal ();
+}
+
+/**
+ * hotplug_new:
+ *
+ * Creates a new #Hotplug
+ *
+ * Returns: (transfer full): a new #Hotplug
+ *
+ **/
+GObject *
+hotplug_new (void)
+{
+    GObject *hotplug;
+
+    hotplug = g_object_new (TYPE_HOTPLUG, NULL);
+
+    return hotplug;
+}
+
+/**
+ * hotplug_set_mode:
+ *
+ * Set how cores are parked
+ *
+ * @self: a #Hotplug
+ * @mode: a #HotplugMode
+ */
+void
+hotplug_set_mode (Hotplug     *self,
+                  HotplugMode  mode)
+{
+    if (self->priv->mode == mode)
+        return;
+
+    hotplug_unpark (self);
+    self->priv->mode = mode;
+}
+
+/**
+ * hotplug_park:
+ *
+ * Put cores offline: @cpu_ids in cores mode, SMT siblings in SMT mode
+ *
+ * @self: a #Hotplug
+ * @cpu_ids: cpus to park in cores mode
+ * @count: @cpu_ids count
+ */
+void
+hotplug_park (Hotplug     *self,
+              const guint *cpu_ids,
+              guint        count)
+{
+    g_autoptr (GString) journal = g_string_new (NULL);
+    guint i;
+
+    if (self->priv->parked_cpus->len > 0 || self->priv->smt_control != NULL)
+        return;
+
+    if (self->priv->mode == HOTPLUG_MODE_SMT) {
+        g_autofree char *path = get_root_path (SMT_CONTROL);
+        g_autofree char *smt_control = NULL;
+
+        if (!g_file_get_contents (path, &smt_control, NULL, NULL))
+            return;
+        g_strstrip (smt_control);
+
+        /* off, forceoff, notsupported, notimplemented */
+        if (g_strcmp0 (smt_control, "on") != 0)
+            return;
+
+        g_string_append_printf (journal, "%s %s\n", path, smt_control);
+        write_journal (journal);
+
+        if (writer_write (writer_get_default (), path, "off") == 0)
+            self->priv->smt_control = g_steal_pointer (&smt_control);
+        else
+            remove_journal ();
+    } else if (self->priv->mode == HOTPLUG_MODE_CORES) {
+        for (i = 0; i < count; i++) {
+            g_autofree char *path = get_cpu_online_path (cpu_ids[i]);
+
+            /* Boot cpu is often not hotpluggable */
+            if (cpu_ids[i] == 0 || !g_file_test (path, G_FILE_TEST_EXISTS))
+                continue;
+
+            g_string_append_printf (journal, "%s 1\n", path);
+        }
+
+        if (journal->len == 0)
+            return;
+        write_journal (journal);
+
+        for (i = 0; i < count; i++) {
+            g_autofree char *path = get_cpu_online_path (cpu_ids[i]);
+
+            if (cpu_ids[i] == 0 || !g_file_test (path, G_FILE_TEST_EXISTS))
+                continue;
+
+            if (writer_write (writer_get_default (), path, "0") == 0)
+                g_array_append_val (self->priv->parked_cpus, cpu_ids[i]);
+        }
+
+        if (self->priv->parked_cpus->len == 0)
+            remove_journal ();
+    }
+
+    if (self->priv->parked_cpus->len > 0 || self->priv->smt_control != NULL)
+        g_message ("Parked %u cpus", self->priv->parked_cpus->len);
+}
+
+/**
+ * hotplug_unpark:
+ *
+ * Bring parked cores back online
+ *
+ * @self: a #Hotplug
+ */
+void
+hotplug_unpark (Hotplug *self)
+{
+    gint64 start;
+    gint64 elapsed;
+    guint i;
+
+    if (self->priv->parked_cpus->len == 0 && self->priv->smt_control == NULL)
+        return;
+
+    start = g_get_monotonic_time ();
+
+    if (self->priv->smt_control != NULL) {
+        g_autofree char *path = get_root_path (SMT_CONTROL);
+
+        writer_write (writer_get_default (), path, self->priv->smt_control);
+        writer_forget (writer_get_default (), path);
+        g_clear_pointer (&self->priv->smt_control, g_free);
+    }
+
+    for (i = 0; i < self->priv->parked_cpus->len; i++) {
+        guint cpu_id = g_array_index (self->priv->parked_cpus, guint, i);
+        g_autofree char *path = get_cpu_online_path (cpu_id);
+
+        writer_write (writer_get_default (), path, "1");
+        writer_forget (writer_get_default (), path);
+    }
+    g_array_set_size (self->priv->parked_cpus, 0);
+
+    remove_journal ();
+
+    elapsed = (g_get_monotonic_time () - start) / 1000;
+    g_message ("Unparked cores in %" G_GINT64_FORMAT " ms", elapsed);
+
+    if (elapsed > UNPARK_BUDGET_MS) {
+        g_warning (
+            "Unparking took more than %d ms: disabling core parking",
+            UNPARK_BUDGET_MS
+        );
+        self->priv->mode = HOTPLUG_MODE_NONE;
+    }
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright Cedric Bellegarde <cedric.bellegarde@adishatz.org>
+ */
+
+#ifndef HOTPLUG_H
+#define HOTPLUG_H
+
+#include <glib.h>
+#include <glib-object.h>
+
+#define TYPE_HOTPLUG \
+    (hotplug_get_type ())
+#define HOTPLUG(obj) \
+    (G_TYPE_CHECK_INSTANCE_CAST \
+    ((obj), TYPE_HOTPLUG, Hotplug))
+#define HOTPLUG_CLASS(cls) \
+    (G_TYPE_CHECK_CLASS_CAST \
+    ((cls), TYPE_HOTPLUG, HotplugClass))
+#define IS_HOTPLUG(obj) \
+    (G_TYPE_CHECK_INSTANCE_TYPE \
+    ((obj), TYPE_HOTPLUG))
+#define IS_HOTPLUG_CLASS(cls) \
+    (G_TYPE_CHECK_CLASS_TYPE \
+    ((cls), TYPE_HOTPLUG))
+#define HOTPLUG_GET_CLASS(obj) \
+    (G_TYPE_INSTANCE_GET_CLASS \
+    ((obj), TYPE_HOTPLUG, HotplugClass))
+
+G_BEGIN_DECLS
+
+typedef enum {
+    HOTPLUG_MODE_NONE,
+    HOTPLUG_MODE_CORES,
+    HOTPLUG_MODE_SMT
+} HotplugMode;
+
+typedef struct _Hotplug Hotplug;
+typedef struct _HotplugClass HotplugClass;
+typedef struct _HotplugPrivate HotplugPrivate;
+
+struct _Hotplug {
+    GObject parent;
+    HotplugPrivate *priv;
+};
+
+struct _HotplugClass {
+    GObjectClass parent_class;
+};
+
+GType            hotplug_get_type            (void) G_GNUC_CONST;
+
+GObject*         hotplug_new                 (void);
+void             hotplug_set_mode            (Hotplug     *self,
+                                              HotplugMode  mode);
+void             hotplug_park                (Hotplug     *self,
+                                              const guint *cpu_ids,
+                                              guint        count);
+void             hotplug_unpark              (Hotplug     *self);
+
+G_END_DECLS
+
+#endif
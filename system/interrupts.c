@@ -0,0 +1,360 @@
+/*
+ * Copyright Cedric Bellegarde <cedric.bellegarde@adishatz.org>
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+
+#include <gio/gio.h>
+#include <glib/gstdio.h>
+
+#include "interrupts.h"
+#include "topology.h"
+#include "../common/define.h"
+#include "../common/utils.h"
+#include "../common/writer.h"
+
+#define IRQ_DIR "/proc/irq"
+#define IRQ_ACTIONS_DIR "/sys/kernel/irq"
+#define WORKQUEUE_CPUMASK "/sys/devices/virtual/workqueue/cpumask"
+#define SAVED_AFFINITIES_FILE RUNTIME_DIR "/irq-affinities"
+#define SAVED_AFFINITIES_GROUP "saved"
+
+/*
+ * On screen off, device interrupts and unbound workqueues are steered
+ * to the little cluster, so big cores stay in their deepest idle
+ * states. Previous affinities are saved, in /run too, and restored on
+ * screen on: if we crash while steered, ExecStopPost= (--restore) or
+ * next start restores them.
+ */
+
+struct _InterruptsPrivate {
+    Matcher *blacklist;
+
+    char *little_cpus;
+    char *little_mask;
+
+    /* path -> value before powersave */
+    GHashTable *saved;
+    /* Per-CPU or managed IRQs, writes fail */
+    GHashTable *pinned;
+};
+
+G_DEFINE_TYPE_WITH_CODE (
+    Interrupts,
+    interrupts,
+    G_TYPE_OBJECT,
+    G_ADD_PRIVATE (Interrupts)
+)
+
+static char *
+format_cpu_mask (guint *cpu_ids,
+                 guint  count)
+{
+    GString *mask = g_string_new (NULL);
+    guint32 *words;
+    guint words_count;
+    guint i;
+
+    words_count = cpu_ids[count - 1] / 32 + 1;
+    words = g_new0 (guint32, words_count);
+    for (i = 0; i < count; i++)
+        words[cpu_ids[i] / 32] |= 1U << (cpu_ids[i] % 32);
+
+    /* 0-3 -> f, 0-3,32 -> 1,0000000f */
+    g_string_append_printf (mask, "%x", words[words_count - 1]);
+    for (i = words_count - 1; i > 0; i--)
+        g_string_append_printf (mask, ",%08x", words[i - 1]);
+
+    g_free (words);
+
+    return g_string_free (mask, FALSE);
+}
+
+static void
+detect_little_cluster (Interrupts *self)
+{
+    GList *clusters = topology_get_clusters (topology_get_default ());
+    TopologyCluster *little;
+
+    /* Nothing to steer on symmetric systems */
+    if (g_list_length (clusters) < 2)
+        return;
+
+    little = clusters->data;
+    self->priv->little_cpus = g_strdup (little->cpus);
+    self->priv->little_mask = format_cpu_mask (
+        little->cpu_ids, little->cpus_count
+    );
+}
+
+static char *
+get_irq_actions (const char *irq)
+{
+    g_autofree char *path = NULL;
+    g_autofree char *filename = NULL;
+    char *actions = NULL;
+
+    filename = g_build_filename (IRQ_ACTIONS_DIR, irq, "actions", NULL);
+    path = get_root_path (filename);
+    if (!g_file_get_contents (path, &actions, NULL, NULL))
+        return NULL;
+
+    g_strstrip (actions);
+
+    return actions;
+}
+
+static void
+save_affinities (Interrupts *self)
+{
+    g_autoptr (GKeyFile) key_file = g_key_file_new ();
+    g_autofree char *runtime_dir = get_root_path (RUNTIME_DIR);
+    g_autofree char *filename = get_root_path (SAVED_AFFINITIES_FILE);
+    g_autoptr (GError) error = NULL;
+    GHashTableIter iter;
+    gpointer key;
+    gpointer value;
+
+    if (g_hash_table_size (self->priv->saved) == 0) {
+        g_unlink (filename);
+        return;
+    }
+
+    g_hash_table_iter_init (&iter, self->priv->saved);
+    while (g_hash_table_iter_next (&iter, &key, &value))
+        g_key_file_set_string (key_file, SAVED_AFFINITIES_GROUP, key, value);
+
+    g_mkdir_with_parents (runtime_dir, 0755);
+    if (!g_key_file_save_to_file (key_file, filename, &error))
+        g_warning ("Can't save IRQ affinities: %s", error->message);
+}
+
+static void
+steer (Interrupts *self,
+       const char *path,
+       const char *value)
+{
+    char current[256];
+    gint error;
+
+    if (writer_read (writer_get_default (), path, current, sizeof (current)) != 0)
+        return;
+
+    if (g_strcmp0 (current, value) == 0)
+        return;
+
+    /* Probe: per-CPU and managed IRQs refuse any affinity */
+    error = writer_try_write (writer_get_default (), path, value);
+    if (error == EIO || error == EINVAL) {
+        g_message ("Can't steer %s, skipping it", path);
+        g_hash_table_add (self->priv->pinned, g_strdup (path));
+        return;
+    }
+
+    if (error != 0) {
+        if (error != ENOENT)
+            g_warning (
+                "Can't write %s to %s: %s", value, path, g_strerror (error)
+            );
+        return;
+    }
+
+    /* First value is the one to restore */
+    if (!g_hash_table_contains (self->priv->saved, path))
+        g_hash_table_insert (
+            self->priv->saved, g_strdup (path), g_strdup (current)
+        );
+}
+
+static void
+steer_irqs (Interrupts *self)
+{
+    g_autofree char *irq_dir = get_root_path (IRQ_DIR);
+    g_autoptr (GDir) dir = g_dir_open (irq_dir, 0, NULL);
+    const char *irq;
+
+    if (dir == NULL)
+        return;
+
+    while ((irq = g_dir_read_name (dir)) != NULL) {
+        g_autofree char *actions = NULL;
+        g_autofree char *affinity = NULL;
+        char *end;
+
+        strtoul (irq, &end, 10);
+        if (*end != '\0')
+            continue;
+
+        affinity = g_build_filename (
+            irq_dir, irq, "smp_affinity_list", NULL
+        );
+        if (g_hash_table_contains (self->priv->pinned, affinity))
+            continue;
+
+        /* Unused, or exempted device */
+        actions = get_irq_actions (irq);
+        if (actions == NULL || *actions == '\0' ||
+                matcher_match (self->priv->blacklist, actions))
+            continue;
+
+        steer (self, affinity, self->priv->little_cpus);
+    }
+}
+
+static void
+restore (Interrupts *self)
+{
+    GHashTableIter iter;
+    gpointer key;
+    gpointer value;
+
+    /* Freed IRQs are gone, ENOENT is silent */
+    g_hash_table_iter_init (&iter, self->priv->saved);
+    while (g_hash_table_iter_next (&iter, &key, &value))
+        writer_write (writer_get_default (), key, value);
+
+    g_hash_table_remove_all (self->priv->saved);
+    save_affinities (self);
+}
+
+static void
+restore_previous (Interrupts *self)
+{
+    g_autoptr (GKeyFile) key_file = g_key_file_new ();
+    g_autofree char *filename = get_root_path (SAVED_AFFINITIES_FILE);
+    g_auto (GStrv) paths = NULL;
+    guint i;
+
+    if (!g_key_file_load_from_file (key_file, filename, G_KEY_FILE_NONE, NULL))
+        return;
+
+    g_warning ("Restoring IRQ affinities from a previous run");
+    paths = g_key_file_get_keys (
+        key_file, SAVED_AFFINITIES_GROUP, NULL, NULL
+    );
+    for (i = 0; paths != NULL && paths[i] != NULL; i++)
+        g_hash_table_insert (
+            self->priv->saved,
+            g_strdup (paths[i]),
+            g_key_file_get_string (
+                key_file, SAVED_AFFINITIES_GROUP, paths[i], NULL
+            )
+        );
+
+    restore (self);
+}
+
+static void
+interrupts_dispose (GObject *interrupts)
+{
+    G_OBJECT_CLASS (interrupts_parent_class)->dispose (interrupts);
+}
+
+static void
+interrupts_finalize (GObject *interrupts)
+{
+    Interrupts *self = INTERRUPTS (interrupts);
+
+    matcher_free (self->priv->blacklist);
+    g_free (self->priv->little_cpus);
+    g_free (self->priv->little_mask);
+    g_hash_table_destroy (self->priv->saved);
+    g_hash_table_destroy (self->priv->pinned);
+
+    G_OBJECT_CLASS (interrupts_parent_class)->finalize (interrupts);
+}
+
+static void
+interrupts_class_init (InterruptsClass *klass)
+{
+    GObjectClass *object_class;
+
+    object_class = G_OBJECT_CLASS (klass);
+    object_class->dispose = interrupts_dispose;
+    object_class->finalize = interrupts_finalize;
+}
+
+static void
+interrupts_init (Interrupts *self)
+{
+    self->priv = interrupts_get_instance_private (self);
+
+    self->priv->blacklist = matcher_new ();
+    self->priv->little_cpus = NULL;
+    self->priv->little_mask = NULL;
+    self->priv->saved = g_hash_table_new_full (
+        g_str_hash, g_str_equal, g_free, g_free
+    );
+    self->priv->pinned = g_hash_table_new_full (
+        g_str_hash, g_str_equal, g_free, NULL
+    );
+
+    detect_little_cluster (self);
+    restore_previous (self);
+}
+
+/**
+ * interrupts_new:
+ *
+ * Creates a new #Interrupts
+ *
+ * Returns: (transfer full): a new #Interrupts
+ *
+ **/
+GObject *
+interrupts_new (void)
+{
+    GObject *interrupts;
+
+    interrupts = g_object_new (TYPE_INTERRUPTS, NULL);
+
+    return interrupts;
+}
+
+/**
+ * interrupts_set_blacklist:
+ *
+ * Set IRQs to leave alone, matched against their actions (ex: touch)
+ *
+ * @self: a #Interrupts
+ * @blacklist: (transfer full): a #Matcher
+ */
+void
+interrupts_set_blacklist (Interrupts *self,
+                          Matcher    *blacklist)
+{
+    matcher_free (self->priv->blacklist);
+
+    self->priv->blacklist = blacklist;
+}
+
+/**
+ * interrupts_set_powersave:
+ *
+ * Steer IRQs and unbound workqueues to little cluster, or restore them
+ *
+ * @self: a #Interrupts
+ * @powersave: TRUE to steer
+ */
+void
+interrupts_set_powersave (Interrupts *self,
+                          gboolean    powersave)
+{
+    g_autofree char *workqueue_cpumask = NULL;
+
+    if (!powersave) {
+        restore (self);
+        return;
+    }
+
+    if (self->priv->little_cpus == NULL)
+        return;
+
+    steer_irqs (self);
+
+    workqueue_cpumask = get_root_path (WORKQUEUE_CPUMASK);
+    steer (self, workqueue_cpumask, self->priv->little_mask);
+
+    save_affinities (self);
+}
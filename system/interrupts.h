@@ -0,0 +1,56 @@
+/*
+ * Copyright Cedric Bellegarde <cedric.bellegarde@adishatz.org>
+ */
+
+#ifndef INTERRUPTS_H
+#define INTERRUPTS_H
+
+#include <glib.h>
+#include <glib-object.h>
+
+#include "../common/matcher.h"
+
+#define TYPE_INTERRUPTS \
+    (interrupts_get_type ())
+#define INTERRUPTS(obj) \
+    (G_TYPE_CHECK_INSTANCE_CAST \
+    ((obj), TYPE_INTERRUPTS, Interrupts))
+#define INTERRUPTS_CLASS(cls) \
+    (G_TYPE_CHECK_CLASS_CAST \
+    ((cls), TYPE_INTERRUPTS, InterruptsClass))
+#define IS_INTERRUPTS(obj) \
+    (G_TYPE_CHECK_INSTANCE_TYPE \
+    ((obj), TYPE_INTERRUPTS))
+#define IS_INTERRUPTS_CLASS(cls) \
+    (G_TYPE_CHECK_CLASS_TYPE \
+    ((cls), TYPE_INTERRUPTS))
+#define INTERRUPTS_GET_CLASS(obj) \
+    (G_TYPE_INSTANCE_GET_CLASS \
+    ((obj), TYPE_INTERRUPTS, InterruptsClass))
+
+G_BEGIN_DECLS
+
+typedef struct _Interrupts Interrupts;
+typedef struct _InterruptsClass InterruptsClass;
+typedef struct _InterruptsPrivate InterruptsPrivate;
+
+struct _Interrupts {
+    GObject parent;
+    InterruptsPrivate *priv;
+};
+
+struct _InterruptsClass {
+    GObjectClass parent_class;
+};
+
+GType            interrupts_get_type          (void) G_GNUC_CONST;
+
+GObject*         interrupts_new               (void);
+void             interrupts_set_blacklist     (Interrupts *self,
+                                               Matcher    *blacklist);
+void             interrupts_set_powersave     (Interrupts *self,
+                                               gboolean    powersave);
+
+G_END_DECLS
+
+#endif
@@ -6,20 +6,242 @@
 #include <stdarg.h>
 
 #include <gio/gio.h>
+#include <glib/gstdio.h>
 
+#include "capabilities.h"
+#include "config.h"
 #include "kernel_settings.h"
+#include "../common/define.h"
+#include "../common/reconciler.h"
 #include "../common/utils.h"
+#include "../common/writer.h"
 
-/* struct _KernelSettingsPrivate { */
-/* }; */
+#define DEFAULTS_FILE RUNTIME_DIR "/kernel-defaults"
+#define DEFAULTS_GROUP "defaults"
+
+/*
+ * Knobs changed on screen off. Their values are snapshotted before we
+ * touch them and restored on screen on: vendors tune them. The snapshot
+ * lives in /run, so a restarted daemon does not take powersave values
+ * for defaults.
+ */
+
+typedef struct {
+    const char *path;
+    const char *value;
+    gboolean deferred;
+} PowersaveSetting;
+
+static const PowersaveSetting powersave_settings[] = {
+    /* https://www.fatalerrors.org/a/schedtune-learning-notes.html */
+    { "/sys/fs/cgroup/schedtune/schedtune.boost", "0", FALSE },
+    { "/sys/fs/cgroup/schedtune/schedtune.prefer_idle", "0", FALSE },
+    { "/proc/sys/kernel/sched_boost", "0", FALSE },
+    /* Do not move big tasks from little cluster to big cluster */
+    { "/proc/sys/kernel/sched_walt_rotate_big_tasks", "0", FALSE },
+    /* Disable LPM predictions */
+    { "/sys/module/lpm_levels/parameters/lpm_prediction", "N", FALSE },
+    /* Reduce memory management power usage, can wait for display */
+    { "/proc/sys/vm/swappiness", "5", TRUE },
+    { "/proc/sys/vm/dirty_background_ratio", "50", TRUE },
+    { "/proc/sys/vm/dirty_ratio", "90", TRUE },
+    { "/proc/sys/vm/dirty_writeback_centisecs", "60000", TRUE },
+    { "/proc/sys/vm/dirty_expire_centisecs", "60000", TRUE },
+    /* Enable laptop mode */
+    { "/proc/sys/vm/laptop_mode", "5", TRUE },
+    { NULL }
+};
+
+struct _KernelSettingsPrivate {
+    gboolean powersave;
+
+    /* path -> value, only knobs found on device */
+    GHashTable *defaults;
+    /* path -> value, device overrides of defaults */
+    GHashTable *screen_on_values;
+};
 
 G_DEFINE_TYPE_WITH_CODE (
     KernelSettings,
     kernel_settings,
     G_TYPE_OBJECT,
-    /* G_ADD_PRIVATE (KernelSettings) */
+    G_ADD_PRIVATE (KernelSettings)
 )
 
+static void
+write_setting (const char *path,
+               const char *value)
+{
+    g_autofree char *filename = get_root_path (path);
+
+    /* Most knobs are vendor specific */
+    if (!capabilities_exists (capabilities_get_default (), filename))
+        return;
+
+    write_to_file (filename, value);
+}
+
+static const PowersaveSetting *
+get_powersave_setting (const char *path)
+{
+    const PowersaveSetting *setting;
+
+    for (setting = powersave_settings; setting->path != NULL; setting++)
+        if (g_strcmp0 (setting->path, path) == 0)
+            return setting;
+
+    return NULL;
+}
+
+static void
+load_defaults (KernelSettings *self,
+               GKeyFile       *key_file)
+{
+    const PowersaveSetting *setting;
+
+    for (setting = powersave_settings; setting->path != NULL; setting++) {
+        char *value = g_key_file_get_string (
+            key_file, DEFAULTS_GROUP, setting->path, NULL
+        );
+
+        if (value != NULL)
+            g_hash_table_insert (
+                self->priv->defaults, (gpointer) setting->path, value
+            );
+    }
+}
+
+static void
+snapshot_defaults (KernelSettings *self)
+{
+    g_autoptr (GKeyFile) key_file = g_key_file_new ();
+    g_autofree char *runtime_dir = get_root_path (RUNTIME_DIR);
+    g_autofree char *filename = get_root_path (DEFAULTS_FILE);
+    g_autoptr (GError) error = NULL;
+    const PowersaveSetting *setting;
+
+    /* We already ran since boot, knobs may hold powersave values */
+    if (g_key_file_load_from_file (key_file, filename, G_KEY_FILE_NONE, NULL)) {
+        load_defaults (self, key_file);
+        return;
+    }
+
+    for (setting = powersave_settings; setting->path != NULL; setting++) {
+        g_autofree char *path = get_root_path (setting->path);
+        char value[256];
+
+        /* Most knobs are vendor specific */
+        if (!capabilities_exists (capabilities_get_default (), path))
+            continue;
+
+        if (writer_read (writer_get_default (), path, value, sizeof (value)) != 0)
+            continue;
+
+        g_key_file_set_string (key_file, DEFAULTS_GROUP, setting->path, value);
+        g_hash_table_insert (
+            self->priv->defaults, (gpointer) setting->path, g_strdup (value)
+        );
+    }
+
+    g_mkdir_with_parents (runtime_dir, 0755);
+    if (!g_key_file_save_to_file (key_file, filename, &error))
+        g_warning ("Can't save kernel defaults: %s", error->message);
+}
+
+static void
+apply_settings (KernelSettings *self,
+                gboolean        powersave,
+                gboolean        deferred)
+{
+    Reconciler *reconciler = reconciler_get_default ();
+    g_autoptr (GHashTable) desired = reconciler_state_new ();
+    const PowersaveSetting *setting;
+
+    for (setting = powersave_settings; setting->path != NULL; setting++) {
+        const char *value = g_hash_table_lookup (
+            self->priv->defaults, setting->path
+        );
+        g_autofree char *path = NULL;
+
+        /* Knob not found on device */
+        if (value == NULL || setting->deferred != deferred)
+            continue;
+
+        if (powersave)
+            value = setting->value;
+        else if (g_hash_table_contains (self->priv->screen_on_values, setting->path))
+            value = g_hash_table_lookup (
+                self->priv->screen_on_values, setting->path
+            );
+
+        path = get_root_path (setting->path);
+        reconciler_state_add (desired, path, value);
+    }
+
+    reconciler_journal_set_priority (
+        reconciler,
+        deferred ? RECONCILER_PRIORITY_DEFERRED : RECONCILER_PRIORITY_KERNEL
+    );
+    reconciler_apply (reconciler, desired, FALSE);
+    reconciler_journal_set_priority (reconciler, RECONCILER_PRIORITY_NONE);
+}
+
+#ifdef CPUSET_ENABLED
+static void
+find_wakeup_sources (const char  *path,
+                     GList      **wakeup_sources)
+{
+    g_autoptr (GDir) dir = g_dir_open (path, 0, NULL);
+    const char *name;
+
+    if (dir == NULL)
+        return;
+
+    while ((name = g_dir_read_name (dir)) != NULL) {
+        g_autofree char *filename = g_build_filename (path, name, NULL);
+        GStatBuf stat_buf;
+
+        /* sysfs is full of symlinks loops */
+        if (g_lstat (filename, &stat_buf) != 0)
+            continue;
+
+        if (S_ISDIR (stat_buf.st_mode)) {
+            find_wakeup_sources (filename, wakeup_sources);
+        } else if (g_strcmp0 (name, "wakeup") == 0 &&
+                g_str_has_suffix (path, "/power")) {
+            *wakeup_sources = g_list_prepend (
+                *wakeup_sources, g_steal_pointer (&filename)
+            );
+        }
+    }
+}
+
+static void
+disable_wakeup_sources (void)
+{
+    Capabilities *capabilities = capabilities_get_default ();
+    g_autofree char *devices_dir = get_root_path ("/sys/devices");
+    GList *wakeup_sources = NULL;
+    const char *wakeup_source;
+
+    /* Walking /sys/devices is slow */
+    if (!capabilities_get_probe (
+            capabilities, "wakeup-sources", &wakeup_sources)) {
+        find_wakeup_sources (devices_dir, &wakeup_sources);
+        capabilities_set_probe (
+            capabilities, "wakeup-sources", wakeup_sources
+        );
+    }
+
+    GFOREACH (wakeup_sources, wakeup_source) {
+        writer_write (writer_get_default (), wakeup_source, "disabled");
+        writer_forget (writer_get_default (), wakeup_source);
+    }
+
+    g_list_free_full (wakeup_sources, g_free);
+}
+#endif
+
 static void
 kernel_settings_dispose (GObject *kernel_settings)
 {
@@ -29,6 +251,11 @@ kernel_settings_dispose (GObject *kernel_settings)
 static void
 kernel_settings_finalize (GObject *kernel_settings)
 {
+    KernelSettings *self = KERNEL_SETTINGS (kernel_settings);
+
+    g_hash_table_destroy (self->priv->defaults);
+    g_hash_table_destroy (self->priv->screen_on_values);
+
     G_OBJECT_CLASS (kernel_settings_parent_class)->finalize (kernel_settings);
 }
 
@@ -47,99 +274,115 @@ kernel_settings_init (KernelSettings *self)
 {
     self->priv = kernel_settings_get_instance_private (self);
 
+    self->priv->powersave = FALSE;
+    self->priv->defaults = g_hash_table_new_full (
+        g_str_hash, g_str_equal, NULL, g_free
+    );
+    self->priv->screen_on_values = g_hash_table_new_full (
+        g_str_hash, g_str_equal, NULL, g_free
+    );
+
+    /* Before any change */
+    snapshot_defaults (self);
+
     /* Disable Adreno bus control */
-    write_to_file (
+    write_setting (
         "/sys/class/kgsl/kgsl-3d0/bus_split", "0"
     );
 
     /* Disable Adreno NAP */
-    write_to_file (
+    write_setting (
         "/sys/class/kgsl/kgsl-3d0/force_no_nap", "1"
     );
 
     /* Do not keep bus on when screen is off */
-    write_to_file (
+    write_setting (
         "/sys/class/kgsl/kgsl-3d0/force_bus_on", "0"
     );
 
     /* Do not keep clock on when screen is off */
-    write_to_file (
+    write_setting (
         "/sys/class/kgsl/kgsl-3d0/force_clk_on", "0"
     );
 
     /* Do not keep regulators on when screen is on */
-    write_to_file (
+    write_setting (
         "/sys/class/kgsl/kgsl-3d0/force_rail_on", "0"
     );
 
     /* On fork, do not give more priority to child than parent */
-    write_to_file (
+    write_setting (
         "/proc/sys/kernel/sched_child_runs_first", "0"
     );
 
     /* Disable IRQ debugging */
-    write_to_file (
+    write_setting (
         "/sys/module/spurious/parameters/noirqdebug", "Y"
     );
 
     /* Hints to the kernel how much CPU time it should be allowed
      * to use to handle perf sampling events
      */
-    write_to_file (
+    write_setting (
         "/proc/sys/kernel/perf_cpu_time_max_percent", "20"
     );
 
     /* For non conservative boost: default kernel value */
-    write_to_file (
+    write_setting (
         "/proc/sys/kernel/sched_min_task_util_for_colocation", "35"
     );
     /* For conservative boost: default kernel value */
-    write_to_file (
+    write_setting (
         "/proc/sys/kernel/sched_min_task_util_for_boost", "51"
     );
 
     /* CAF's hispeed boost and predicted load features aren't any good. */
-    write_to_file (
+    write_setting (
         "/proc/sys/kernel/sched_conservative_pl", "0"
     );
 
     /* Disable kernel debug */
-    write_to_file (
+    write_setting (
         "/sys/kernel/debug/debug_enabled", "N"
     );
 
     /* Disable vidc fw debug */
-    write_to_file (
+    write_setting (
         "/sys/kernel/debug/msm_vidc/fw_debug_mode", "0"
     );
 
     /* self-tests disabled */
-    write_to_file (
+    write_setting (
         "/sys/module/cryptomgr/parameters/notests", "Y"
     );
 
     /* Do not automatically load TTY Line Disciplines */
-    write_to_file (
+    write_setting (
         "/proc/sys/dev/tty/ldisc_autoload", "0"
     );
 
     /* Disable expedited RCU */
-    write_to_file (
+    write_setting (
         "/sys/kernel/rcu_normal", "1"
     );
-    write_to_file (
+    write_setting (
         "/sys/kernel/rcu_expedited", "0"
     );
 
     /* Disable unnecessary printk logging */
-    write_to_file (
+    write_setting (
         "/proc/sys/kernel/printk_devkmsg", "off"
     );
 
     /* Update /proc/stat less often to reduce jitter */
-    write_to_file (
+    write_setting (
         "/proc/sys/vm/stat_interval", "120"
     );
+
+#ifdef CPUSET_ENABLED
+    /* Android devices never sleep, only idle: no need for wakeup sources */
+    disable_wakeup_sources ();
+#endif
 }
 
 /**
@@ -166,97 +409,80 @@ kernel_settings_new (void)
  * Set kernel_settings devices to powersave
  *
  * @param #KernelSettings
- * @param powersave: True to enable powersave
+ * @param powersave: True to enable powersave, False to restore defaults
  */
 void
 kernel_settings_set_powersave (KernelSettings *kernel_settings,
                                gboolean        powersave)
 {
-    if (powersave) {
-        /* https://www.fatalerrors.org/a/schedtune-learning-notes.html */
-        write_to_file (
-            "/sys/fs/cgroup/schedtune/schedtune.boost", "0"
-        );
-        write_to_file (
-            "/sys/fs/cgroup/schedtune/schedtune.prefer_idle", "0"
-        );
-        write_to_file (
-            "/proc/sys/kernel/sched_boost", "0"
-        );
+    kernel_settings->priv->powersave = powersave;
 
-        /* Do not move big tasks from little cluster to big cluster */
-        write_to_file (
-            "/proc/sys/kernel/sched_walt_rotate_big_tasks", "0"
-        );
+    apply_settings (kernel_settings, powersave, FALSE);
+    apply_settings (kernel_settings, powersave, TRUE);
+}
 
-        /* Reduce memory management power usage */
-        write_to_file (
-            "/proc/sys/vm/swappiness", "5"
-        );
-        write_to_file (
-            "/proc/sys/vm/dirty_background_ratio", "50"
-        );
-        write_to_file (
-            "/proc/sys/vm/dirty_ratio", "90"
-        );
-        write_to_file (
-            "/proc/sys/vm/dirty_writeback_centisecs", "60000"
-        );
-        write_to_file (
-            "/proc/sys/vm/dirty_expire_centisecs", "60000"
-        );
+/**
+ * kernel_settings_restore:
+ *
+ * Restore settings changed by powersave, from undo journal
+ *
+ * @param #KernelSettings
+ * @param deferred: TRUE to restore settings that can wait for display
+ */
+void
+kernel_settings_restore (KernelSettings *kernel_settings,
+                         gboolean        deferred)
+{
+    Reconciler *reconciler = reconciler_get_default ();
 
-        /* Enable laptop mode */
-        write_to_file (
-            "/proc/sys/vm/laptop_mode", "5"
-        );
+    kernel_settings->priv->powersave = FALSE;
 
-        /* Disable LPM predictions */
-        write_to_file (
-            "/sys/module/lpm_levels/parameters/lpm_prediction", "N"
-        );
-    } else {
-        /* https://lwn.net/Articles/706374/ */
-        write_to_file (
-            "/sys/fs/cgroup/schedtune/schedtune.boost", "10"
-        );
-        write_to_file (
-            "/sys/fs/cgroup/schedtune/schedtune.prefer_idle", "1"
-        );
-        write_to_file (
-            "/proc/sys/kernel/sched_boost", "1"
+    if (reconciler_journal_is_open (reconciler))
+        reconciler_journal_replay (
+            reconciler,
+            deferred ? RECONCILER_PRIORITY_DEFERRED : RECONCILER_PRIORITY_KERNEL
         );
 
-        /* Move big tasks from little cluster to big cluster */
-        write_to_file (
-            "/proc/sys/kernel/sched_walt_rotate_big_tasks", "1"
-        );
+    /* Screen on values may have changed while screen was off */
+    apply_settings (kernel_settings, FALSE, deferred);
+}
 
-        /* Default kernel value */
-        write_to_file (
-            "/proc/sys/vm/swappiness", "60"
-        );
-        write_to_file (
-            "/proc/sys/vm/dirty_background_ratio", "10"
-        );
-        write_to_file (
-            "/proc/sys/vm/dirty_ratio", "20"
-        );
-        write_to_file (
-            "/proc/sys/vm/dirty_writeback_centisecs", "500"
-        );
-        write_to_file (
-            "/proc/sys/vm/dirty_expire_centisecs", "3000"
-        );
+/**
+ * kernel_settings_set_screen_on_values:
+ *
+ * Set values to use on screen on instead of kernel defaults
+ *
+ * @param #KernelSettings
+ * @param values: values by knob path, as a{ss}
+ */
+void
+kernel_settings_set_screen_on_values (KernelSettings *kernel_settings,
+                                      GVariant       *values)
+{
+    GVariantIter iter;
+    const char *path;
+    const char *value;
 
-        /* Disable laptop mode */
-        write_to_file (
-            "/proc/sys/vm/laptop_mode", "0"
-        );
+    g_hash_table_remove_all (kernel_settings->priv->screen_on_values);
+
+    g_variant_iter_init (&iter, values);
+    while (g_variant_iter_next (&iter, "{&s&s}", &path, &value)) {
+        const PowersaveSetting *setting = get_powersave_setting (path);
+
+        if (setting == NULL) {
+            g_warning ("Unknown kernel setting: %s", path);
+            continue;
+        }
 
-        /* Enable LPM predictions */
-        write_to_file (
-            "/sys/module/lpm_levels/parameters/lpm_prediction", "Y"
+        g_hash_table_replace (
+            kernel_settings->priv->screen_on_values,
+            (gpointer) setting->path,
+            g_strdup (value)
         );
     }
-}
\ No newline at end of file
+
+    if (!kernel_settings->priv->powersave) {
+        apply_settings (kernel_settings, FALSE, FALSE);
+        apply_settings (kernel_settings, FALSE, TRUE);
+    }
+}
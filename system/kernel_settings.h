@@ -41,11 +41,15 @@ struct _KernelSettingsClass {
     GObjectClass parent_class;
 };
 
-GType           kernel_settings_get_type      (void) G_GNUC_CONST;
-
-GObject*        kernel_settings_new           (void);
-void            kernel_settings_set_powersave (KernelSettings *kernel_settings,
-                                               gboolean        powersave);
+GType           kernel_settings_get_type             (void) G_GNUC_CONST;
+
+GObject*        kernel_settings_new                  (void);
+void            kernel_settings_set_powersave        (KernelSettings *kernel_settings,
+                                                      gboolean        powersave);
+void            kernel_settings_restore              (KernelSettings *kernel_settings,
+                                                      gboolean        deferred);
+void            kernel_settings_set_screen_on_values (KernelSettings *kernel_settings,
+                                                      GVariant       *values);
 
 G_END_DECLS
 
@@ -10,9 +10,19 @@
 #include <stdlib.h>
 
 #include "bus.h"
+#include "capabilities.h"
+#include "freezer.h"
+#include "hotplug.h"
+#include "interrupts.h"
 #include "kernel_settings.h"
 #include "logind.h"
 #include "manager.h"
+#include "topology.h"
+#include "../common/cgroups.h"
+#include "../common/reconciler.h"
+#include "../common/units.h"
+#include "../common/utils.h"
+#include "../common/writer.h"
 
 static GMainLoop *loop;
 
@@ -28,9 +38,16 @@ main (gint argc, char * argv[])
     GResource *resource;
     g_autoptr (GOptionContext) context = NULL;
     g_autoptr (GError) error = NULL;
+    g_autofree char *root_dir = NULL;
     gboolean version = FALSE;
+    gboolean restore = FALSE;
     GOptionEntry main_entries[] = {
         {"version", 0, 0, G_OPTION_ARG_NONE, &version, "Show version"},
+        {"root", 0, 0, G_OPTION_ARG_FILENAME, &root_dir,
+         "Use sysfs/procfs/cgroups from this root (default: $MPS_ROOT_DIR)",
+         "DIR"},
+        {"restore", 0, 0, G_OPTION_ARG_NONE, &restore,
+         "Bring back parked cores and frozen processes, then exit"},
         {NULL}
     };
 
@@ -49,6 +66,19 @@ main (gint argc, char * argv[])
         return EXIT_SUCCESS;
     }
 
+    if (root_dir == NULL)
+        root_dir = g_strdup (g_getenv ("MPS_ROOT_DIR"));
+    set_root_dir (root_dir);
+
+    /* ExecStopPost: a crashed instance may have left cores offline */
+    if (restore) {
+        g_object_unref (hotplug_new ());
+        g_object_unref (freezer_new ());
+        g_object_unref (interrupts_new ());
+        writer_free_default ();
+        return EXIT_SUCCESS;
+    }
+
     resource = g_resource_load (MPS_RESOURCES, NULL);
     g_resources_register (resource);
 
@@ -61,6 +91,12 @@ main (gint argc, char * argv[])
     g_clear_object (&manager);
     logind_free_default ();
     bus_free_default ();
+    cgroups_free_default ();
+    units_free_default ();
+    topology_free_default ();
+    capabilities_free_default ();
+    reconciler_free_default ();
+    writer_free_default ();
 
     return EXIT_SUCCESS;
 }
@@ -8,44 +8,64 @@
 #include <gio/gio.h>
 
 #include "bus.h"
+#include "capabilities.h"
 #include "cpufreq.h"
 #include "config.h"
 #include "devfreq.h"
 #include "processes.h"
+#include "interrupts.h"
 #include "kernel_settings.h"
 #include "logind.h"
 #include "manager.h"
+#include "pressure.h"
+#include "transitions.h"
 
 #ifdef WIFI_ENABLED
 #include "wifi.h"
 #endif
 
+#include "../common/cgroups.h"
 #include "../common/define.h"
+#include "../common/matcher.h"
+#include "../common/reconciler.h"
 #include "../common/services.h"
+#include "../common/throttle.h"
 #include "../common/utils.h"
 
+/* Display is up by then: vm tunables only matter for steady state */
+#define SCREEN_ON_DEFERRED_DELAY 3
+
 struct _ManagerPrivate {
+    Transitions *transitions;
+
     Cpufreq *cpufreq;
     Devfreq *devfreq;
+    Interrupts *interrupts;
     KernelSettings *kernel_settings;
+    Pressure *pressure;
     Processes *processes;
     Services *services;
+    Throttle *throttle;
 #ifdef WIFI_ENABLED
     WiFi *wifi;
 #endif
 
+    gboolean screen_off;
+    gboolean dozing;
+    gboolean pressure_suspended;
+
     gboolean screen_off_power_saving;
     gboolean suspend_services;
     gboolean suspend_bluetooth;
 
-    GList *suspend_processes;
-    GList *cpuset_background_processes;
+    Matcher *cpuset_background_processes;
     GList *suspend_system_services_blacklist;
     GList *suspend_bluetooth_services;
-
-    char *cgroups_user_dir;
+    Matcher *suspend_services_blacklist;
 
     gboolean radio_power_saving;
+
+    guint deferred_id;
 };
 
 G_DEFINE_TYPE_WITH_CODE (
@@ -55,13 +75,244 @@ G_DEFINE_TYPE_WITH_CODE (
     G_ADD_PRIVATE (Manager)
 )
 
-static const char *
-get_governor_from_power_profile (PowerProfile power_profile) {
-    if (power_profile == POWER_PROFILE_POWER_SAVER)
-        return "powersave";
-    if (power_profile == POWER_PROFILE_PERFORMANCE)
-        return "performance";
-    return NULL;
+typedef struct {
+    Manager *manager;
+    gboolean screen_on;
+    /* Monotonic time screen state changed, 0 if unknown */
+    gint64 time;
+} ScreenState;
+
+static gboolean
+publish_screen_state (gpointer user_data)
+{
+    bus_screen_state_changed (bus_get_default (), GPOINTER_TO_INT (user_data));
+
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean
+publish_cpuset_layout (gpointer user_data)
+{
+    bus_set_cpuset_layout (bus_get_default (), user_data);
+
+    return G_SOURCE_REMOVE;
+}
+
+static void
+update_cpuset_layout (Manager *self)
+{
+    GVariant *layout = g_variant_ref_sink (
+        processes_get_cpuset_layout (self->priv->processes)
+    );
+
+    /* Bus lives on main loop */
+    g_main_context_invoke_full (
+        NULL,
+        G_PRIORITY_DEFAULT,
+        publish_cpuset_layout,
+        layout,
+        (GDestroyNotify) g_variant_unref
+    );
+}
+
+static void
+screen_state_notify (gpointer user_data)
+{
+    ScreenState *state = user_data;
+
+    if (!state->manager->priv->screen_off_power_saving)
+        return;
+
+    g_main_context_invoke (
+        NULL, publish_screen_state, GINT_TO_POINTER (state->screen_on)
+    );
+}
+
+static void
+screen_state_cpufreq (gpointer user_data)
+{
+    ScreenState *state = user_data;
+    Manager *self = state->manager;
+
+    if (!self->priv->screen_off_power_saving)
+        return;
+
+    cpufreq_set_doze_level (
+        self->priv->cpufreq,
+        state->screen_on ? DOZE_LEVEL_SCREEN_ON : DOZE_LEVEL_SCREEN_OFF
+    );
+
+    if (state->screen_on && state->time != 0)
+        g_message (
+            "Full frequency %" G_GINT64_FORMAT " ms after screen on",
+            (g_get_monotonic_time () - state->time) / 1000
+        );
+}
+
+static void
+screen_state_journal (gpointer user_data)
+{
+    ScreenState *state = user_data;
+
+    if (!state->manager->priv->screen_off_power_saving)
+        return;
+
+    /* Screen on replays what screen off changed */
+    reconciler_journal_open (reconciler_get_default ());
+}
+
+static void
+screen_state_devfreq (gpointer user_data)
+{
+    ScreenState *state = user_data;
+    Manager *self = state->manager;
+
+    if (!self->priv->screen_off_power_saving)
+        return;
+
+    devfreq_set_doze_level (
+        self->priv->devfreq,
+        state->screen_on ? DOZE_LEVEL_SCREEN_ON : DOZE_LEVEL_SCREEN_OFF
+    );
+}
+
+static void
+screen_state_kernel (gpointer user_data)
+{
+    ScreenState *state = user_data;
+    Manager *self = state->manager;
+
+    if (!self->priv->screen_off_power_saving)
+        return;
+
+    if (state->screen_on)
+        kernel_settings_restore (self->priv->kernel_settings, FALSE);
+    else
+        kernel_settings_set_powersave (self->priv->kernel_settings, TRUE);
+}
+
+static void
+screen_state_interrupts (gpointer user_data)
+{
+    ScreenState *state = user_data;
+    Manager *self = state->manager;
+
+    if (!self->priv->screen_off_power_saving)
+        return;
+
+    interrupts_set_powersave (self->priv->interrupts, !state->screen_on);
+}
+
+static void
+screen_state_radio (gpointer user_data)
+{
+#ifdef WIFI_ENABLED
+    ScreenState *state = user_data;
+    Manager *self = state->manager;
+
+    if (!self->priv->screen_off_power_saving)
+        return;
+
+    if (self->priv->radio_power_saving)
+        wifi_set_powersave (self->priv->wifi, !state->screen_on);
+#endif
+}
+
+static void
+screen_state_deferred (gpointer user_data)
+{
+    ScreenState *state = user_data;
+    Manager *self = state->manager;
+
+    if (!self->priv->screen_off_power_saving)
+        return;
+
+    kernel_settings_restore (self->priv->kernel_settings, TRUE);
+    reconciler_journal_close (reconciler_get_default ());
+}
+
+static void
+screen_state_processes (gpointer user_data)
+{
+    ScreenState *state = user_data;
+    Manager *self = state->manager;
+
+    if (!self->priv->screen_off_power_saving)
+        return;
+
+    processes_update (self->priv->processes);
+}
+
+static CpuSet
+get_background_cpuset (Manager *self)
+{
+    /* Background cpuset saturated: widen it to the little cluster */
+    if (pressure_is_high (self->priv->pressure, PRESSURE_BACKGROUND))
+        return CPUSET_SYSTEM_BACKGROUND;
+
+    return CPUSET_BACKGROUND;
+}
+
+static void
+set_background_cpuset (Manager *self,
+                       CpuSet   cpuset)
+{
+    processes_set_cpuset (
+        self->priv->processes,
+        self->priv->cpuset_background_processes,
+        cpuset
+    );
+    processes_set_services_cpuset (
+        self->priv->processes,
+        cgroups_get_default (G_BUS_TYPE_SYSTEM),
+        cpuset
+    );
+}
+
+static void
+screen_state_cpusets (gpointer user_data)
+{
+    ScreenState *state = user_data;
+    Manager *self = state->manager;
+
+    if (!self->priv->screen_off_power_saving)
+        return;
+
+    self->priv->screen_off = !state->screen_on;
+
+    set_background_cpuset (
+        self,
+        state->screen_on ? CPUSET_SYSTEM_BACKGROUND : get_background_cpuset (self)
+    );
+    /* User services belong to the user manager, user daemon moves them */
+
+    /* Suspended on cpu pressure, before doze */
+    if (state->screen_on && self->priv->pressure_suspended) {
+        self->priv->pressure_suspended = FALSE;
+        if (!self->priv->dozing)
+            processes_resume (self->priv->processes);
+    }
+
+    /* Suspended processes stayed in freezer cgroup for the session */
+    if (state->screen_on)
+        processes_release (self->priv->processes);
+}
+
+static gboolean
+on_deferred_timeout (gpointer user_data)
+{
+    Manager *self = MANAGER (user_data);
+    ScreenState *state = g_new0 (ScreenState, 1);
+
+    self->priv->deferred_id = 0;
+
+    state->manager = self;
+    state->screen_on = TRUE;
+    transitions_run (
+        self->priv->transitions, screen_state_deferred, state, g_free
+    );
+
+    return G_SOURCE_REMOVE;
 }
 
 static void
@@ -70,101 +321,95 @@ on_screen_state_changed (Logind logind,
                          gpointer user_data)
 {
     Manager *self = MANAGER (user_data);
-    GList *system_services = get_cgroup_services (CGROUPS_SYSTEM_SERVICES_DIR);
-    GList *user_slices = get_cgroup_slices (self->priv->cgroups_user_dir);
-    GList *user_services = NULL;
-    const char *slice;
+    ScreenState *state = g_new (ScreenState, 1);
+    Transition *transition;
 
-    GFOREACH (user_slices, slice) {
-        GList *services = get_cgroup_services (slice);
-
-        user_services = g_list_concat (user_services, services);
-    }
+    state->manager = self;
+    state->screen_on = screen_on;
+    state->time = g_get_monotonic_time ();
 
-    if (self->priv->screen_off_power_saving) {
-        bus_screen_state_changed (bus_get_default (), screen_on);
+    /* Journal stays open: next screen on replays deferred writes */
+    g_clear_handle_id (&self->priv->deferred_id, g_source_remove);
 
-        devfreq_set_powersave (self->priv->devfreq, !screen_on);
-        kernel_settings_set_powersave (self->priv->kernel_settings, !screen_on);
+    transition = transition_new (
+        screen_on ? "screen-on" : "screen-off", state, g_free
+    );
 
-#ifdef WIFI_ENABLED
-        if (self->priv->radio_power_saving)
-            wifi_set_powersave (self->priv->wifi, !screen_on);
-#endif
-        if (screen_on) {
-            cpufreq_set_powersave (self->priv->cpufreq, FALSE, TRUE);
-            processes_set_cpuset (
-                self->priv->processes,
-                self->priv->cpuset_background_processes,
-                CPUSET_SYSTEM_BACKGROUND
-            );
-            processes_set_services_cpuset (
-                self->priv->processes,
-                CGROUPS_SYSTEM_SERVICES_DIR,
-                system_services,
-                CPUSET_SYSTEM_BACKGROUND
-            );
-            processes_set_services_cpuset (
-                self->priv->processes,
-                self->priv->cgroups_user_dir,
-                user_services,
-                CPUSET_FOREGROUND
-            );
-        } else {
-            cpufreq_set_powersave (self->priv->cpufreq, TRUE, FALSE);
-            processes_update (self->priv->processes);
-            processes_set_cpuset (
-                self->priv->processes,
-                self->priv->cpuset_background_processes,
-                CPUSET_BACKGROUND
-            );
-            processes_set_services_cpuset (
-                self->priv->processes,
-                CGROUPS_SYSTEM_SERVICES_DIR,
-                system_services,
-                CPUSET_BACKGROUND
-            );
-            processes_set_services_cpuset (
-                self->priv->processes,
-                self->priv->cgroups_user_dir,
-                user_services,
-                CPUSET_SYSTEM_BACKGROUND
-            );
-        }
+    /* Fast path: unpark cores and restore frequencies first */
+    if (screen_on) {
+        transition_add_stage (transition, "cpufreq", screen_state_cpufreq);
+        transition_add_stage (transition, "interrupts", screen_state_interrupts);
+        transition_add_stage (transition, "notify", screen_state_notify);
+        transition_add_stage (transition, "devfreq", screen_state_devfreq);
+        transition_add_stage (transition, "cpusets", screen_state_cpusets);
+        transition_add_stage (transition, "kernel", screen_state_kernel);
+        transition_add_stage (transition, "radio", screen_state_radio);
+
+        self->priv->deferred_id = g_timeout_add_seconds (
+            SCREEN_ON_DEFERRED_DELAY, on_deferred_timeout, self
+        );
+    } else {
+        transition_add_stage (transition, "journal", screen_state_journal);
+        transition_add_stage (transition, "notify", screen_state_notify);
+        transition_add_stage (transition, "devfreq", screen_state_devfreq);
+        transition_add_stage (transition, "kernel", screen_state_kernel);
+        transition_add_stage (transition, "radio", screen_state_radio);
+        transition_add_stage (transition, "cpufreq", screen_state_cpufreq);
+        transition_add_stage (transition, "processes", screen_state_processes);
+        transition_add_stage (transition, "cpusets", screen_state_cpusets);
+        transition_add_stage (transition, "interrupts", screen_state_interrupts);
     }
 
-    g_list_free_full (system_services, g_free);
-    g_list_free_full (user_slices, g_free);
-    g_list_free_full (user_services, g_free);
+    /* Supersedes a transition in flight */
+    transitions_queue (self->priv->transitions, transition);
+}
+
+static void
+restore_screen_on (Manager *self)
+{
+    ScreenState state = { self, TRUE, 0 };
+
+    screen_state_cpufreq (&state);
+    screen_state_interrupts (&state);
+    screen_state_devfreq (&state);
+    screen_state_cpusets (&state);
+    screen_state_kernel (&state);
+    screen_state_radio (&state);
+    screen_state_deferred (&state);
+    throttle_restore (self->priv->throttle);
 }
 
 static void
 set_power_profile (Manager      *self,
                    PowerProfile  power_profile)
 {
-    const char *governor = get_governor_from_power_profile (power_profile);
-
-    cpufreq_set_governor (self->priv->cpufreq, governor);
-    devfreq_set_governor (self->priv->devfreq, governor);
+    cpufreq_set_power_profile (self->priv->cpufreq, power_profile);
+    devfreq_set_power_profile (self->priv->devfreq, power_profile);
+    processes_set_power_profile (self->priv->processes, power_profile);
 }
 
 static void
-set_cgroups_user_dir (Manager  *self,
-                      GVariant *value)
+update_suspend_services_blacklist (Manager *self)
 {
-    if (self->priv->cgroups_user_dir != NULL) {
-        g_free (self->priv->cgroups_user_dir);
-    }
+    Matcher *blacklist;
+    g_autoptr (GList) services = g_list_concat (
+        g_list_copy (self->priv->suspend_system_services_blacklist),
+        g_list_copy (self->priv->suspend_bluetooth_services)
+    );
 
-    g_variant_get (value, "s", &self->priv->cgroups_user_dir);
+    /* Our own unit, now that we have one */
+    services = g_list_prepend (services, (gpointer) SYSTEM_UNIT);
+
+    /* Complete before publishing it, compiled once */
+    blacklist = matcher_new_from_list (services);
+    g_clear_pointer (&self->priv->suspend_services_blacklist, matcher_free);
+    self->priv->suspend_services_blacklist = blacklist;
 }
 
 static void
-on_bus_setting_changed (Bus      *bus,
-                        GVariant *value,
-                        gpointer  user_data)
+apply_setting (Manager  *self,
+               GVariant *value)
 {
-    Manager *self = MANAGER (user_data);
     const char *setting = NULL;
     g_autoptr (GVariant) inner_value = NULL;
 
@@ -174,17 +419,14 @@ on_bus_setting_changed (Bus      *bus,
         gint power_profile = g_variant_get_int32 (inner_value);
         set_power_profile (self, power_profile);
     } else if (g_strcmp0 (setting, "screen-off-power-saving") == 0) {
-        self->priv->screen_off_power_saving = g_variant_get_boolean (inner_value);
+        gboolean enabled = g_variant_get_boolean (inner_value);
 
-        if (!self->priv->screen_off_power_saving) {
-            cpufreq_set_powersave (self->priv->cpufreq, FALSE, TRUE);
-            devfreq_set_powersave (self->priv->devfreq, FALSE);
-        }
+        if (!enabled)
+            restore_screen_on (self);
+        self->priv->screen_off_power_saving = enabled;
     } else if (g_strcmp0 (setting, "cpuset-background-processes") == 0) {
-        g_list_free_full (
-            self->priv->cpuset_background_processes, g_free
-        );
-        self->priv->cpuset_background_processes = get_list_from_variant (
+        matcher_free (self->priv->cpuset_background_processes);
+        self->priv->cpuset_background_processes = matcher_new_from_variant (
             inner_value
         );
     } else if (g_strcmp0 (setting, "suspend-system-services-blacklist") == 0) {
@@ -194,6 +436,7 @@ on_bus_setting_changed (Bus      *bus,
         self->priv->suspend_system_services_blacklist = get_list_from_variant (
             inner_value
         );
+        update_suspend_services_blacklist (self);
     } else if (g_strcmp0 (setting, "devfreq-blacklist") == 0) {
         GList *list = get_list_from_variant (inner_value);
         const char *device;
@@ -206,38 +449,117 @@ on_bus_setting_changed (Bus      *bus,
     } else if (g_strcmp0 (setting, "cpuset-blacklist") == 0) {
         GList *list = get_list_from_variant (inner_value);
 
-        processes_cpuset_set_blacklist (self->priv->processes, list);
-    } else if (g_strcmp0 (setting, "cpuset-topapp") == 0) {
-        GList *list = get_list_from_variant (inner_value);
+        /* Never pin ourselves to background cpus */
+        list = g_list_prepend (list, g_strdup (SYSTEM_UNIT));
+        processes_cpuset_set_blacklist (
+            self->priv->processes, matcher_new_from_list (list)
+        );
 
-        processes_cpuset_set_topapp (self->priv->processes, list);
-    } else if (g_strcmp0 (setting, "cgroups-user-dir") == 0) {
-        set_cgroups_user_dir (self, inner_value);
+        g_list_free_full (list, g_free);
+    } else if (g_strcmp0 (setting, "cpu-idle-services") == 0) {
+        processes_set_cpu_idle_services (
+            self->priv->processes, matcher_new_from_variant (inner_value)
+        );
+    } else if (g_strcmp0 (setting, "cpuset-layout") == 0) {
+        processes_set_cpuset_layout (self->priv->processes, inner_value);
+        update_cpuset_layout (self);
+    } else if (g_strcmp0 (setting, "cpuset-topapp") == 0) {
+        processes_cpuset_set_topapp (
+            self->priv->processes, matcher_new_from_variant (inner_value)
+        );
+    } else if (g_strcmp0 (setting, "pressure-background-threshold") == 0) {
+        pressure_set_threshold (
+            self->priv->pressure,
+            PRESSURE_BACKGROUND,
+            g_variant_get_uint32 (inner_value)
+        );
+    } else if (g_strcmp0 (setting, "pressure-cpu-threshold") == 0) {
+        pressure_set_threshold (
+            self->priv->pressure,
+            PRESSURE_CPU,
+            g_variant_get_uint32 (inner_value)
+        );
+    } else if (g_strcmp0 (setting, "pressure-memory-threshold") == 0) {
+        pressure_set_threshold (
+            self->priv->pressure,
+            PRESSURE_MEMORY,
+            g_variant_get_uint32 (inner_value)
+        );
+    } else if (g_strcmp0 (setting, "pressure-io-threshold") == 0) {
+        pressure_set_threshold (
+            self->priv->pressure,
+            PRESSURE_IO,
+            g_variant_get_uint32 (inner_value)
+        );
+    } else if (g_strcmp0 (setting, "doze-io-weight") == 0) {
+        throttle_set_limit (
+            self->priv->throttle,
+            THROTTLE_WEIGHT,
+            g_variant_get_uint32 (inner_value)
+        );
+    } else if (g_strcmp0 (setting, "doze-io-max-iops") == 0) {
+        throttle_set_limit (
+            self->priv->throttle,
+            THROTTLE_IOPS,
+            g_variant_get_uint32 (inner_value)
+        );
+    } else if (g_strcmp0 (setting, "doze-io-max-bandwidth") == 0) {
+        throttle_set_limit (
+            self->priv->throttle,
+            THROTTLE_BANDWIDTH,
+            g_variant_get_uint32 (inner_value)
+        );
+    } else if (g_strcmp0 (setting, "irq-affinity-blacklist") == 0) {
+        interrupts_set_blacklist (
+            self->priv->interrupts, matcher_new_from_variant (inner_value)
+        );
+    } else if (g_strcmp0 (setting, "kernel-settings-screen-on") == 0) {
+        kernel_settings_set_screen_on_values (
+            self->priv->kernel_settings, inner_value
+        );
     } else if (g_strcmp0 (setting, "little-cluster-powersave") == 0) {
         gboolean enabled = g_variant_get_boolean (inner_value);
 
-        cpufreq_set_powersave (self->priv->cpufreq, TRUE, enabled);
+        cpufreq_set_little_powersave (self->priv->cpufreq, enabled);
+    } else if (g_strcmp0 (setting, "core-parking") == 0) {
+        const char *mode = g_variant_get_string (inner_value, NULL);
+
+        HotplugMode hotplug_mode = HOTPLUG_MODE_NONE;
+
+        if (g_strcmp0 (mode, "cores") == 0)
+            hotplug_mode = HOTPLUG_MODE_CORES;
+        else if (g_strcmp0 (mode, "smt") == 0)
+            hotplug_mode = HOTPLUG_MODE_SMT;
+
+        /* Legacy cpusets would lose offlined cpus for good */
+        if (hotplug_mode != HOTPLUG_MODE_NONE &&
+                !processes_is_hotplug_safe (self->priv->processes)) {
+            g_warning ("Can't park cores: cpuset not in v2 mode");
+            hotplug_mode = HOTPLUG_MODE_NONE;
+        }
+
+        cpufreq_set_core_parking (self->priv->cpufreq, hotplug_mode);
+    } else if (g_strcmp0 (setting, "doze-level") == 0) {
+        DozeLevel doze_level = g_variant_get_uint32 (inner_value);
+
+        if (self->priv->screen_off_power_saving) {
+            cpufreq_set_doze_level (self->priv->cpufreq, doze_level);
+            devfreq_set_doze_level (self->priv->devfreq, doze_level);
+        }
     } else if (g_strcmp0 (setting, "radio-power-saving") == 0) {
         self->priv->radio_power_saving = g_variant_get_boolean (inner_value);
     } else if (g_strcmp0 (setting, "dozing") == 0) {
         gboolean dozing = g_variant_get_boolean (inner_value);
 
-        if (self->priv->suspend_services) {
-            GList *blacklist = g_list_copy_deep (
-                self->priv->suspend_system_services_blacklist,
-                (GCopyFunc) g_strdup,
-                NULL
-            );
-            const char *service;
-
-            GFOREACH (self->priv->suspend_bluetooth_services, service) {
-                blacklist = g_list_prepend (blacklist, g_strdup (service));
-            }
+        /* Doze owns suspended processes from now on */
+        self->priv->dozing = dozing;
+        self->priv->pressure_suspended = FALSE;
 
+        if (self->priv->suspend_services) {
             if (dozing) {
                 services_freeze_all (
                     self->priv->services,
-                    blacklist
+                    self->priv->suspend_services_blacklist
                 );
                 if (self->priv->suspend_bluetooth) {
                     services_freeze (
@@ -248,34 +570,32 @@ on_bus_setting_changed (Bus      *bus,
             } else {
                 services_unfreeze_all (
                     self->priv->services,
-                    blacklist
+                    self->priv->suspend_services_blacklist
                 );
                 services_unfreeze (
                     self->priv->services,
                     self->priv->suspend_bluetooth_services
                 );
             }
-
-            g_list_free_full (blacklist, g_free);
         }
 
         if (dozing) {
-            processes_suspend (
-                self->priv->processes,
-                self->priv->suspend_processes
+            processes_update (self->priv->processes);
+            processes_suspend (self->priv->processes);
+            throttle_cgroups (
+                self->priv->throttle,
+                cgroups_get_default (G_BUS_TYPE_SYSTEM),
+                self->priv->suspend_services_blacklist
             );
+            /* User services are throttled by the user daemon */
         } else {
-            processes_resume (
-                self->priv->processes,
-                self->priv->suspend_processes
-            );
+            processes_resume (self->priv->processes);
+            throttle_restore (self->priv->throttle);
         }
     } else if (g_strcmp0 (setting, "suspend-processes") == 0) {
-        g_list_free_full (
-            self->priv->suspend_processes, g_free
-        );
-        self->priv->suspend_processes = get_list_from_variant (
-            inner_value
+        processes_set_suspended (
+            self->priv->processes,
+            matcher_new_from_variant (inner_value)
         );
     } else if (g_strcmp0 (setting, "suspend-bluetooth-services") == 0) {
         g_list_free_full (
@@ -284,6 +604,7 @@ on_bus_setting_changed (Bus      *bus,
         self->priv->suspend_bluetooth_services = get_list_from_variant (
             inner_value
         );
+        update_suspend_services_blacklist (self);
     } else if (g_strcmp0 (setting, "suspend-bluetooth") == 0) {
         self->priv->suspend_bluetooth = g_variant_get_boolean (inner_value);
     } else if (g_strcmp0 (setting, "suspend-services") == 0) {
@@ -291,36 +612,189 @@ on_bus_setting_changed (Bus      *bus,
     }
 }
 
+typedef struct {
+    Manager *manager;
+    GVariant *value;
+} Setting;
+
 static void
-manager_dispose (GObject *manager)
+setting_free (gpointer user_data)
 {
-    Manager *self = MANAGER (manager);
+    Setting *setting = user_data;
+
+    g_variant_unref (setting->value);
+    g_free (setting);
+}
+
+static void
+setting_apply (gpointer user_data)
+{
+    Setting *setting = user_data;
+
+    apply_setting (setting->manager, setting->value);
+}
+
+static void
+on_bus_setting_changed (Bus      *bus,
+                        GVariant *value,
+                        gpointer  user_data)
+{
+    Manager *self = MANAGER (user_data);
+    Setting *setting = g_new (Setting, 1);
 
-    on_screen_state_changed (
-        *logind_get_default (),
-        TRUE,
-        manager
+    setting->manager = self;
+    setting->value = g_variant_ref (value);
+
+    transitions_run (
+        self->priv->transitions, setting_apply, setting, setting_free
     );
+}
+
+static gboolean
+publish_pressure (gpointer user_data)
+{
+    bus_set_pressure (bus_get_default (), user_data);
+
+    return G_SOURCE_REMOVE;
+}
+
+static void
+on_pressure_readings_changed (Pressure *pressure,
+                              gpointer  user_data)
+{
+    GVariant *readings = g_variant_ref_sink (
+        pressure_get_readings (pressure)
+    );
+
+    /* Bus lives on main loop */
+    g_main_context_invoke_full (
+        NULL,
+        G_PRIORITY_DEFAULT,
+        publish_pressure,
+        readings,
+        (GDestroyNotify) g_variant_unref
+    );
+}
+
+static void
+on_pressure_changed (Pressure *pressure,
+                     guint     resource,
+                     gboolean  high,
+                     gpointer  user_data)
+{
+    Manager *self = MANAGER (user_data);
+
+    if (!self->priv->screen_off)
+        return;
+
+    switch (resource) {
+    case PRESSURE_BACKGROUND:
+        set_background_cpuset (self, get_background_cpuset (self));
+        break;
+    case PRESSURE_CPU:
+        /* Doze already suspends them */
+        if (self->priv->dozing)
+            break;
+
+        if (high && !self->priv->pressure_suspended) {
+            processes_update (self->priv->processes);
+            processes_suspend (self->priv->processes);
+            self->priv->pressure_suspended = TRUE;
+        } else if (!high && self->priv->pressure_suspended) {
+            processes_resume (self->priv->processes);
+            self->priv->pressure_suspended = FALSE;
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+static void
+setup (gpointer user_data)
+{
+    Manager *self = MANAGER (user_data);
+
+    self->priv->cpufreq = CPUFREQ (cpufreq_new ());
+    self->priv->devfreq = DEVFREQ (devfreq_new ());
+    self->priv->interrupts = INTERRUPTS (interrupts_new ());
+    self->priv->kernel_settings = KERNEL_SETTINGS (kernel_settings_new ());
+    self->priv->pressure = PRESSURE (pressure_new ());
+    self->priv->processes = PROCESSES (processes_new ());
+    self->priv->services = SERVICES (services_new (G_BUS_TYPE_SYSTEM));
+    self->priv->throttle = THROTTLE (throttle_new (G_BUS_TYPE_SYSTEM));
+#ifdef WIFI_ENABLED
+    self->priv->wifi = WIFI (wifi_new ());
+#endif
+
+    g_signal_connect (
+        self->priv->pressure,
+        "pressure-changed",
+        G_CALLBACK (on_pressure_changed),
+        self
+    );
+    g_signal_connect (
+        self->priv->pressure,
+        "readings-changed",
+        G_CALLBACK (on_pressure_readings_changed),
+        self
+    );
+
+    update_cpuset_layout (self);
+    on_pressure_readings_changed (self->priv->pressure, self);
+
+    /* Devices are probed, next start can skip it */
+    capabilities_save (capabilities_get_default ());
+}
+
+static void
+teardown (gpointer user_data)
+{
+    Manager *self = MANAGER (user_data);
+
+    g_clear_object (&self->priv->pressure);
+    restore_screen_on (self);
 
     services_unfreeze_all (
         self->priv->services,
-        self->priv->suspend_system_services_blacklist
+        self->priv->suspend_services_blacklist
     );
     services_unfreeze (
         self->priv->services,
         self->priv->suspend_bluetooth_services
     );
 
+#ifdef WIFI_ENABLED
     wifi_set_powersave (self->priv->wifi, FALSE);
+#endif
 
     g_clear_object (&self->priv->cpufreq);
     g_clear_object (&self->priv->devfreq);
+    g_clear_object (&self->priv->interrupts);
     g_clear_object (&self->priv->kernel_settings);
     g_clear_object (&self->priv->processes);
     g_clear_object (&self->priv->services);
+    g_clear_object (&self->priv->throttle);
 #ifdef WIFI_ENABLED
     g_clear_object (&self->priv->wifi);
 #endif
+}
+
+static void
+manager_dispose (GObject *manager)
+{
+    Manager *self = MANAGER (manager);
+
+    g_clear_handle_id (&self->priv->deferred_id, g_source_remove);
+
+    if (self->priv->transitions != NULL) {
+        g_signal_handlers_disconnect_by_data (logind_get_default (), self);
+        g_signal_handlers_disconnect_by_data (bus_get_default (), self);
+
+        /* Restore everything on worker, then stop it */
+        transitions_run_sync (self->priv->transitions, teardown, self);
+        g_clear_object (&self->priv->transitions);
+    }
 
     G_OBJECT_CLASS (manager_parent_class)->dispose (manager);
 }
@@ -330,12 +804,8 @@ manager_finalize (GObject *manager)
 {
     Manager *self = MANAGER (manager);
 
-    g_list_free_full (
-        self->priv->suspend_processes, g_free
-    );
-    g_list_free_full (
-        self->priv->cpuset_background_processes, g_free
-    );
+    matcher_free (self->priv->cpuset_background_processes);
+    matcher_free (self->priv->suspend_services_blacklist);
     g_list_free_full (
         self->priv->suspend_system_services_blacklist, g_free
     );
@@ -343,10 +813,6 @@ manager_finalize (GObject *manager)
         self->priv->suspend_bluetooth_services, g_free
     );
 
-    if (self->priv->cgroups_user_dir != NULL) {
-        g_free (self->priv->cgroups_user_dir);
-    }
-
     G_OBJECT_CLASS (manager_parent_class)->finalize (manager);
 }
 
@@ -365,25 +831,25 @@ manager_init (Manager *self)
 {
     self->priv = manager_get_instance_private (self);
 
-    self->priv->cpufreq = CPUFREQ (cpufreq_new ());
-    self->priv->devfreq = DEVFREQ (devfreq_new ());
-    self->priv->kernel_settings = KERNEL_SETTINGS (kernel_settings_new ());
-    self->priv->processes = PROCESSES (processes_new ());
-    self->priv->services = SERVICES (services_new (G_BUS_TYPE_SYSTEM));
-#ifdef WIFI_ENABLED
-    self->priv->wifi = WIFI (wifi_new ());
-#endif
+    self->priv->transitions = TRANSITIONS (transitions_new ());
 
+    self->priv->screen_off = FALSE;
+    self->priv->dozing = FALSE;
+    self->priv->pressure_suspended = FALSE;
     self->priv->screen_off_power_saving = TRUE;
     self->priv->suspend_services = FALSE;
     self->priv->suspend_bluetooth = FALSE;
 
     self->priv->radio_power_saving = FALSE;
-    self->priv->suspend_processes = NULL;
-    self->priv->cgroups_user_dir = NULL;
+    self->priv->deferred_id = 0;
     self->priv->suspend_system_services_blacklist = NULL;
-    self->priv->cpuset_background_processes = NULL;
+    self->priv->cpuset_background_processes = matcher_new ();
     self->priv->suspend_bluetooth_services = NULL;
+    self->priv->suspend_services_blacklist = NULL;
+    update_suspend_services_blacklist (self);
+
+    /* Devices live on worker, main loop only handles D-Bus */
+    transitions_run_sync (self->priv->transitions, setup, self);
 
     g_signal_connect (
         logind_get_default (),
@@ -0,0 +1,864 @@
+/*
+ * Copyright Cedric Bellegarde <cedric.bellegarde@adishatz.org>
+ */
+
+#include <errno.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mount.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#include "config.h"
+#include "placement.h"
+#include "topology.h"
+#include "../common/cgroups.h"
+#include "../common/units.h"
+#include "../common/utils.h"
+
+/*
+ * Where tasks run, from cheapest to most expensive backend:
+ * - cgroup v2 cpuset controller: one AllowedCPUs= per service, set
+ *   through systemd which owns unit cgroups, whatever the processes
+ *   and threads count
+ * - Android cpuset (v1): one cgroup.procs write per process, all its
+ *   threads follow
+ * - sched_setaffinity(): one syscall per thread, for kernels without
+ *   any cpuset
+ *
+ * With cgroup v2 cpu controller, services can be made idle, through
+ * systemd too: it enables the cpu controller where needed and would
+ * undo our writes. With uclamp, cgroups are also clamped, systemd has
+ * no property for it: background work runs at low OPP, top-app gets a
+ * minimum boost. Processes listed for background, not services, are
+ * SCHED_IDLE. Their timer slack is raised, so their wakeups coalesce,
+ * as for background services with cgroup v2, telephony and bus ones
+ * excepted. Their own slack is given back after. User services are not slacked: the user daemon
+ * lacks CAP_SYS_NICE and systemd TimerSlackNSec= only applies on exec.
+ */
+
+/* Only exposed by glibc with _GNU_SOURCE */
+#ifndef SCHED_IDLE
+#define SCHED_IDLE 5
+#endif
+
+#define PLACEMENT_MAX_CPUS 1024
+#define PLACEMENT_MASK_LENGTH (PLACEMENT_MAX_CPUS / (8 * sizeof (gulong)))
+#define PLACEMENT_MASK_BITS (8 * sizeof (gulong))
+
+struct _PlacementPrivate {
+    PlacementBackend backends;
+    Units *units;
+    /* Offlined cpus come back in cpusets once online */
+    gboolean hotplug_safe;
+
+    char *cpus[CPUSET_LAST];
+    gulong masks[CPUSET_LAST][PLACEMENT_MASK_LENGTH];
+
+    PowerProfile power_profile;
+    /* cgroup dir -> CpuSet, clamps follow power profile */
+    GHashTable *clamped;
+    /* pid -> struct SlackedTask, with a raised timer slack */
+    GHashTable *slacked;
+};
+
+/* Pids are reused: a task is its pid and start time */
+struct SlackedTask {
+    guint64 start_time;
+    /* Own timer slack, given back */
+    char *timer_slack;
+};
+
+G_DEFINE_TYPE_WITH_CODE (
+    Placement,
+    placement,
+    G_TYPE_OBJECT,
+    G_ADD_PRIVATE (Placement)
+)
+
+/* Android cpusets, extra ones follow a main cpuset layout */
+static const struct {
+    const char *name;
+    CpuSet cpuset;
+} android_cpusets[] = {
+    { "background", CPUSET_BACKGROUND },
+    { "system-background", CPUSET_SYSTEM_BACKGROUND },
+    { "foreground", CPUSET_FOREGROUND },
+    { "top-app", CPUSET_TOPAPP },
+    { "camera-daemon", CPUSET_TOPAPP }
+};
+
+/* cpu.uclamp.min, cpu.uclamp.max: percent of max capacity */
+static const struct {
+    const char *min;
+    const char *max;
+} clamps[POWER_PROFILE_LAST][CPUSET_LAST] = {
+    [POWER_PROFILE_POWER_SAVER] = {
+        [CPUSET_BACKGROUND] = { "0", "20" },
+        [CPUSET_SYSTEM_BACKGROUND] = { "0", "30" },
+        [CPUSET_FOREGROUND] = { "0", "max" },
+        [CPUSET_TOPAPP] = { "0", "max" }
+    },
+    [POWER_PROFILE_BALANCED] = {
+        [CPUSET_BACKGROUND] = { "0", "30" },
+        [CPUSET_SYSTEM_BACKGROUND] = { "0", "50" },
+        [CPUSET_FOREGROUND] = { "0", "max" },
+        [CPUSET_TOPAPP] = { "10", "max" }
+    },
+    [POWER_PROFILE_PERFORMANCE] = {
+        [CPUSET_BACKGROUND] = { "0", "50" },
+        [CPUSET_SYSTEM_BACKGROUND] = { "0", "80" },
+        [CPUSET_FOREGROUND] = { "0", "max" },
+        [CPUSET_TOPAPP] = { "30", "max" }
+    }
+};
+
+/* Background tasks timer slack, in ns (default is 50us) */
+static const char *timer_slacks[POWER_PROFILE_LAST] = {
+    [POWER_PROFILE_POWER_SAVER] = "100000000",
+    [POWER_PROFILE_BALANCED] = "20000000",
+    [POWER_PROFILE_PERFORMANCE] = "5000000"
+};
+
+static const char *
+get_cpuset_name (CpuSet cpuset)
+{
+    switch (cpuset) {
+    case CPUSET_BACKGROUND:
+        return "background";
+    case CPUSET_SYSTEM_BACKGROUND:
+        return "system-background";
+    case CPUSET_FOREGROUND:
+        return "foreground";
+    case CPUSET_TOPAPP:
+    default:
+        return "top-app";
+    }
+}
+
+static char *
+get_cpuset_file (CpuSet      cpuset,
+                 const char *filename)
+{
+    g_autofree char *path = g_build_filename (
+        "/dev/cpuset", get_cpuset_name (cpuset), filename, NULL
+    );
+
+    return get_root_path (path);
+}
+
+static void
+parse_cpu_list (const char *cpus,
+                gulong     *mask)
+{
+    const char *cpu = cpus;
+
+    memset (mask, 0, PLACEMENT_MASK_LENGTH * sizeof (gulong));
+
+    /* 0-3,6,8-9 */
+    while (cpu != NULL && *cpu != '\0') {
+        char *end;
+        gulong first = strtoul (cpu, &end, 10);
+        gulong last = first;
+        gulong i;
+
+        if (end == cpu)
+            break;
+        if (*end == '-')
+            last = strtoul (end + 1, &end, 10);
+
+        for (i = first; i <= last && i < PLACEMENT_MAX_CPUS; i++)
+            mask[i / PLACEMENT_MASK_BITS] |= 1UL << (i % PLACEMENT_MASK_BITS);
+
+        cpu = *end == ',' ? end + 1 : NULL;
+    }
+}
+
+static gboolean
+file_has_word (const char *path,
+               const char *word)
+{
+    g_autofree char *contents = NULL;
+    g_autofree char *words = NULL;
+    g_autofree char *padded_word = NULL;
+
+    if (!g_file_get_contents (path, &contents, NULL, NULL))
+        return FALSE;
+
+    /* "cpuset cpu io\n" -> " cpuset cpu io " */
+    words = g_strdup_printf (" %s ", g_strdelimit (contents, "\n", ' '));
+    padded_word = g_strdup_printf (" %s ", word);
+
+    return strstr (words, padded_word) != NULL;
+}
+
+static gboolean
+set_affinity (Placement *self,
+              pid_t      pid,
+              CpuSet     cpuset)
+{
+    g_autofree char *proc_task = g_strdup_printf ("/proc/%d/task", pid);
+    g_autoptr (GDir) dir = g_dir_open (proc_task, 0, NULL);
+    const char *tid;
+
+    if (dir == NULL)
+        return FALSE;
+
+    /* Affinity is per thread */
+    while ((tid = g_dir_read_name (dir)) != NULL)
+        syscall (
+            SYS_sched_setaffinity,
+            atoi (tid),
+            sizeof (self->priv->masks[cpuset]),
+            self->priv->masks[cpuset]
+        );
+
+    return TRUE;
+}
+
+static void
+set_idle (pid_t    pid,
+          gboolean idle)
+{
+    g_autofree char *proc_task = g_strdup_printf ("/proc/%d/task", pid);
+    g_autoptr (GDir) dir = g_dir_open (proc_task, 0, NULL);
+    struct sched_param param = { 0 };
+    const char *tid;
+
+    if (dir == NULL)
+        return;
+
+    /* Policy is per thread, leave realtime and batch ones alone */
+    while ((tid = g_dir_read_name (dir)) != NULL) {
+        pid_t thread = atoi (tid);
+        gint policy = sched_getscheduler (thread);
+
+        if (idle && policy == SCHED_OTHER)
+            sched_setscheduler (thread, SCHED_IDLE, &param);
+        else if (!idle && policy == SCHED_IDLE)
+            sched_setscheduler (thread, SCHED_OTHER, &param);
+    }
+}
+
+static void
+slacked_task_free (gpointer data)
+{
+    struct SlackedTask *task = data;
+
+    g_free (task->timer_slack);
+    g_free (task);
+}
+
+static guint64
+get_start_time (pid_t pid)
+{
+    g_autofree char *proc_stat = g_strdup_printf ("/proc/%d/stat", pid);
+    g_autofree char *contents = NULL;
+    guint64 start_time;
+    char *fields;
+
+    if (!g_file_get_contents (proc_stat, &contents, NULL, NULL))
+        return 0;
+
+    /* pid (comm) state ... starttime is field 22, comm may contain ')' */
+    fields = strrchr (contents, ')');
+    if (fields == NULL || sscanf (
+            fields + 1,
+            " %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %*u %*u"
+            " %*d %*d %*d %*d %*d %*d %" G_GUINT64_FORMAT,
+            &start_time) != 1)
+        return 0;
+
+    return start_time;
+}
+
+static void
+add_timer_slack (Placement   *self,
+                 WriterBatch *batch,
+                 pid_t        pid,
+                 CpuSet       cpuset)
+{
+    /* Main thread only, new threads inherit it */
+    g_autofree char *timerslack_ns = g_strdup_printf (
+        "/proc/%d/timerslack_ns", pid
+    );
+    struct SlackedTask *task = g_hash_table_lookup (
+        self->priv->slacked, GINT_TO_POINTER (pid)
+    );
+    guint64 start_time = get_start_time (pid);
+
+    /* Our task exited, pid was reused */
+    if (task != NULL && task->start_time != start_time) {
+        g_hash_table_remove (self->priv->slacked, GINT_TO_POINTER (pid));
+        task = NULL;
+    }
+
+    if (cpuset == CPUSET_BACKGROUND) {
+        /* Tasks may set their own slack: save it first */
+        if (task == NULL) {
+            g_autofree char *timer_slack = NULL;
+
+            if (start_time == 0 || !g_file_get_contents (
+                    timerslack_ns, &timer_slack, NULL, NULL))
+                return;
+
+            task = g_new (struct SlackedTask, 1);
+            task->start_time = start_time;
+            task->timer_slack = g_strstrip (g_steal_pointer (&timer_slack));
+            g_hash_table_insert (
+                self->priv->slacked, GINT_TO_POINTER (pid), task
+            );
+        }
+        writer_batch_add (
+            batch, timerslack_ns, timer_slacks[self->priv->power_profile]
+        );
+    } else if (task != NULL) {
+        writer_batch_add (batch, timerslack_ns, task->timer_slack);
+        g_hash_table_remove (self->priv->slacked, GINT_TO_POINTER (pid));
+    }
+}
+
+static void
+add_clamps (Placement   *self,
+            WriterBatch *batch,
+            const char  *cgroup_dir,
+            CpuSet       cpuset)
+{
+    g_autofree char *uclamp_min = g_build_filename (
+        cgroup_dir, "cpu.uclamp.min", NULL
+    );
+    g_autofree char *uclamp_max = g_build_filename (
+        cgroup_dir, "cpu.uclamp.max", NULL
+    );
+
+    writer_batch_add (
+        batch, uclamp_min, clamps[self->priv->power_profile][cpuset].min
+    );
+    writer_batch_add (
+        batch, uclamp_max, clamps[self->priv->power_profile][cpuset].max
+    );
+}
+
+static void
+add_to_cpuset (Placement   *self,
+               WriterBatch *batch,
+               pid_t        pid,
+               CpuSet       cpuset)
+{
+    if (self->priv->backends & PLACEMENT_BACKEND_CPUSET) {
+        g_autofree char *cgroup_procs = get_cpuset_file (
+            cpuset, "cgroup.procs"
+        );
+        g_autofree char *pid_str = g_strdup_printf ("%d", pid);
+
+        writer_batch_add (batch, cgroup_procs, pid_str);
+    } else if (self->priv->backends & PLACEMENT_BACKEND_AFFINITY) {
+        set_affinity (self, pid, cpuset);
+    }
+}
+
+static void
+detect_backends (Placement *self)
+{
+    g_autofree char *controllers = get_root_path (
+        CGROUPS_DIR "/cgroup.controllers"
+    );
+    g_autofree char *cpuset_procs = get_cpuset_file (
+        CPUSET_TOPAPP, "cgroup.procs"
+    );
+    g_autofree char *util_clamp = get_root_path (
+        "/proc/sys/kernel/sched_util_clamp_max"
+    );
+
+    if (file_has_word (controllers, "cpuset"))
+        self->priv->backends |= PLACEMENT_BACKEND_CGROUP2;
+
+    if (file_has_word (controllers, "cpu")) {
+        self->priv->backends |= PLACEMENT_BACKEND_CPU;
+
+        /* CONFIG_UCLAMP_TASK_GROUP */
+        if (g_file_test (util_clamp, G_FILE_TEST_EXISTS))
+            self->priv->backends |= PLACEMENT_BACKEND_UCLAMP;
+    }
+
+    if (g_file_test (cpuset_procs, G_FILE_TEST_EXISTS))
+        self->priv->backends |= PLACEMENT_BACKEND_CPUSET;
+
+    /* Relocated pids are not real processes */
+    if (get_root_dir () == NULL)
+        self->priv->backends |= PLACEMENT_BACKEND_AFFINITY;
+
+    g_message (
+        "Placement backends:%s%s%s%s%s",
+        self->priv->backends & PLACEMENT_BACKEND_CGROUP2 ? " cgroup2" : "",
+        self->priv->backends & PLACEMENT_BACKEND_CPUSET ? " cpuset" : "",
+        self->priv->backends & PLACEMENT_BACKEND_AFFINITY ? " affinity" : "",
+        self->priv->backends & PLACEMENT_BACKEND_CPU ? " cpu" : "",
+        self->priv->backends & PLACEMENT_BACKEND_UCLAMP ? " uclamp" : ""
+    );
+}
+
+#ifdef CPUSET_ENABLED
+static gboolean
+has_cpuset_v2_mode (void)
+{
+    g_autofree char *contents = NULL;
+    char *line;
+    char *saveptr;
+
+    if (!g_file_get_contents ("/proc/self/mounts", &contents, NULL, NULL))
+        return FALSE;
+
+    /* none /dev/cpuset cgroup rw,nosuid,cpuset,cpuset_v2_mode 0 0 */
+    for (line = strtok_r (contents, "\n", &saveptr);
+            line != NULL;
+            line = strtok_r (NULL, "\n", &saveptr)) {
+        g_auto (GStrv) fields = g_strsplit (line, " ", 5);
+
+        if (g_strv_length (fields) < 4 ||
+                g_strcmp0 (fields[1], "/dev/cpuset") != 0)
+            continue;
+
+        return strstr (fields[3], "cpuset_v2_mode") != NULL;
+    }
+
+    return FALSE;
+}
+#endif
+
+static void
+setup_cpusets (Placement *self)
+{
+#ifdef CPUSET_ENABLED
+    g_autofree char *cpuset_dir = get_root_path ("/dev/cpuset");
+    g_autofree char *root_mems = g_build_filename (cpuset_dir, "mems", NULL);
+    g_autofree char *mems = NULL;
+    guint i;
+
+    /* Relocated trees come with their cpusets */
+    if (!g_file_test (root_mems, G_FILE_TEST_EXISTS) &&
+            get_root_dir () == NULL) {
+        g_mkdir_with_parents (cpuset_dir, 0755);
+        /*
+         * Without v2 mode, offlined cpus are removed from cpusets for
+         * good: never fall back to a legacy mount
+         */
+        if (mount ("none", cpuset_dir, "cpuset",
+                   MS_NODEV | MS_NOEXEC | MS_NOSUID, "cpuset_v2_mode") != 0)
+            g_warning ("Can't mount cpuset: %s", g_strerror (errno));
+    }
+
+    if (!g_file_get_contents (root_mems, &mems, NULL, NULL))
+        return;
+    g_strstrip (mems);
+
+    /* Mounted by vendor init, maybe without v2 mode */
+    self->priv->hotplug_safe = get_root_dir () != NULL ||
+        has_cpuset_v2_mode ();
+    if (!self->priv->hotplug_safe)
+        g_message ("/dev/cpuset not in v2 mode, core parking disabled");
+
+    /* Tasks can't join a cpuset without memory nodes */
+    for (i = 0; i < G_N_ELEMENTS (android_cpusets); i++) {
+        g_autofree char *dir = g_build_filename (
+            cpuset_dir, android_cpusets[i].name, NULL
+        );
+        g_autofree char *cpuset_mems = g_build_filename (dir, "mems", NULL);
+
+        if (g_mkdir_with_parents (dir, 0755) != 0) {
+            g_warning ("Can't create %s: %s", dir, g_strerror (errno));
+            continue;
+        }
+        writer_write (writer_get_default (), cpuset_mems, mems);
+    }
+#endif
+}
+
+static void
+write_cpuset_cpus (Placement *self,
+                   CpuSet     cpuset)
+{
+    guint i;
+
+    if (!(self->priv->backends & PLACEMENT_BACKEND_CPUSET))
+        return;
+
+    for (i = 0; i < G_N_ELEMENTS (android_cpusets); i++) {
+        g_autofree char *path = NULL;
+        g_autofree char *cpus = NULL;
+
+        if (android_cpusets[i].cpuset != cpuset)
+            continue;
+
+        cpus = g_build_filename (
+            "/dev/cpuset", android_cpusets[i].name, "cpus", NULL
+        );
+        path = get_root_path (cpus);
+        writer_write (writer_get_default (), path, self->priv->cpus[cpuset]);
+    }
+}
+
+static void
+placement_dispose (GObject *placement)
+{
+    Placement *self = PLACEMENT (placement);
+
+    g_clear_object (&self->priv->units);
+
+    G_OBJECT_CLASS (placement_parent_class)->dispose (placement);
+}
+
+static void
+placement_finalize (GObject *placement)
+{
+    Placement *self = PLACEMENT (placement);
+    CpuSet cpuset;
+
+    for (cpuset = 0; cpuset < CPUSET_LAST; cpuset++)
+        g_free (self->priv->cpus[cpuset]);
+    g_hash_table_destroy (self->priv->clamped);
+    g_hash_table_destroy (self->priv->slacked);
+
+    G_OBJECT_CLASS (placement_parent_class)->finalize (placement);
+}
+
+static void
+placement_class_init (PlacementClass *klass)
+{
+    GObjectClass *object_class;
+
+    object_class = G_OBJECT_CLASS (klass);
+    object_class->dispose = placement_dispose;
+    object_class->finalize = placement_finalize;
+}
+
+static void
+placement_init (Placement *self)
+{
+    self->priv = placement_get_instance_private (self);
+
+    self->priv->backends = PLACEMENT_BACKEND_NONE;
+    self->priv->units = g_object_ref (units_get_default (G_BUS_TYPE_SYSTEM));
+    self->priv->hotplug_safe = TRUE;
+    memset (self->priv->cpus, 0, sizeof (self->priv->cpus));
+    self->priv->power_profile = POWER_PROFILE_BALANCED;
+    self->priv->clamped = g_hash_table_new_full (
+        g_str_hash, g_str_equal, g_free, NULL
+    );
+    self->priv->slacked = g_hash_table_new_full (
+        NULL, NULL, NULL, slacked_task_free
+    );
+
+    setup_cpusets (self);
+    detect_backends (self);
+    placement_set_layout (self, NULL);
+}
+
+/**
+ * placement_new:
+ *
+ * Creates a new #Placement
+ *
+ * Returns: (transfer full): a new #Placement
+ *
+ **/
+GObject *
+placement_new (void)
+{
+    GObject *placement;
+
+    placement = g_object_new (TYPE_PLACEMENT, NULL);
+
+    return placement;
+}
+
+/**
+ * placement_get_backends:
+ *
+ * Get backends available on this system
+ *
+ * @self: a #Placement
+ *
+ * Returns: #PlacementBackend flags
+ */
+PlacementBackend
+placement_get_backends (Placement *self)
+{
+    return self->priv->backends;
+}
+
+/**
+ * placement_is_hotplug_safe:
+ *
+ * Check cpus put offline come back in cpusets once online. Legacy
+ * cpuset mounts drop them for good.
+ *
+ * @self: a #Placement
+ *
+ * Returns: TRUE if cores can be parked
+ */
+gboolean
+placement_is_hotplug_safe (Placement *self)
+{
+    return self->priv->hotplug_safe;
+}
+
+/**
+ * placement_set_cpus:
+ *
+ * Set cpus used by a cpuset
+ *
+ * @self: a #Placement
+ * @cpuset: a #CpuSet
+ * @cpus: cpus list, like 0-3,6
+ */
+void
+placement_set_cpus (Placement  *self,
+                    CpuSet      cpuset,
+                    const char *cpus)
+{
+    if (g_strcmp0 (self->priv->cpus[cpuset], cpus) == 0)
+        return;
+
+    g_free (self->priv->cpus[cpuset]);
+    self->priv->cpus[cpuset] = g_strdup (cpus);
+
+    parse_cpu_list (cpus, self->priv->masks[cpuset]);
+    write_cpuset_cpus (self, cpuset);
+}
+
+/**
+ * placement_set_layout:
+ *
+ * Size cpusets for CPU topology, some may be overridden
+ *
+ * @self: a #Placement
+ * @layout: (nullable): cpus by cpuset name, as a{ss}
+ */
+void
+placement_set_layout (Placement *self,
+                      GVariant  *layout)
+{
+    Topology *topology = topology_get_default ();
+    CpuSet cpuset;
+
+    for (cpuset = 0; cpuset < CPUSET_LAST; cpuset++) {
+        g_autofree char *cpus = NULL;
+
+        if (layout == NULL ||
+                !g_variant_lookup (layout, get_cpuset_name (cpuset), "s", &cpus))
+            cpus = topology_get_cpuset_cpus (topology, cpuset);
+
+        placement_set_cpus (self, cpuset, cpus);
+    }
+}
+
+/**
+ * placement_get_layout:
+ *
+ * Get cpus used by cpusets
+ *
+ * @self: a #Placement
+ *
+ * Returns: (transfer floating): cpus by cpuset name, as a{ss}
+ */
+GVariant *
+placement_get_layout (Placement *self)
+{
+    GVariantBuilder builder;
+    CpuSet cpuset;
+
+    g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{ss}"));
+    for (cpuset = 0; cpuset < CPUSET_LAST; cpuset++)
+        g_variant_builder_add (
+            &builder, "{ss}", get_cpuset_name (cpuset), self->priv->cpus[cpuset]
+        );
+
+    return g_variant_builder_end (&builder);
+}
+
+/**
+ * placement_set_power_profile:
+ *
+ * Set power profile, clamped cgroups and slacked processes are updated
+ *
+ * @self: a #Placement
+ * @power_profile: a #PowerProfile
+ */
+void
+placement_set_power_profile (Placement    *self,
+                             PowerProfile  power_profile)
+{
+    g_autoptr (WriterBatch) batch = NULL;
+    GHashTableIter iter;
+    gpointer key;
+    gpointer value;
+
+    g_return_if_fail (power_profile < POWER_PROFILE_LAST);
+
+    if (self->priv->power_profile == power_profile)
+        return;
+
+    self->priv->power_profile = power_profile;
+
+    batch = writer_batch_new ();
+    g_hash_table_iter_init (&iter, self->priv->clamped);
+    while (g_hash_table_iter_next (&iter, &key, &value)) {
+        /* Service stopped */
+        if (!g_file_test (key, G_FILE_TEST_IS_DIR)) {
+            g_hash_table_iter_remove (&iter);
+            continue;
+        }
+        add_clamps (self, batch, key, GPOINTER_TO_INT (value));
+    }
+
+    g_hash_table_iter_init (&iter, self->priv->slacked);
+    while (g_hash_table_iter_next (&iter, &key, &value)) {
+        struct SlackedTask *task = value;
+        g_autofree char *timerslack_ns = g_strdup_printf (
+            "/proc/%d/timerslack_ns", GPOINTER_TO_INT (key)
+        );
+
+        /* Process exited, pid may be reused */
+        if (get_start_time (GPOINTER_TO_INT (key)) != task->start_time) {
+            g_hash_table_iter_remove (&iter);
+            continue;
+        }
+        writer_batch_add (
+            batch, timerslack_ns, timer_slacks[power_profile]
+        );
+    }
+    writer_batch_submit (writer_get_default (), batch);
+}
+
+/**
+ * placement_get_cpus:
+ *
+ * Get cpus used by a cpuset
+ *
+ * @self: a #Placement
+ * @cpuset: a #CpuSet
+ *
+ * Returns: (transfer none): cpus list
+ */
+const char *
+placement_get_cpus (Placement *self,
+                    CpuSet     cpuset)
+{
+    return self->priv->cpus[cpuset];
+}
+
+/**
+ * placement_move_process:
+ *
+ * Move a process, with all its threads, to cpuset.
+ * Background processes are SCHED_IDLE, with a raised timer slack.
+ *
+ * @self: a #Placement
+ * @batch: a #WriterBatch, for writes to submit
+ * @pid: process id
+ * @cpuset: a #CpuSet
+ */
+void
+placement_move_process (Placement   *self,
+                        WriterBatch *batch,
+                        pid_t        pid,
+                        CpuSet       cpuset)
+{
+    add_to_cpuset (self, batch, pid, cpuset);
+
+    /* Relocated pids are not real processes */
+    if (get_root_dir () == NULL) {
+        set_idle (pid, cpuset == CPUSET_BACKGROUND);
+        add_timer_slack (self, batch, pid, cpuset);
+    }
+}
+
+/**
+ * placement_move_cgroup:
+ *
+ * Move all processes in cgroup to cpuset and clamp it
+ *
+ * @self: a #Placement
+ * @batch: a #WriterBatch, for writes to submit
+ * @cgroup_dir: service cgroup directory, named after its unit
+ * @cpuset: a #CpuSet
+ */
+void
+placement_move_cgroup (Placement   *self,
+                       WriterBatch *batch,
+                       const char  *cgroup_dir,
+                       CpuSet       cpuset)
+{
+    g_autofree char *unit = g_path_get_basename (cgroup_dir);
+    g_autofree char *cgroup_procs = NULL;
+    GList *pids;
+    pid_t *pid;
+
+    /* Files exist once systemd enabled cpu, missing ones are skipped */
+    if (self->priv->backends & PLACEMENT_BACKEND_UCLAMP) {
+        add_clamps (self, batch, cgroup_dir, cpuset);
+        g_hash_table_insert (
+            self->priv->clamped,
+            g_strdup (cgroup_dir),
+            GINT_TO_POINTER (cpuset)
+        );
+    }
+
+    cgroup_procs = g_build_filename (cgroup_dir, "cgroup.procs", NULL);
+
+    if (self->priv->backends & PLACEMENT_BACKEND_CGROUP2) {
+        /* systemd enables cpuset on ancestors and keeps it on reload */
+        units_set_allowed_cpus (
+            self->priv->units, unit, self->priv->cpus[cpuset]
+        );
+
+        /* Timer slack is per task: enumerate only when needed */
+        if (get_root_dir () != NULL || (cpuset != CPUSET_BACKGROUND &&
+                g_hash_table_size (self->priv->slacked) == 0))
+            return;
+
+        /* Calls and SMS must not wait on coalesced timers */
+        if (cpuset == CPUSET_BACKGROUND && units_is_cpu_idle_exempt (unit))
+            return;
+
+        pids = get_cgroup_pids (cgroup_procs);
+        GFOREACH (pids, pid)
+            add_timer_slack (self, batch, *pid, cpuset);
+        g_list_free_full (pids, g_free);
+        return;
+    }
+
+    /* Services are only moved: idle ones are an explicit list */
+    pids = get_cgroup_pids (cgroup_procs);
+    GFOREACH (pids, pid)
+        add_to_cpuset (self, batch, *pid, cpuset);
+    g_list_free_full (pids, g_free);
+}
+
+/**
+ * placement_set_cgroup_idle:
+ *
+ * Run service at idle cpu priority, against the other services of its
+ * slice, or give it back its own cpu weight
+ *
+ * @self: a #Placement
+ * @cgroup_dir: service cgroup directory, named after its unit
+ * @idle: TRUE to make service idle
+ */
+void
+placement_set_cgroup_idle (Placement  *self,
+                           const char *cgroup_dir,
+                           gboolean    idle)
+{
+    g_autofree char *unit = NULL;
+
+    if (!(self->priv->backends & PLACEMENT_BACKEND_CPU))
+        return;
+
+    unit = g_path_get_basename (cgroup_dir);
+    units_set_cpu_idle (self->priv->units, unit, idle);
+}
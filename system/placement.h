@@ -0,0 +1,86 @@
+/*
+ * Copyright Cedric Bellegarde <cedric.bellegarde@adishatz.org>
+ */
+
+#ifndef PLACEMENT_H
+#define PLACEMENT_H
+
+#include <sys/types.h>
+
+#include <glib.h>
+#include <glib-object.h>
+#include "../common/define.h"
+#include "../common/writer.h"
+
+#define TYPE_PLACEMENT \
+    (placement_get_type ())
+#define PLACEMENT(obj) \
+    (G_TYPE_CHECK_INSTANCE_CAST \
+    ((obj), TYPE_PLACEMENT, Placement))
+#define PLACEMENT_CLASS(cls) \
+    (G_TYPE_CHECK_CLASS_CAST \
+    ((cls), TYPE_PLACEMENT, PlacementClass))
+#define IS_PLACEMENT(obj) \
+    (G_TYPE_CHECK_INSTANCE_TYPE \
+    ((obj), TYPE_PLACEMENT))
+#define IS_PLACEMENT_CLASS(cls) \
+    (G_TYPE_CHECK_CLASS_TYPE \
+    ((cls), TYPE_PLACEMENT))
+#define PLACEMENT_GET_CLASS(obj) \
+    (G_TYPE_INSTANCE_GET_CLASS \
+    ((obj), TYPE_PLACEMENT, PlacementClass))
+
+G_BEGIN_DECLS
+
+typedef enum {
+    PLACEMENT_BACKEND_NONE     = 0,
+    PLACEMENT_BACKEND_CGROUP2  = 1 << 0,
+    PLACEMENT_BACKEND_CPUSET   = 1 << 1,
+    PLACEMENT_BACKEND_AFFINITY = 1 << 2,
+    PLACEMENT_BACKEND_UCLAMP   = 1 << 3,
+    PLACEMENT_BACKEND_CPU      = 1 << 4
+} PlacementBackend;
+
+typedef struct _Placement Placement;
+typedef struct _PlacementClass PlacementClass;
+typedef struct _PlacementPrivate PlacementPrivate;
+
+struct _Placement {
+    GObject parent;
+    PlacementPrivate *priv;
+};
+
+struct _PlacementClass {
+    GObjectClass parent_class;
+};
+
+GType            placement_get_type            (void) G_GNUC_CONST;
+
+GObject*         placement_new                 (void);
+PlacementBackend placement_get_backends        (Placement   *self);
+gboolean         placement_is_hotplug_safe     (Placement   *self);
+void             placement_set_cpus            (Placement   *self,
+                                                CpuSet       cpuset,
+                                                const char  *cpus);
+const char      *placement_get_cpus            (Placement   *self,
+                                                CpuSet       cpuset);
+void             placement_set_layout          (Placement   *self,
+                                                GVariant    *layout);
+GVariant        *placement_get_layout          (Placement   *self);
+void             placement_set_power_profile   (Placement   *self,
+                                                PowerProfile power_profile);
+void             placement_move_process        (Placement   *self,
+                                                WriterBatch *batch,
+                                                pid_t        pid,
+                                                CpuSet       cpuset);
+void             placement_move_cgroup         (Placement   *self,
+                                                WriterBatch *batch,
+                                                const char  *cgroup_dir,
+                                                CpuSet       cpuset);
+void             placement_set_cgroup_idle     (Placement   *self,
+                                                const char  *cgroup_dir,
+                                                gboolean     idle);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,428 @@
+/*
+ * Copyright Cedric Bellegarde <cedric.bellegarde@adishatz.org>
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <glib-unix.h>
+
+#include "pressure.h"
+#include "../common/define.h"
+#include "../common/utils.h"
+
+/* PSI trigger window, threshold is a percent of it */
+#define PRESSURE_WINDOW_US 1000000
+/* While high, check if pressure is back under half the threshold */
+#define PRESSURE_RELAX_INTERVAL 5
+
+/*
+ * Kernel wakes us when stall time goes over threshold in a window:
+ * nothing is read while pressure is low.
+ */
+
+/* signals */
+enum
+{
+    PRESSURE_CHANGED,
+    READINGS_CHANGED,
+    LAST_SIGNAL
+};
+
+static guint signals[LAST_SIGNAL];
+
+typedef struct {
+    const char *name;
+    const char *path;
+    const char *line;
+} PressureFile;
+
+static const PressureFile pressure_files[PRESSURE_LAST] = {
+    { "cpu", "/proc/pressure/cpu", "some" },
+    { "memory", "/proc/pressure/memory", "full" },
+    { "io", "/proc/pressure/io", "full" },
+    /* System services are moved to background cpuset on screen off */
+    { "background", CGROUPS_SYSTEM_SERVICES_DIR "/cpu.pressure", "some" }
+};
+
+typedef struct {
+    Pressure *pressure;
+    PressureResource resource;
+
+    guint threshold;
+    gint fd;
+    GSource *source;
+    gboolean high;
+    gdouble average;
+} Monitor;
+
+struct _PressurePrivate {
+    Monitor monitors[PRESSURE_LAST];
+    GSource *relax_source;
+};
+
+G_DEFINE_TYPE_WITH_CODE (
+    Pressure,
+    pressure,
+    G_TYPE_OBJECT,
+    G_ADD_PRIVATE (Pressure)
+)
+
+static gboolean on_relax_timeout (gpointer user_data);
+
+static gdouble
+read_average (PressureResource resource)
+{
+    const PressureFile *file = &pressure_files[resource];
+    g_autofree char *path = get_root_path (file->path);
+    g_autofree char *contents = NULL;
+    char *line;
+    char *next;
+
+    if (!g_file_get_contents (path, &contents, NULL, NULL))
+        return 0;
+
+    /* some avg10=1.23 avg60=0.50 avg300=0.10 total=12345 */
+    for (line = contents; line != NULL; line = next) {
+        char *average;
+
+        next = strchr (line, '\n');
+        if (next != NULL)
+            *next++ = '\0';
+
+        if (!g_str_has_prefix (line, file->line))
+            continue;
+
+        average = strstr (line, "avg10=");
+        if (average != NULL)
+            return g_ascii_strtod (average + strlen ("avg10="), NULL);
+    }
+
+    return 0;
+}
+
+static void
+update_averages (Pressure *self)
+{
+    PressureResource resource;
+
+    for (resource = 0; resource < PRESSURE_LAST; resource++)
+        self->priv->monitors[resource].average = read_average (resource);
+
+    g_signal_emit (self, signals[READINGS_CHANGED], 0);
+}
+
+static void
+set_high (Monitor  *monitor,
+          gboolean  high)
+{
+    Pressure *self = monitor->pressure;
+
+    monitor->high = high;
+
+    g_message (
+        "%s pressure %s: %.2f%%",
+        pressure_files[monitor->resource].name,
+        high ? "high" : "relaxed",
+        monitor->average
+    );
+    g_signal_emit (
+        self, signals[PRESSURE_CHANGED], 0, monitor->resource, high
+    );
+
+    if (high && self->priv->relax_source == NULL) {
+        self->priv->relax_source = g_timeout_source_new_seconds (
+            PRESSURE_RELAX_INTERVAL
+        );
+        g_source_set_callback (
+            self->priv->relax_source, on_relax_timeout, self, NULL
+        );
+        g_source_attach (
+            self->priv->relax_source, g_main_context_get_thread_default ()
+        );
+    }
+}
+
+static gboolean
+on_relax_timeout (gpointer user_data)
+{
+    Pressure *self = PRESSURE (user_data);
+    PressureResource resource;
+    gboolean high = FALSE;
+
+    update_averages (self);
+
+    for (resource = 0; resource < PRESSURE_LAST; resource++) {
+        Monitor *monitor = &self->priv->monitors[resource];
+
+        if (!monitor->high)
+            continue;
+
+        if (monitor->average * 2 < monitor->threshold)
+            set_high (monitor, FALSE);
+        else
+            high = TRUE;
+    }
+
+    if (high)
+        return G_SOURCE_CONTINUE;
+
+    g_clear_pointer (&self->priv->relax_source, g_source_unref);
+    return G_SOURCE_REMOVE;
+}
+
+static void
+disarm_trigger (Monitor *monitor)
+{
+    if (monitor->source != NULL) {
+        g_source_destroy (monitor->source);
+        g_clear_pointer (&monitor->source, g_source_unref);
+    }
+
+    if (monitor->fd >= 0) {
+        close (monitor->fd);
+        monitor->fd = -1;
+    }
+}
+
+static gboolean
+on_trigger (gint         fd,
+            GIOCondition condition,
+            gpointer     user_data)
+{
+    Monitor *monitor = user_data;
+
+    /* Cgroup removed */
+    if (condition & G_IO_ERR) {
+        g_warning (
+            "%s pressure monitor lost", pressure_files[monitor->resource].name
+        );
+        close (monitor->fd);
+        monitor->fd = -1;
+        g_clear_pointer (&monitor->source, g_source_unref);
+        if (monitor->high)
+            set_high (monitor, FALSE);
+        return G_SOURCE_REMOVE;
+    }
+
+    if (!monitor->high) {
+        update_averages (monitor->pressure);
+        set_high (monitor, TRUE);
+    }
+
+    return G_SOURCE_CONTINUE;
+}
+
+static void
+arm_trigger (Monitor *monitor)
+{
+    const PressureFile *file = &pressure_files[monitor->resource];
+    g_autofree char *path = get_root_path (file->path);
+    g_autofree char *trigger = NULL;
+
+    disarm_trigger (monitor);
+
+    if (monitor->threshold == 0)
+        return;
+
+    monitor->fd = open (path, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (monitor->fd < 0) {
+        g_message ("No %s pressure: %s", file->name, g_strerror (errno));
+        return;
+    }
+
+    /* some 150000 1000000: 150ms stall in 1s */
+    trigger = g_strdup_printf (
+        "%s %u %u",
+        file->line,
+        monitor->threshold * (PRESSURE_WINDOW_US / 100),
+        PRESSURE_WINDOW_US
+    );
+    if (write (monitor->fd, trigger, strlen (trigger) + 1) < 0) {
+        g_warning (
+            "Can't set %s pressure trigger: %s", file->name, g_strerror (errno)
+        );
+        close (monitor->fd);
+        monitor->fd = -1;
+        return;
+    }
+
+    /* Thread default context: system daemon runs us on a worker */
+    monitor->source = g_unix_fd_source_new (monitor->fd, G_IO_PRI | G_IO_ERR);
+    g_source_set_callback (
+        monitor->source, G_SOURCE_FUNC (on_trigger), monitor, NULL
+    );
+    g_source_attach (monitor->source, g_main_context_get_thread_default ());
+}
+
+static void
+pressure_dispose (GObject *pressure)
+{
+    Pressure *self = PRESSURE (pressure);
+    PressureResource resource;
+
+    for (resource = 0; resource < PRESSURE_LAST; resource++)
+        disarm_trigger (&self->priv->monitors[resource]);
+
+    if (self->priv->relax_source != NULL) {
+        g_source_destroy (self->priv->relax_source);
+        g_clear_pointer (&self->priv->relax_source, g_source_unref);
+    }
+
+    G_OBJECT_CLASS (pressure_parent_class)->dispose (pressure);
+}
+
+static void
+pressure_finalize (GObject *pressure)
+{
+    G_OBJECT_CLASS (pressure_parent_class)->finalize (pressure);
+}
+
+static void
+pressure_class_init (PressureClass *klass)
+{
+    GObjectClass *object_class;
+
+    object_class = G_OBJECT_CLASS (klass);
+    object_class->dispose = pressure_dispose;
+    object_class->finalize = pressure_finalize;
+
+    signals[PRESSURE_CHANGED] = g_signal_new (
+        "pressure-changed",
+        G_OBJECT_CLASS_TYPE (object_class),
+        G_SIGNAL_RUN_LAST,
+        0,
+        NULL, NULL, NULL,
+        G_TYPE_NONE,
+        2,
+        G_TYPE_UINT,
+        G_TYPE_BOOLEAN
+    );
+
+    signals[READINGS_CHANGED] = g_signal_new (
+        "readings-changed",
+        G_OBJECT_CLASS_TYPE (object_class),
+        G_SIGNAL_RUN_LAST,
+        0,
+        NULL, NULL, NULL,
+        G_TYPE_NONE,
+        0
+    );
+}
+
+static void
+pressure_init (Pressure *self)
+{
+    PressureResource resource;
+
+    self->priv = pressure_get_instance_private (self);
+
+    self->priv->relax_source = NULL;
+    for (resource = 0; resource < PRESSURE_LAST; resource++) {
+        Monitor *monitor = &self->priv->monitors[resource];
+
+        monitor->pressure = self;
+        monitor->resource = resource;
+        monitor->threshold = 0;
+        monitor->fd = -1;
+        monitor->source = NULL;
+        monitor->high = FALSE;
+        monitor->average = read_average (resource);
+    }
+}
+
+/**
+ * pressure_new:
+ *
+ * Creates a new #Pressure monitor, using PSI triggers
+ *
+ * Returns: (transfer full): a new #Pressure
+ *
+ **/
+GObject *
+pressure_new (void)
+{
+    GObject *pressure;
+
+    pressure = g_object_new (TYPE_PRESSURE, NULL);
+
+    return pressure;
+}
+
+/**
+ * pressure_set_threshold:
+ *
+ * Set stall threshold, in percent of time, for resource
+ *
+ * @self: a #Pressure
+ * @resource: a #PressureResource
+ * @threshold: stall percent, 0 to disable
+ */
+void
+pressure_set_threshold (Pressure         *self,
+                        PressureResource  resource,
+                        guint             threshold)
+{
+    Monitor *monitor;
+
+    g_return_if_fail (resource < PRESSURE_LAST);
+    g_return_if_fail (threshold <= 100);
+
+    monitor = &self->priv->monitors[resource];
+    if (monitor->threshold == threshold && monitor->source != NULL)
+        return;
+
+    monitor->threshold = threshold;
+    arm_trigger (monitor);
+
+    if (monitor->high && threshold == 0)
+        set_high (monitor, FALSE);
+}
+
+/**
+ * pressure_is_high:
+ *
+ * Check if resource stall is over threshold
+ *
+ * @self: a #Pressure
+ * @resource: a #PressureResource
+ *
+ * Returns: TRUE if pressure is high
+ */
+gboolean
+pressure_is_high (Pressure         *self,
+                  PressureResource  resource)
+{
+    g_return_val_if_fail (resource < PRESSURE_LAST, FALSE);
+
+    return self->priv->monitors[resource].high;
+}
+
+/**
+ * pressure_get_readings:
+ *
+ * Get last stall averages over 10s, in percent
+ *
+ * @self: a #Pressure
+ *
+ * Returns: (transfer floating): averages by resource name, as a{sd}
+ */
+GVariant *
+pressure_get_readings (Pressure *self)
+{
+    GVariantBuilder builder;
+    PressureResource resource;
+
+    g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{sd}"));
+    for (resource = 0; resource < PRESSURE_LAST; resource++)
+        g_variant_builder_add (
+            &builder,
+            "{sd}",
+            pressure_files[resource].name,
+            self->priv->monitors[resource].average
+        );
+
+    return g_variant_builder_end (&builder);
+}
@@ -0,0 +1,64 @@
+/*
+ * Copyright Cedric Bellegarde <cedric.bellegarde@adishatz.org>
+ */
+
+#ifndef PRESSURE_H
+#define PRESSURE_H
+
+#include <glib.h>
+#include <glib-object.h>
+
+#define TYPE_PRESSURE \
+    (pressure_get_type ())
+#define PRESSURE(obj) \
+    (G_TYPE_CHECK_INSTANCE_CAST \
+    ((obj), TYPE_PRESSURE, Pressure))
+#define PRESSURE_CLASS(cls) \
+    (G_TYPE_CHECK_CLASS_CAST \
+    ((cls), TYPE_PRESSURE, PressureClass))
+#define IS_PRESSURE(obj) \
+    (G_TYPE_CHECK_INSTANCE_TYPE \
+    ((obj), TYPE_PRESSURE))
+#define IS_PRESSURE_CLASS(cls) \
+    (G_TYPE_CHECK_CLASS_TYPE \
+    ((cls), TYPE_PRESSURE))
+#define PRESSURE_GET_CLASS(obj) \
+    (G_TYPE_INSTANCE_GET_CLASS \
+    ((obj), TYPE_PRESSURE, PressureClass))
+
+G_BEGIN_DECLS
+
+typedef enum {
+    PRESSURE_CPU,
+    PRESSURE_MEMORY,
+    PRESSURE_IO,
+    PRESSURE_BACKGROUND,
+    PRESSURE_LAST
+} PressureResource;
+
+typedef struct _Pressure Pressure;
+typedef struct _PressureClass PressureClass;
+typedef struct _PressurePrivate PressurePrivate;
+
+struct _Pressure {
+    GObject parent;
+    PressurePrivate *priv;
+};
+
+struct _PressureClass {
+    GObjectClass parent_class;
+};
+
+GType            pressure_get_type            (void) G_GNUC_CONST;
+
+GObject*         pressure_new                 (void);
+void             pressure_set_threshold       (Pressure         *self,
+                                               PressureResource  resource,
+                                               guint             threshold);
+gboolean         pressure_is_high             (Pressure         *self,
+                                               PressureResource  resource);
+GVariant        *pressure_get_readings        (Pressure         *self);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,340 @@
+/*
+ * Copyright Cedric Bellegarde <cedric.bellegarde@adishatz.org>
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/connector.h>
+#include <linux/cn_proc.h>
+
+#include <glib-unix.h>
+
+#include "proc_events.h"
+
+#define PROC_EVENTS_BUFFER_SIZE 8192
+#define PROC_EVENTS_SOCKET_BUFFER_SIZE (1024 * 1024)
+
+/* signals */
+enum
+{
+    PROCESS_EVENT,
+    EVENTS_LOST,
+    LAST_SIGNAL
+};
+
+static guint signals[LAST_SIGNAL];
+
+struct _ProcEventsPrivate {
+    gint socket;
+    GSource *socket_source;
+};
+
+G_DEFINE_TYPE_WITH_CODE (
+    ProcEvents,
+    proc_events,
+    G_TYPE_OBJECT,
+    G_ADD_PRIVATE (ProcEvents)
+)
+
+static gboolean
+send_mcast_op (ProcEvents            *self,
+               enum proc_cn_mcast_op  op)
+{
+    char buffer[NLMSG_SPACE (sizeof (struct cn_msg) + sizeof (op))]
+        __attribute__ ((aligned (NLMSG_ALIGNTO)));
+    struct nlmsghdr *header = (struct nlmsghdr *) buffer;
+    struct cn_msg *message = NLMSG_DATA (header);
+
+    memset (buffer, 0, sizeof (buffer));
+    header->nlmsg_len = NLMSG_LENGTH (sizeof (struct cn_msg) + sizeof (op));
+    header->nlmsg_type = NLMSG_DONE;
+    message->id.idx = CN_IDX_PROC;
+    message->id.val = CN_VAL_PROC;
+    message->len = sizeof (op);
+    memcpy (message->data, &op, sizeof (op));
+
+    return send (self->priv->socket, buffer, header->nlmsg_len, 0) >= 0;
+}
+
+static void
+emit_event (ProcEvents    *self,
+            ProcEventType  type,
+            pid_t          pid,
+            pid_t          parent)
+{
+    g_signal_emit (
+        self,
+        signals[PROCESS_EVENT],
+        0,
+        type,
+        pid,
+        parent
+    );
+}
+
+static void
+handle_event (ProcEvents        *self,
+              struct proc_event *event)
+{
+    /* Only track thread group leaders, ie processes */
+    switch (event->what) {
+    case PROC_EVENT_FORK:
+        if (event->event_data.fork.child_pid ==
+                event->event_data.fork.child_tgid)
+            emit_event (
+                self,
+                PROC_EVENTS_STARTED,
+                event->event_data.fork.child_tgid,
+                event->event_data.fork.parent_tgid
+            );
+        break;
+    case PROC_EVENT_EXEC:
+        emit_event (
+            self,
+            PROC_EVENTS_CHANGED,
+            event->event_data.exec.process_tgid,
+            0
+        );
+        break;
+    case PROC_EVENT_COMM:
+        if (event->event_data.comm.process_pid ==
+                event->event_data.comm.process_tgid)
+            emit_event (
+                self,
+                PROC_EVENTS_CHANGED,
+                event->event_data.comm.process_tgid,
+                0
+            );
+        break;
+    case PROC_EVENT_EXIT:
+        if (event->event_data.exit.process_pid ==
+                event->event_data.exit.process_tgid)
+            emit_event (
+                self,
+                PROC_EVENTS_EXITED,
+                event->event_data.exit.process_tgid,
+                0
+            );
+        break;
+    default:
+        break;
+    }
+}
+
+static gboolean
+on_socket_event (gint         fd,
+                 GIOCondition condition,
+                 gpointer     user_data)
+{
+    ProcEvents *self = PROC_EVENTS (user_data);
+    char buffer[PROC_EVENTS_BUFFER_SIZE]
+        __attribute__ ((aligned (NLMSG_ALIGNTO)));
+
+    for (;;) {
+        struct sockaddr_nl from;
+        socklen_t from_length = sizeof (from);
+        struct nlmsghdr *header = (struct nlmsghdr *) buffer;
+        ssize_t length;
+        gint remaining;
+
+        length = recvfrom (
+            fd, buffer, sizeof (buffer), 0,
+            (struct sockaddr *) &from, &from_length
+        );
+
+        if (length < 0) {
+            if (errno == EINTR)
+                continue;
+            /* Socket buffer overrun: some events are lost */
+            if (errno == ENOBUFS) {
+                g_signal_emit (self, signals[EVENTS_LOST], 0);
+                continue;
+            }
+            break;
+        }
+
+        /* Only trust the kernel */
+        if (from.nl_pid != 0)
+            continue;
+
+        remaining = length;
+        for (; NLMSG_OK (header, remaining);
+                header = NLMSG_NEXT (header, remaining)) {
+            struct cn_msg *message;
+
+            if (header->nlmsg_type == NLMSG_ERROR ||
+                    header->nlmsg_type == NLMSG_NOOP)
+                continue;
+
+            message = NLMSG_DATA (header);
+            if (message->id.idx != CN_IDX_PROC ||
+                    message->id.val != CN_VAL_PROC)
+                continue;
+
+            handle_event (self, (struct proc_event *) message->data);
+        }
+    }
+
+    return G_SOURCE_CONTINUE;
+}
+
+static gboolean
+connect_proc_events (ProcEvents *self)
+{
+    struct sockaddr_nl address = {
+        .nl_family = AF_NETLINK,
+        .nl_groups = CN_IDX_PROC,
+        .nl_pid = 0
+    };
+    gint buffer_size = PROC_EVENTS_SOCKET_BUFFER_SIZE;
+
+    self->priv->socket = socket (
+        PF_NETLINK,
+        SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+        NETLINK_CONNECTOR
+    );
+    if (self->priv->socket < 0) {
+        g_warning ("Can't open proc connector: %s", g_strerror (errno));
+        return FALSE;
+    }
+
+    /* Events come in bursts on app launch */
+    setsockopt (
+        self->priv->socket, SOL_SOCKET, SO_RCVBUF,
+        &buffer_size, sizeof (buffer_size)
+    );
+
+    if (bind (self->priv->socket,
+              (struct sockaddr *) &address,
+              sizeof (address)) < 0 ||
+            !send_mcast_op (self, PROC_CN_MCAST_LISTEN)) {
+        g_warning ("Can't listen to proc connector: %s", g_strerror (errno));
+        close (self->priv->socket);
+        self->priv->socket = -1;
+        return FALSE;
+    }
+
+    /* Thread default context: system daemon runs us on a worker */
+    self->priv->socket_source = g_unix_fd_source_new (
+        self->priv->socket, G_IO_IN
+    );
+    g_source_set_callback (
+        self->priv->socket_source,
+        G_SOURCE_FUNC (on_socket_event),
+        self,
+        NULL
+    );
+    g_source_attach (
+        self->priv->socket_source, g_main_context_get_thread_default ()
+    );
+
+    return TRUE;
+}
+
+static void
+proc_events_dispose (GObject *proc_events)
+{
+    ProcEvents *self = PROC_EVENTS (proc_events);
+
+    if (self->priv->socket_source != NULL) {
+        g_source_destroy (self->priv->socket_source);
+        g_clear_pointer (&self->priv->socket_source, g_source_unref);
+    }
+
+    if (self->priv->socket >= 0) {
+        send_mcast_op (self, PROC_CN_MCAST_IGNORE);
+        close (self->priv->socket);
+        self->priv->socket = -1;
+    }
+
+    G_OBJECT_CLASS (proc_events_parent_class)->dispose (proc_events);
+}
+
+static void
+proc_events_finalize (GObject *proc_events)
+{
+    G_OBJECT_CLASS (proc_events_parent_class)->finalize (proc_events);
+}
+
+static void
+proc_events_class_init (ProcEventsClass *klass)
+{
+    GObjectClass *object_class;
+
+    object_class = G_OBJECT_CLASS (klass);
+    object_class->dispose = proc_events_dispose;
+    object_class->finalize = proc_events_finalize;
+
+    signals[PROCESS_EVENT] = g_signal_new (
+        "process-event",
+        G_OBJECT_CLASS_TYPE (object_class),
+        G_SIGNAL_RUN_LAST,
+        0,
+        NULL, NULL, NULL,
+        G_TYPE_NONE,
+        3,
+        G_TYPE_UINT,
+        G_TYPE_INT,
+        G_TYPE_INT
+    );
+
+    signals[EVENTS_LOST] = g_signal_new (
+        "events-lost",
+        G_OBJECT_CLASS_TYPE (object_class),
+        G_SIGNAL_RUN_LAST,
+        0,
+        NULL, NULL, NULL,
+        G_TYPE_NONE,
+        0
+    );
+}
+
+static void
+proc_events_init (ProcEvents *self)
+{
+    self->priv = proc_events_get_instance_private (self);
+
+    self->priv->socket = -1;
+    self->priv->socket_source = NULL;
+
+    connect_proc_events (self);
+}
+
+/**
+ * proc_events_new:
+ *
+ * Creates a new #ProcEvents: processes start, change (exec, comm) and
+ * exit events from kernel proc connector
+ *
+ * Returns: (transfer full): a new #ProcEvents
+ *
+ **/
+GObject *
+proc_events_new (void)
+{
+    GObject *proc_events;
+
+    proc_events = g_object_new (TYPE_PROC_EVENTS, NULL);
+
+    return proc_events;
+}
+
+/**
+ * proc_events_is_listening:
+ *
+ * Check if kernel proc connector is available
+ *
+ * @self: a #ProcEvents
+ *
+ * Returns: TRUE if events are received
+ */
+gboolean
+proc_events_is_listening (ProcEvents *self)
+{
+    return self->priv->socket >= 0;
+}
@@ -0,0 +1,58 @@
+/*
+ * Copyright Cedric Bellegarde <cedric.bellegarde@adishatz.org>
+ */
+
+#ifndef PROC_EVENTS_H
+#define PROC_EVENTS_H
+
+#include <glib.h>
+#include <glib-object.h>
+
+#define TYPE_PROC_EVENTS \
+    (proc_events_get_type ())
+#define PROC_EVENTS(obj) \
+    (G_TYPE_CHECK_INSTANCE_CAST \
+    ((obj), TYPE_PROC_EVENTS, ProcEvents))
+#define PROC_EVENTS_CLASS(cls) \
+    (G_TYPE_CHECK_CLASS_CAST \
+    ((cls), TYPE_PROC_EVENTS, ProcEventsClass))
+#define IS_PROC_EVENTS(obj) \
+    (G_TYPE_CHECK_INSTANCE_TYPE \
+    ((obj), TYPE_PROC_EVENTS))
+#define IS_PROC_EVENTS_CLASS(cls) \
+    (G_TYPE_CHECK_CLASS_TYPE \
+    ((cls), TYPE_PROC_EVENTS))
+#define PROC_EVENTS_GET_CLASS(obj) \
+    (G_TYPE_INSTANCE_GET_CLASS \
+    ((obj), TYPE_PROC_EVENTS, ProcEventsClass))
+
+G_BEGIN_DECLS
+
+typedef enum {
+    PROC_EVENTS_STARTED,
+    PROC_EVENTS_CHANGED,
+    PROC_EVENTS_EXITED
+} ProcEventType;
+
+typedef struct _ProcEvents ProcEvents;
+typedef struct _ProcEventsClass ProcEventsClass;
+typedef struct _ProcEventsPrivate ProcEventsPrivate;
+
+struct _ProcEvents {
+    GObject parent;
+    ProcEventsPrivate *priv;
+};
+
+struct _ProcEventsClass {
+    GObjectClass parent_class;
+};
+
+GType           proc_events_get_type         (void) G_GNUC_CONST;
+
+GObject*        proc_events_new              (void);
+gboolean        proc_events_is_listening     (ProcEvents *self);
+
+G_END_DECLS
+
+#endif
+
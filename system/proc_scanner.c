@@ -0,0 +1,414 @@
+/*
+ * Copyright Cedric Bellegarde <cedric.bellegarde@adishatz.org>
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "proc_scanner.h"
+
+/*
+ * /proc snapshot for kernels without proc connector:
+ * - PIDs are read from a persistent /proc dirfd, files with openat()
+ * - scanning only lists PIDs, cmdlines are read on first use, so an
+ *   empty names list costs no cmdline read at all
+ * - entries live in one array, cmdlines in a few string chunks: a
+ *   snapshot is freed in a few calls, whatever the processes count
+ * - with threads > 1, cmdlines of big /proc trees are read by a small
+ *   pool, one string chunk and buffer per shard
+ */
+
+#define PROC_SCANNER_CMDLINE_SIZE (1024 * 64 * 2)
+#define PROC_SCANNER_CHUNK_SIZE 16384
+#define PROC_SCANNER_SHARD_MIN 1024
+#define PROC_SCANNER_PATH_SIZE 32  // "2000222000/cmdline"
+
+struct ProcEntry {
+    pid_t pid;
+    const char *cmdline;
+};
+
+struct ProcShard {
+    ProcScanner *scanner;
+    struct ProcEntry *entries;
+    guint length;
+
+    GStringChunk *cmdlines;
+    gsize cmdlines_size;
+};
+
+struct _ProcScanner {
+    gint proc_fd;
+    DIR *proc_dir;
+
+    guint threads;
+    GThreadPool *pool;
+    GAsyncQueue *done;
+
+    guint length_hint;
+    char *buffer;
+};
+
+struct _ProcSnapshot {
+    ProcScanner *scanner;
+
+    struct ProcEntry *entries;
+    guint length;
+
+    /* Inline reads chunk first, then one per shard */
+    GPtrArray *cmdlines;
+    gsize cmdlines_size;
+};
+
+// From https://gitlab.com/procps-ng/procps read_unvectored()
+//
+static gsize
+read_cmdline (ProcScanner *self,
+              pid_t        pid,
+              char        *dst)
+{
+    char path[PROC_SCANNER_PATH_SIZE];
+    gsize size = PROC_SCANNER_CMDLINE_SIZE;
+    gsize n = 0;
+    gint fd;
+
+    dst[0] = '\0';
+
+    snprintf (path, sizeof (path), "%d/cmdline", pid);
+    fd = openat (self->proc_fd, path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return 0;
+
+    for (;;) {
+        ssize_t r = read (fd, dst + n, size - n);
+
+        if (r == -1) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        if (r <= 0)  // EOF
+            break;
+        n += r;
+        if (n == size) {  // filled the buffer
+            --n;          // make room for '\0'
+            break;
+        }
+    }
+    close (fd);
+
+    if (n) {
+        gsize i = n;
+
+        while (i && dst[i - 1] == '\0')  // skip trailing zeroes
+            --i;
+        while (i--)
+            if (dst[i] == '\n' || dst[i] == '\0')
+                dst[i] = ' ';
+        if (dst[n - 1] == ' ')
+            dst[n - 1] = '\0';
+    }
+    dst[n] = '\0';
+
+    return strlen (dst);
+}
+
+static void
+load_entry (ProcScanner      *self,
+            struct ProcEntry *entry,
+            GStringChunk     *cmdlines,
+            gsize            *cmdlines_size,
+            char             *buffer)
+{
+    gsize length = read_cmdline (self, entry->pid, buffer);
+
+    /* Exited processes get an empty cmdline, as kernel threads */
+    entry->cmdline = g_string_chunk_insert_len (cmdlines, buffer, length);
+    *cmdlines_size += length + 1;
+}
+
+static void
+load_shard (gpointer data,
+            gpointer user_data)
+{
+    struct ProcShard *shard = data;
+    g_autofree char *buffer = g_malloc (PROC_SCANNER_CMDLINE_SIZE);
+    guint i;
+
+    for (i = 0; i < shard->length; i++)
+        if (shard->entries[i].cmdline == NULL)
+            load_entry (
+                shard->scanner,
+                &shard->entries[i],
+                shard->cmdlines,
+                &shard->cmdlines_size,
+                buffer
+            );
+
+    g_async_queue_push (shard->scanner->done, shard);
+}
+
+/**
+ * proc_scanner_new:
+ *
+ * Creates a new #ProcScanner
+ *
+ * @proc_path: procfs mount point
+ * @threads: threads used to scan big trees, 0 or 1 to scan inline
+ *
+ * Returns: (transfer full): a new #ProcScanner
+ */
+ProcScanner *
+proc_scanner_new (const char *proc_path,
+                  guint       threads)
+{
+    ProcScanner *self = g_new0 (ProcScanner, 1);
+
+    self->proc_fd = open (proc_path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (self->proc_fd < 0)
+        g_warning ("%s not found", proc_path);
+    else
+        self->proc_dir = fdopendir (dup (self->proc_fd));
+
+    self->threads = threads;
+    if (threads > 1) {
+        self->pool = g_thread_pool_new (load_shard, NULL, threads, FALSE, NULL);
+        self->done = g_async_queue_new ();
+    }
+
+    self->buffer = g_malloc (PROC_SCANNER_CMDLINE_SIZE);
+
+    return self;
+}
+
+/**
+ * proc_scanner_scan:
+ *
+ * Take a snapshot of running processes
+ *
+ * @self: a #ProcScanner
+ *
+ * Returns: (transfer full): a new #ProcSnapshot, not to outlive @self
+ */
+ProcSnapshot *
+proc_scanner_scan (ProcScanner *self)
+{
+    ProcSnapshot *snapshot = g_new0 (ProcSnapshot, 1);
+    GArray *entries = g_array_sized_new (
+        FALSE, FALSE, sizeof (struct ProcEntry), self->length_hint
+    );
+    struct dirent *dirent;
+
+    snapshot->scanner = self;
+    snapshot->cmdlines = g_ptr_array_new_with_free_func (
+        (GDestroyNotify) g_string_chunk_free
+    );
+    g_ptr_array_add (
+        snapshot->cmdlines, g_string_chunk_new (PROC_SCANNER_CHUNK_SIZE)
+    );
+
+    if (self->proc_dir != NULL) {
+        rewinddir (self->proc_dir);
+
+        while ((dirent = readdir (self->proc_dir)) != NULL) {
+            struct ProcEntry new_entry = { 0 };
+
+            // Skip non-numeric entries
+            if (!g_ascii_isdigit (dirent->d_name[0]))
+                continue;
+
+            new_entry.pid = atoi (dirent->d_name);
+            g_array_append_val (entries, new_entry);
+        }
+    }
+
+    snapshot->length = entries->len;
+    snapshot->entries = (struct ProcEntry *) g_array_free (entries, FALSE);
+
+    self->length_hint = snapshot->length;
+
+    return snapshot;
+}
+
+/**
+ * proc_scanner_read_cmdline:
+ *
+ * Read process cmdline, arguments separated by spaces
+ *
+ * @self: a #ProcScanner
+ * @pid: process id
+ *
+ * Returns: (transfer full): cmdline or NULL for kernel threads or
+ *          exited processes
+ */
+char *
+proc_scanner_read_cmdline (ProcScanner *self,
+                           pid_t        pid)
+{
+    if (read_cmdline (self, pid, self->buffer) == 0)
+        return NULL;
+
+    return g_strdup (self->buffer);
+}
+
+/**
+ * proc_scanner_free:
+ *
+ * Free scanner
+ *
+ * @self: a #ProcScanner
+ */
+void
+proc_scanner_free (ProcScanner *self)
+{
+    if (self->pool != NULL)
+        g_thread_pool_free (self->pool, FALSE, TRUE);
+    if (self->done != NULL)
+        g_async_queue_unref (self->done);
+    if (self->proc_dir != NULL)
+        closedir (self->proc_dir);
+    if (self->proc_fd >= 0)
+        close (self->proc_fd);
+    g_free (self->buffer);
+    g_free (self);
+}
+
+/**
+ * proc_snapshot_length:
+ *
+ * @self: a #ProcSnapshot
+ *
+ * Returns: processes count
+ */
+guint
+proc_snapshot_length (ProcSnapshot *self)
+{
+    return self->length;
+}
+
+/**
+ * proc_snapshot_get_pid:
+ *
+ * @self: a #ProcSnapshot
+ * @index: process index
+ *
+ * Returns: process id
+ */
+pid_t
+proc_snapshot_get_pid (ProcSnapshot *self,
+                       guint         index)
+{
+    return self->entries[index].pid;
+}
+
+/**
+ * proc_snapshot_get_cmdline:
+ *
+ * Get process cmdline, read from /proc on first call
+ *
+ * @self: a #ProcSnapshot
+ * @index: process index
+ *
+ * Returns: (transfer none): cmdline, empty for kernel threads
+ */
+const char *
+proc_snapshot_get_cmdline (ProcSnapshot *self,
+                           guint         index)
+{
+    struct ProcEntry *entry = &self->entries[index];
+
+    if (entry->cmdline == NULL)
+        load_entry (
+            self->scanner,
+            entry,
+            g_ptr_array_index (self->cmdlines, 0),
+            &self->cmdlines_size,
+            self->scanner->buffer
+        );
+
+    return entry->cmdline;
+}
+
+/**
+ * proc_snapshot_load_cmdlines:
+ *
+ * Read all processes cmdlines, split across scanner threads for big
+ * snapshots
+ *
+ * @self: a #ProcSnapshot
+ */
+void
+proc_snapshot_load_cmdlines (ProcSnapshot *self)
+{
+    ProcScanner *scanner = self->scanner;
+    guint shards_count = MIN (
+        scanner->threads, self->length / PROC_SCANNER_SHARD_MIN
+    );
+    g_autofree struct ProcShard *shards = NULL;
+    guint shard_length;
+    guint i;
+
+    if (scanner->pool == NULL || shards_count < 2) {
+        for (i = 0; i < self->length; i++)
+            proc_snapshot_get_cmdline (self, i);
+        return;
+    }
+
+    shards = g_new (struct ProcShard, shards_count);
+    shard_length = self->length / shards_count;
+
+    for (i = 0; i < shards_count; i++) {
+        shards[i].scanner = scanner;
+        shards[i].entries = self->entries + i * shard_length;
+        shards[i].length = i == shards_count - 1 ?
+            self->length - i * shard_length : shard_length;
+        shards[i].cmdlines = g_string_chunk_new (PROC_SCANNER_CHUNK_SIZE);
+        shards[i].cmdlines_size = 0;
+
+        g_thread_pool_push (scanner->pool, &shards[i], NULL);
+    }
+
+    for (i = 0; i < shards_count; i++)
+        g_async_queue_pop (scanner->done);
+
+    for (i = 0; i < shards_count; i++) {
+        g_ptr_array_add (self->cmdlines, shards[i].cmdlines);
+        self->cmdlines_size += shards[i].cmdlines_size;
+    }
+}
+
+/**
+ * proc_snapshot_get_size:
+ *
+ * @self: a #ProcSnapshot
+ *
+ * Returns: memory used by snapshot, in bytes
+ */
+gsize
+proc_snapshot_get_size (ProcSnapshot *self)
+{
+    return sizeof (ProcSnapshot) +
+        self->length * sizeof (struct ProcEntry) +
+        self->cmdlines_size;
+}
+
+/**
+ * proc_snapshot_free:
+ *
+ * Free snapshot
+ *
+ * @self: a #ProcSnapshot
+ */
+void
+proc_snapshot_free (ProcSnapshot *self)
+{
+    g_ptr_array_free (self->cmdlines, TRUE);
+    g_free (self->entries);
+    g_free (self);
+}
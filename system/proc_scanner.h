@@ -0,0 +1,37 @@
+/*
+ * Copyright Cedric Bellegarde <cedric.bellegarde@adishatz.org>
+ */
+
+#ifndef PROC_SCANNER_H
+#define PROC_SCANNER_H
+
+#include <sys/types.h>
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _ProcScanner ProcScanner;
+typedef struct _ProcSnapshot ProcSnapshot;
+
+ProcScanner    *proc_scanner_new             (const char   *proc_path,
+                                              guint         threads);
+ProcSnapshot   *proc_scanner_scan            (ProcScanner  *self);
+char           *proc_scanner_read_cmdline    (ProcScanner  *self,
+                                              pid_t         pid);
+void            proc_scanner_free            (ProcScanner  *self);
+guint           proc_snapshot_length         (ProcSnapshot *self);
+pid_t           proc_snapshot_get_pid        (ProcSnapshot *self,
+                                              guint         index);
+const char     *proc_snapshot_get_cmdline    (ProcSnapshot *self,
+                                              guint         index);
+void            proc_snapshot_load_cmdlines  (ProcSnapshot *self);
+gsize           proc_snapshot_get_size       (ProcSnapshot *self);
+void            proc_snapshot_free           (ProcSnapshot *self);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (ProcScanner, proc_scanner_free)
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (ProcSnapshot, proc_snapshot_free)
+
+G_END_DECLS
+
+#endif
@@ -2,24 +2,41 @@
  * Copyright Cedric Bellegarde <cedric.bellegarde@adishatz.org>
  */
 
-#include <fcntl.h>
 #include <stdio.h>
 #include <stdarg.h>
-#include <signal.h>
+#include <string.h>
 
 #include <gio/gio.h>
 
+#include "freezer.h"
+#include "placement.h"
 #include "processes.h"
+#include "proc_events.h"
+#include "proc_scanner.h"
 #include "../common/utils.h"
+#include "../common/writer.h"
 
-#define MAX_BUFSZ (1024*64*2)
-#define PROCPATHLEN 64  // must hold /proc/2000222000/task/2000222000/cmdline
+#define PROCESSES_SCAN_THREADS 4
 
 struct _ProcessesPrivate {
-    GList *processes;
+    ProcScanner *scanner;
+    /* Without proc connector: snapshot from last update */
+    ProcSnapshot *snapshot;
+    /* With proc connector: pid -> struct Process, kept current */
+    GHashTable *processes;
 
-    GList *cpuset_blacklist;
-    GList *cpuset_topapp;
+    ProcEvents *proc_events;
+    guint64 events;
+    gint64 events_time;
+
+    Freezer *freezer;
+    Matcher *suspended;
+
+    Placement *placement;
+
+    Matcher *cpuset_blacklist;
+    Matcher *cpuset_topapp;
+    Matcher *cpu_idle_services;
 };
 
 G_DEFINE_TYPE_WITH_CODE (
@@ -34,21 +51,13 @@ struct Process {
     char *cmdline;
 };
 
-static const char*
-get_cpuset_path (CpuSet cpuset)
-{
-    switch (cpuset) {
-    case CPUSET_BACKGROUND:
-        return "/dev/cpuset/background/tasks";
-    case CPUSET_SYSTEM_BACKGROUND:
-        return "/dev/cpuset/system-background/tasks";
-    case CPUSET_FOREGROUND:
-        return "/dev/cpuset/foreground/tasks";
-    case CPUSET_TOPAPP:
-    default:
-        return "/dev/cpuset/top-app/tasks";
-    }
-}
+struct CpusetRequest {
+    Placement *placement;
+    WriterBatch *batch;
+    CpuSet cpuset;
+};
+
+typedef void (*ProcessFunc) (pid_t pid, gpointer user_data);
 
 static void
 process_free (gpointer user_data)
@@ -59,109 +68,232 @@ process_free (gpointer user_data)
     g_free (process);
 }
 
-// From https://gitlab.com/procps-ng/procps
-//
-static int read_unvectored(char *restrict const  dst,
-                           unsigned              sz,
-                           const char           *whom,
-                           const char           *what,
-                           char                  sep)
+static gboolean
+process_in_list (Matcher    *names,
+                 const char *cmdline)
 {
-    char path[PROCPATHLEN];
-    int fd, len;
-    unsigned n = 0;
-
-    if(sz <= 0) return 0;
-    if(sz >= INT_MAX) sz = INT_MAX-1;
-    dst[0] = '\0';
-
-    len = snprintf(path, sizeof(path), "%s/%s", whom, what);
-    if(len <= 0 || (size_t)len >= sizeof(path)) return 0;
-    fd = open(path, O_RDONLY);
-    if(fd==-1) return 0;
-
-    for(;;){
-        ssize_t r = read(fd,dst+n,sz-n);
-        if(r==-1){
-            if(errno==EINTR) continue;
-            break;
-        }
-        if(r<=0) break;  // EOF
-        n += r;
-        if(n==sz) {      // filled the buffer
-            --n;         // make room for '\0'
-            break;
-        }
+    if (g_strcmp0 (cmdline, "") == 0)
+        return FALSE;
+
+    return matcher_match (names, cmdline);
+}
+
+static void
+foreach_process_in_list (Processes   *self,
+                         Matcher     *names,
+                         ProcessFunc  func,
+                         gpointer     user_data)
+{
+    ProcSnapshot *snapshot = self->priv->snapshot;
+    GHashTableIter iter;
+    gpointer value;
+    guint i;
+
+    /* No need to read any cmdline */
+    if (matcher_length (names) == 0)
+        return;
+
+    if (snapshot != NULL) {
+        proc_snapshot_load_cmdlines (snapshot);
+        for (i = 0; i < proc_snapshot_length (snapshot); i++)
+            if (process_in_list (names,
+                                 proc_snapshot_get_cmdline (snapshot, i)))
+                func (proc_snapshot_get_pid (snapshot, i), user_data);
+        return;
     }
-    close(fd);
-    if(n){
-        unsigned i = n;
-        while(i && dst[i-1]=='\0') --i; // skip trailing zeroes
-        while(i--)
-            if(dst[i]=='\n' || dst[i]=='\0') dst[i]=sep;
-        if(dst[n-1]==' ') dst[n-1]='\0';
+
+    g_hash_table_iter_init (&iter, self->priv->processes);
+    while (g_hash_table_iter_next (&iter, NULL, &value)) {
+        struct Process *process = value;
+
+        if (process_in_list (names, process->cmdline))
+            func (process->pid, user_data);
     }
-    dst[n] = '\0';
-    return n;
 }
 
-static gboolean
-process_in_list (GList          *names,
-                 struct Process *process)
+static void
+add_to_set (pid_t    pid,
+            gpointer user_data)
 {
-    char *name;
+    GHashTable *pids = user_data;
 
-    if (g_strcmp0 (process->cmdline, "") == 0)
-        return FALSE;
+    g_hash_table_add (pids, GINT_TO_POINTER (pid));
+}
 
-    GFOREACH (names, name) {
-        if (g_strrstr (process->cmdline, name) != NULL)
-            return TRUE;
-    }
-    return FALSE;
+static void
+add_to_cpuset (pid_t    pid,
+               gpointer user_data)
+{
+    struct CpusetRequest *request = user_data;
+
+    placement_move_process (
+        request->placement, request->batch, pid, request->cpuset
+    );
+}
+
+static struct Process *
+add_process (Processes *self,
+             pid_t      pid,
+             char      *cmdline)
+{
+    struct Process *process = g_malloc (sizeof (struct Process));
+
+    process->pid = pid;
+    process->cmdline = cmdline;
+
+    g_hash_table_replace (self->priv->processes, GINT_TO_POINTER (pid), process);
+
+    return process;
+}
+
+static void
+update_freezer (Processes *self)
+{
+    g_autoptr (GHashTable) pids = g_hash_table_new (
+        g_direct_hash, g_direct_equal
+    );
+
+    foreach_process_in_list (self, self->priv->suspended, add_to_set, pids);
+    freezer_update (self->priv->freezer, pids);
 }
 
-static GList *
-get_processes (Processes *self)
+static void
+update_freezer_process (Processes      *self,
+                        struct Process *process,
+                        pid_t           parent)
+{
+    if (process_in_list (self->priv->suspended, process->cmdline))
+        freezer_add (self->priv->freezer, process->pid, parent);
+    else
+        freezer_remove (self->priv->freezer, process->pid);
+}
+
+static void
+load_processes (Processes *self)
 {
-    GList *processes = NULL;
-    g_autoptr (GDir) proc_dir = NULL;
-    const char *pid_dir;
-
-    proc_dir = g_dir_open ("/proc", 0, NULL);
-    if (proc_dir == NULL) {
-        g_warning ("/proc not found");
-        return NULL;
+    g_autoptr (ProcSnapshot) snapshot = proc_scanner_scan (self->priv->scanner);
+    guint i;
+
+    g_hash_table_remove_all (self->priv->processes);
+    proc_snapshot_load_cmdlines (snapshot);
+
+    for (i = 0; i < proc_snapshot_length (snapshot); i++) {
+        const char *cmdline = proc_snapshot_get_cmdline (snapshot, i);
+
+        // Kernel threads have no cmdline
+        if (*cmdline != '\0')
+            add_process (
+                self,
+                proc_snapshot_get_pid (snapshot, i),
+                g_strdup (cmdline)
+            );
     }
+}
 
-    while ((pid_dir = g_dir_read_name (proc_dir)) != NULL) {
-        char contents[MAX_BUFSZ] = {0};
-        g_autofree char *directory = NULL;
+static void
+update_snapshot (Processes *self)
+{
+    g_clear_pointer (&self->priv->snapshot, proc_snapshot_free);
+    self->priv->snapshot = proc_scanner_scan (self->priv->scanner);
+}
 
-        // Skip non-numeric entries
-        if (!g_ascii_isdigit (pid_dir[0]))
-            continue;
+static void
+on_process_event (ProcEvents *proc_events,
+                  guint       type,
+                  gint        pid,
+                  gint        parent,
+                  gpointer    user_data)
+{
+    Processes *self = PROCESSES (user_data);
+    gint64 start = g_get_monotonic_time ();
+    struct Process *process;
+    char *cmdline;
 
-        directory = g_build_filename (
-            "/proc", pid_dir, NULL
+    switch (type) {
+    case PROC_EVENTS_STARTED:
+        /* Same cmdline as parent until exec */
+        process = g_hash_table_lookup (
+            self->priv->processes, GINT_TO_POINTER (parent)
         );
+        if (process != NULL) {
+            process = add_process (self, pid, g_strdup (process->cmdline));
+            update_freezer_process (self, process, parent);
+        }
+        break;
+    case PROC_EVENTS_CHANGED:
+        cmdline = proc_scanner_read_cmdline (self->priv->scanner, pid);
+        if (cmdline != NULL) {
+            process = add_process (self, pid, cmdline);
+            update_freezer_process (self, process, 0);
+        } else {
+            g_hash_table_remove (self->priv->processes, GINT_TO_POINTER (pid));
+            freezer_forget (self->priv->freezer, pid);
+        }
+        break;
+    case PROC_EVENTS_EXITED:
+        g_hash_table_remove (self->priv->processes, GINT_TO_POINTER (pid));
+        freezer_forget (self->priv->freezer, pid);
+        break;
+    default:
+        break;
+    }
 
-        if (read_unvectored(contents, MAX_BUFSZ, directory, "cmdline", ' ')) {
-            struct Process *process = g_malloc (sizeof (struct Process));
+    self->priv->events++;
+    self->priv->events_time += g_get_monotonic_time () - start;
+}
 
-            process->cmdline = g_strdup (contents);
-            sscanf (pid_dir, "%d", &process->pid);
+static void
+on_process_events_lost (ProcEvents *proc_events,
+                        gpointer    user_data)
+{
+    Processes *self = PROCESSES (user_data);
 
-            processes = g_list_prepend (processes, process);
-        }
+    g_warning ("Process events lost, rescanning processes");
+    load_processes (self);
+    update_freezer (self);
+}
+
+static void
+log_stats (Processes *self)
+{
+    GHashTableIter iter;
+    gpointer value;
+    guint count = g_hash_table_size (self->priv->processes);
+    gsize size = 0;
+
+    g_hash_table_iter_init (&iter, self->priv->processes);
+    while (g_hash_table_iter_next (&iter, NULL, &value)) {
+        struct Process *process = value;
+
+        size += sizeof (struct Process) + strlen (process->cmdline) + 1;
     }
 
-    return processes;
+    if (self->priv->snapshot != NULL) {
+        count = proc_snapshot_length (self->priv->snapshot);
+        size = proc_snapshot_get_size (self->priv->snapshot);
+    }
+
+    g_debug (
+        "Processes: %u tracked, %" G_GSIZE_FORMAT " bytes, "
+        "%" G_GUINT64_FORMAT " events, %.1f us/event, %u in freezer",
+        count,
+        size,
+        self->priv->events,
+        self->priv->events > 0 ?
+            (double) self->priv->events_time / self->priv->events : 0.0,
+        freezer_length (self->priv->freezer)
+    );
 }
 
 static void
 processes_dispose (GObject *processes)
 {
+    Processes *self = PROCESSES (processes);
+
+    g_clear_object (&self->priv->proc_events);
+    g_clear_object (&self->priv->freezer);
+    g_clear_object (&self->priv->placement);
+
     G_OBJECT_CLASS (processes_parent_class)->dispose (processes);
 }
 
@@ -170,9 +302,13 @@ processes_finalize (GObject *processes)
 {
     Processes *self = PROCESSES (processes);
 
-    g_list_free_full (self->priv->processes, process_free);
-    g_list_free_full (self->priv->cpuset_blacklist, g_free);
-    g_list_free_full (self->priv->cpuset_topapp, g_free);
+    g_hash_table_destroy (self->priv->processes);
+    g_clear_pointer (&self->priv->snapshot, proc_snapshot_free);
+    proc_scanner_free (self->priv->scanner);
+    g_clear_pointer (&self->priv->suspended, matcher_free);
+    g_clear_pointer (&self->priv->cpuset_blacklist, matcher_free);
+    g_clear_pointer (&self->priv->cpuset_topapp, matcher_free);
+    g_clear_pointer (&self->priv->cpu_idle_services, matcher_free);
 
     G_OBJECT_CLASS (processes_parent_class)->finalize (processes);
 }
@@ -190,11 +326,52 @@ processes_class_init (ProcessesClass *klass)
 static void
 processes_init (Processes *self)
 {
+    g_autofree char *proc_path = get_root_path ("/proc");
+
     self->priv = processes_get_instance_private (self);
 
-    self->priv->processes = NULL;
-    self->priv->cpuset_blacklist = NULL;
-    self->priv->cpuset_topapp = NULL;
+    self->priv->processes = g_hash_table_new_full (
+        g_direct_hash, g_direct_equal, NULL, process_free
+    );
+    self->priv->scanner = proc_scanner_new (proc_path, PROCESSES_SCAN_THREADS);
+    self->priv->snapshot = NULL;
+    self->priv->proc_events = NULL;
+    self->priv->events = 0;
+    self->priv->events_time = 0;
+    self->priv->freezer = FREEZER (freezer_new ());
+    self->priv->suspended = matcher_new ();
+    self->priv->placement = PLACEMENT (placement_new ());
+    self->priv->cpuset_blacklist = matcher_new ();
+    self->priv->cpuset_topapp = matcher_new ();
+    self->priv->cpu_idle_services = matcher_new ();
+
+    /* Kernel events are about real processes, not the relocated ones */
+    if (get_root_dir () == NULL) {
+        self->priv->proc_events = PROC_EVENTS (proc_events_new ());
+
+        if (proc_events_is_listening (self->priv->proc_events)) {
+            g_signal_connect (
+                self->priv->proc_events,
+                "process-event",
+                G_CALLBACK (on_process_event),
+                self
+            );
+            g_signal_connect (
+                self->priv->proc_events,
+                "events-lost",
+                G_CALLBACK (on_process_events_lost),
+                self
+            );
+        } else {
+            g_clear_object (&self->priv->proc_events);
+        }
+    }
+
+    /* Subscribe first, so that no process is missed */
+    if (self->priv->proc_events != NULL)
+        load_processes (self);
+    else
+        update_snapshot (self);
 }
 
 /**
@@ -218,36 +395,55 @@ processes_new (void)
 /**
  * processes_update:
  *
- * Update processes list
+ * Update processes list. Only needed without kernel proc connector,
+ * processes list is kept current from its events otherwise.
  *
  * @param #Processes
  */
 void
 processes_update (Processes *self) {
-    g_list_free_full (self->priv->processes, g_free);
-    self->priv->processes = get_processes (self);
+    if (self->priv->proc_events == NULL)
+        update_snapshot (self);
+
+    log_stats (self);
 }
 
 /**
- * processes_suspend:
+ * processes_set_suspended:
  *
- * Suspend processes in list
+ * Set processes to suspend, moved to freezer now, so that suspending
+ * and resuming them is O(1)
  *
  * @param #Processes
- * @param processes: processes list
+ * @param processes: processes names (transfer full)
  */
 void
-processes_suspend (Processes *self,
-                   GList     *processes) {
+processes_set_suspended (Processes *self,
+                         Matcher   *processes)
+{
+    g_return_if_fail (processes != NULL);
 
-    struct Process *process;
+    matcher_free (self->priv->suspended);
+    self->priv->suspended = processes;
 
-    g_return_if_fail (self->priv->processes != NULL);
-    g_return_if_fail (processes != NULL);
+    update_freezer (self);
+}
+
+/**
+ * processes_suspend:
+ *
+ * Suspend processes
+ *
+ * @param #Processes
+ */
+void
+processes_suspend (Processes *self) {
+    /* Snapshot changed since last update, with proc connector,
+     * freezer is kept current from its events */
+    if (self->priv->snapshot != NULL)
+        update_freezer (self);
 
-    GFOREACH (self->priv->processes, process)
-        if (process_in_list (processes, process))
-            kill (process->pid, SIGSTOP);
+    freezer_freeze (self->priv->freezer);
 }
 
 /**
@@ -256,21 +452,25 @@ processes_suspend (Processes *self,
  * resume processes
  *
  * @param #Processes
- * @param processes: processes list
  *
  */
 void
-processes_resume (Processes *self,
-                  GList     *processes) {
-
-    struct Process *process;
-
-    g_return_if_fail (self->priv->processes != NULL);
-    g_return_if_fail (processes != NULL);
+processes_resume (Processes *self) {
+    freezer_thaw (self->priv->freezer);
+}
 
-    GFOREACH (self->priv->processes, process)
-        if (process_in_list (processes, process))
-            kill (process->pid, SIGCONT);
+/**
+ * processes_release:
+ *
+ * Give back suspended processes to their own cgroup, at end of screen
+ * off session
+ *
+ * @param #Processes
+ *
+ */
+void
+processes_release (Processes *self) {
+    freezer_release (self->priv->freezer);
 }
 
 /**
@@ -279,99 +479,74 @@ processes_resume (Processes *self,
  * Move processes to cpuset
  *
  * @param #Processes
- * @param names: processes list
+ * @param processes: processes names
  * @param #CpuSet
  *
  */
 void  processes_set_cpuset (Processes *self,
-                            GList     *processes,
+                            Matcher   *processes,
                             CpuSet     cpuset) {
-    struct Process *process;
-    const char *cpuset_path;
+    g_autoptr (WriterBatch) batch = NULL;
+    struct CpusetRequest request;
 
-    g_return_if_fail (self->priv->processes != NULL);
     g_return_if_fail (processes != NULL);
 
-    cpuset_path = get_cpuset_path (cpuset);
+    batch = writer_batch_new ();
 
-    GFOREACH (self->priv->processes, process) {
-        if (process_in_list (processes, process)) {
-            g_autofree char *pid_str = g_strdup_printf("%d", process->pid);
+    request.placement = self->priv->placement;
+    request.batch = batch;
+    request.cpuset = cpuset;
+    foreach_process_in_list (self, processes, add_to_cpuset, &request);
 
-            write_to_file (cpuset_path, pid_str);
-        }
-    }
+    writer_batch_submit (writer_get_default (), batch);
 }
 
 /**
  * processes_set_services_cpuset:
  *
- * Move service to background cpuset
+ * Move services to cpuset, background ones in cpu idle list are idle
  *
  * @param #Processes
- * @param cgrousp: cgroup list
+ * @param #Cgroups: services index
  * @param #CpuSet
  *
  */
 void  processes_set_services_cpuset (Processes  *self,
-                                     const char *cgroup_path,
-                                     GList      *services,
+                                     Cgroups    *cgroups,
                                      CpuSet      cpuset) {
+    g_autoptr (WriterBatch) batch = NULL;
+    GList *services = cgroups_get_services (cgroups);
     const char *service;
 
-    g_return_if_fail (services != NULL);
+    batch = writer_batch_new ();
 
     GFOREACH (services, service) {
-        GList *pids = NULL;
-        pid_t *pid;
-        const char *name;
-        const char *cpuset_path = NULL;
-        char *cgroup_procs = NULL;
-        GList *slices = NULL;
-
-        GFOREACH_SUB (self->priv->cpuset_blacklist, name) {
-            if (g_strrstr (service, name) != NULL) {
-                goto end_loop;
-            }
-        }
+        CpuSet service_cpuset = cpuset;
 
-        slices = get_cgroup_slices (cgroup_path);
-        GFOREACH_SUB (slices, name) {
-            cgroup_procs = g_build_filename (
-                name, service, "cgroup.procs", NULL
-            );
-            if (g_file_test (cgroup_procs, G_FILE_TEST_EXISTS))
-                break;
-            g_free (cgroup_procs);
-            cgroup_procs = NULL;
-        }
+        placement_set_cgroup_idle (
+            self->priv->placement,
+            cgroups_get_service_dir (cgroups, service),
+            cpuset == CPUSET_BACKGROUND &&
+                matcher_contains (self->priv->cpu_idle_services, service)
+        );
 
-        if (cgroup_procs == NULL)
+        if (matcher_match (self->priv->cpuset_blacklist, service))
             continue;
 
-        if (cpuset == CPUSET_FOREGROUND) {
-            GFOREACH_SUB (self->priv->cpuset_topapp, name) {
-                if (g_strcmp0 (service, name) == 0) {
-                    cpuset_path = get_cpuset_path (CPUSET_TOPAPP);
-                    break;
-                }
-            }
-        }
-
-        if (cpuset_path == NULL)
-            cpuset_path = get_cpuset_path (cpuset);
-
-        pids = get_cgroup_pids (cgroup_procs);
-        GFOREACH_SUB (pids, pid) {
-            g_autofree char *pid_str = g_strdup_printf("%d", *pid);
+        if (cpuset == CPUSET_FOREGROUND &&
+                matcher_contains (self->priv->cpuset_topapp, service))
+            service_cpuset = CPUSET_TOPAPP;
 
-            write_to_file (cpuset_path, pid_str);
-        }
-        g_list_free_full (pids, g_free);
-        g_list_free_full (slices, g_free);
-        g_free (cgroup_procs);
-end_loop:
+        placement_move_cgroup (
+            self->priv->placement,
+            batch,
+            cgroups_get_service_dir (cgroups, service),
+            service_cpuset
+        );
     }
+    g_list_free (services);
+
+    writer_batch_submit (writer_get_default (), batch);
 }
 
 
@@ -381,14 +556,14 @@ end_loop:
  * Set cpuset blacklist
  *
  * @param #Processes
- * @param blacklist: cgroup blacklist
+ * @param blacklist: cgroup blacklist (transfer full)
  *
  */
 void
 processes_cpuset_set_blacklist (Processes *self,
-                                GList     *blacklist)
+                                Matcher   *blacklist)
 {
-    g_list_free_full (self->priv->cpuset_blacklist, g_free);
+    matcher_free (self->priv->cpuset_blacklist);
 
     self->priv->cpuset_blacklist = blacklist;
 }
@@ -399,14 +574,94 @@ processes_cpuset_set_blacklist (Processes *self,
  * Set top-app cpuset
  *
  * @param #Processes
- * @param blacklist: cgroup blacklist
+ * @param topapp: top-app services (transfer full)
  *
  */
 void
 processes_cpuset_set_topapp (Processes *self,
-                             GList     *topapp)
+                             Matcher   *topapp)
 {
-    g_list_free_full (self->priv->cpuset_topapp, g_free);
+    matcher_free (self->priv->cpuset_topapp);
 
     self->priv->cpuset_topapp = topapp;
-}
\ No newline at end of file
+}
+
+/**
+ * processes_set_cpu_idle_services:
+ *
+ * Set services run at idle cpu priority in background
+ *
+ * @param #Processes
+ * @param services: service names (transfer full)
+ *
+ */
+void
+processes_set_cpu_idle_services (Processes *self,
+                                 Matcher   *services)
+{
+    matcher_free (self->priv->cpu_idle_services);
+
+    self->priv->cpu_idle_services = services;
+}
+
+/**
+ * processes_set_cpuset_layout:
+ *
+ * Set cpusets cpus, missing ones are computed from CPU topology
+ *
+ * @param #Processes
+ * @param layout: cpus by cpuset name, as a{ss}
+ *
+ */
+void
+processes_set_cpuset_layout (Processes *self,
+                             GVariant  *layout)
+{
+    placement_set_layout (self->priv->placement, layout);
+}
+
+/**
+ * processes_set_power_profile:
+ *
+ * Set power profile, used to clamp services utilization
+ *
+ * @param #Processes
+ * @param #PowerProfile
+ *
+ */
+void
+processes_set_power_profile (Processes    *self,
+                             PowerProfile  power_profile)
+{
+    placement_set_power_profile (self->priv->placement, power_profile);
+}
+
+/**
+ * processes_get_cpuset_layout:
+ *
+ * Get cpusets cpus
+ *
+ * @param #Processes
+ *
+ * Returns: (transfer floating): cpus by cpuset name, as a{ss}
+ */
+GVariant *
+processes_get_cpuset_layout (Processes *self)
+{
+    return placement_get_layout (self->priv->placement);
+}
+
+/**
+ * processes_is_hotplug_safe:
+ *
+ * Check cores can be parked without shrinking cpusets for good
+ *
+ * @param #Processes
+ *
+ * Returns: TRUE if cores can be parked
+ */
+gboolean
+processes_is_hotplug_safe (Processes *self)
+{
+    return placement_is_hotplug_safe (self->priv->placement);
+}
@@ -7,7 +7,9 @@
 
 #include <glib.h>
 #include <glib-object.h>
+#include "../common/cgroups.h"
 #include "../common/define.h"
+#include "../common/matcher.h"
 
 #define TYPE_PROCESSES \
     (processes_get_type ())
@@ -46,21 +48,29 @@ GType           processes_get_type                     (void) G_GNUC_CONST;
 
 GObject*        processes_new                          (void);
 void            processes_update                       (Processes  *self);
-void            processes_suspend                      (Processes  *self,
-                                                        GList      *processes);
-void            processes_resume                       (Processes  *self,
-                                                        GList      *processes);
+void            processes_set_suspended                (Processes  *self,
+                                                        Matcher    *processes);
+void            processes_suspend                      (Processes  *self);
+void            processes_resume                       (Processes  *self);
+void            processes_release                      (Processes  *self);
 void            processes_set_cpuset                   (Processes  *self,
-                                                        GList      *processes,
+                                                        Matcher    *processes,
                                                         CpuSet     cpuset);
 void            processes_set_services_cpuset          (Processes  *self,
-                                                        const char *cgroup_path,
-                                                        GList      *services,
+                                                        Cgroups    *cgroups,
                                                         CpuSet      cpuset);
 void            processes_cpuset_set_blacklist         (Processes  *self,
-                                                        GList      *blacklist);
+                                                        Matcher    *blacklist);
 void            processes_cpuset_set_topapp            (Processes  *self,
-                                                        GList      *topapp);
+                                                        Matcher    *topapp);
+void            processes_set_cpu_idle_services        (Processes  *self,
+                                                        Matcher    *services);
+void            processes_set_cpuset_layout            (Processes  *self,
+                                                        GVariant   *layout);
+GVariant       *processes_get_cpuset_layout            (Processes  *self);
+gboolean        processes_is_hotplug_safe              (Processes  *self);
+void            processes_set_power_profile            (Processes  *self,
+                                                        PowerProfile power_profile);
 
 G_END_DECLS
 
@@ -0,0 +1,391 @@
+/*
+ * Copyright Cedric Bellegarde <cedric.bellegarde@adishatz.org>
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <gio/gio.h>
+
+#include "capabilities.h"
+#include "topology.h"
+#include "../common/utils.h"
+
+#define CPU_DIR "/sys/devices/system/cpu"
+
+/*
+ * Clusters are cpufreq policies, sorted by capacity: first one is the
+ * little cluster, last one the big (or prime) cluster.
+ */
+
+struct _TopologyPrivate {
+    GList *clusters;
+    char *cpus;
+};
+
+G_DEFINE_TYPE_WITH_CODE (
+    Topology,
+    topology,
+    G_TYPE_OBJECT,
+    G_ADD_PRIVATE (Topology)
+)
+
+static char *
+format_cpu_list (guint *cpu_ids,
+                 guint  count)
+{
+    GString *cpus = g_string_new (NULL);
+    guint i = 0;
+
+    /* 0 1 2 3 6 -> 0-3,6 */
+    while (i < count) {
+        guint last = i;
+
+        while (last + 1 < count && cpu_ids[last + 1] == cpu_ids[last] + 1)
+            last++;
+
+        if (cpus->len > 0)
+            g_string_append_c (cpus, ',');
+        if (last == i)
+            g_string_append_printf (cpus, "%u", cpu_ids[i]);
+        else
+            g_string_append_printf (cpus, "%u-%u", cpu_ids[i], cpu_ids[last]);
+
+        i = last + 1;
+    }
+
+    return g_string_free (cpus, FALSE);
+}
+
+static gint
+compare_cpu_ids (gconstpointer a,
+                 gconstpointer b)
+{
+    return *(const guint *) a - *(const guint *) b;
+}
+
+static gint
+compare_clusters (gconstpointer a,
+                  gconstpointer b)
+{
+    const TopologyCluster *cluster_a = a;
+    const TopologyCluster *cluster_b = b;
+
+    if (cluster_a->capacity != cluster_b->capacity)
+        return cluster_a->capacity < cluster_b->capacity ? -1 : 1;
+
+    return compare_cpu_ids (cluster_a->cpu_ids, cluster_b->cpu_ids);
+}
+
+static void
+cluster_free (gpointer user_data)
+{
+    TopologyCluster *cluster = user_data;
+
+    g_free (cluster->policy);
+    g_free (cluster->cpus);
+    g_free (cluster->cpu_ids);
+    g_free (cluster);
+}
+
+static guint
+read_uint (const char *path)
+{
+    g_autofree char *filename = get_root_path (path);
+    g_autofree char *contents = capabilities_read (
+        capabilities_get_default (), filename
+    );
+
+    if (contents == NULL)
+        return 0;
+
+    return strtoul (contents, NULL, 10);
+}
+
+static TopologyCluster *
+read_cluster (const char *policy)
+{
+    g_autofree char *sysfs_dir = get_root_path (CPUFREQ_POLICIES_DIR);
+    g_autofree char *related_cpus_path = NULL;
+    g_autofree char *related_cpus = NULL;
+    g_autofree char *capacity_path = NULL;
+    g_autofree char *max_freq_path = NULL;
+    TopologyCluster *cluster;
+    GArray *cpu_ids;
+    char *cpu;
+    char *end;
+
+    related_cpus_path = g_build_filename (
+        sysfs_dir, policy, "related_cpus", NULL
+    );
+    related_cpus = capabilities_read (
+        capabilities_get_default (), related_cpus_path
+    );
+    if (related_cpus == NULL)
+        return NULL;
+
+    /* related_cpus: 0 1 2 3 */
+    cpu_ids = g_array_new (FALSE, FALSE, sizeof (guint));
+    for (cpu = related_cpus; ; cpu = end) {
+        guint cpu_id = strtoul (cpu, &end, 10);
+
+        if (end == cpu)
+            break;
+        g_array_append_val (cpu_ids, cpu_id);
+    }
+
+    if (cpu_ids->len == 0) {
+        g_array_free (cpu_ids, TRUE);
+        return NULL;
+    }
+    g_array_sort (cpu_ids, compare_cpu_ids);
+
+    cluster = g_new0 (TopologyCluster, 1);
+    cluster->policy = g_strdup (policy);
+    cluster->cpus_count = cpu_ids->len;
+    cluster->cpu_ids = (guint *) g_array_free (cpu_ids, FALSE);
+    cluster->cpus = format_cpu_list (cluster->cpu_ids, cluster->cpus_count);
+
+    /* No capacity on symmetric systems, max frequency is a good hint */
+    capacity_path = g_strdup_printf (
+        CPU_DIR "/cpu%u/cpu_capacity", cluster->cpu_ids[0]
+    );
+    cluster->capacity = read_uint (capacity_path);
+    if (cluster->capacity == 0) {
+        max_freq_path = g_build_filename (
+            CPUFREQ_POLICIES_DIR, policy, "cpuinfo_max_freq", NULL
+        );
+        cluster->capacity = read_uint (max_freq_path);
+    }
+
+    return cluster;
+}
+
+static void
+detect_clusters (Topology *self)
+{
+    g_autoptr (GDir) policies_dir = NULL;
+    g_autofree char *sysfs_dir = get_root_path (CPUFREQ_POLICIES_DIR);
+    g_autofree guint *cpu_ids = NULL;
+    TopologyCluster *cluster;
+    const char *policy;
+    guint count = 0;
+
+    policies_dir = g_dir_open (sysfs_dir, 0, NULL);
+    if (policies_dir != NULL) {
+        while ((policy = g_dir_read_name (policies_dir)) != NULL) {
+            cluster = read_cluster (policy);
+            if (cluster != NULL)
+                self->priv->clusters = g_list_prepend (
+                    self->priv->clusters, cluster
+                );
+        }
+    }
+
+    self->priv->clusters = g_list_sort (
+        self->priv->clusters, compare_clusters
+    );
+
+    GFOREACH (self->priv->clusters, cluster)
+        count += cluster->cpus_count;
+
+    if (count == 0) {
+        g_autofree char *online_path = get_root_path (CPU_DIR "/online");
+
+        if (!g_file_get_contents (online_path, &self->priv->cpus, NULL, NULL))
+            self->priv->cpus = g_strdup ("0");
+        g_strstrip (self->priv->cpus);
+        return;
+    }
+
+    cpu_ids = g_new (guint, count);
+    count = 0;
+    GFOREACH (self->priv->clusters, cluster) {
+        memcpy (
+            cpu_ids + count,
+            cluster->cpu_ids,
+            cluster->cpus_count * sizeof (guint)
+        );
+        count += cluster->cpus_count;
+    }
+    qsort (cpu_ids, count, sizeof (guint), compare_cpu_ids);
+    self->priv->cpus = format_cpu_list (cpu_ids, count);
+
+    GFOREACH (self->priv->clusters, cluster)
+        g_message (
+            "CPU cluster %s: cpus %s, capacity %u",
+            cluster->policy, cluster->cpus, cluster->capacity
+        );
+}
+
+static void
+topology_dispose (GObject *topology)
+{
+    G_OBJECT_CLASS (topology_parent_class)->dispose (topology);
+}
+
+static void
+topology_finalize (GObject *topology)
+{
+    Topology *self = TOPOLOGY (topology);
+
+    g_list_free_full (self->priv->clusters, cluster_free);
+    g_free (self->priv->cpus);
+
+    G_OBJECT_CLASS (topology_parent_class)->finalize (topology);
+}
+
+static void
+topology_class_init (TopologyClass *klass)
+{
+    GObjectClass *object_class;
+
+    object_class = G_OBJECT_CLASS (klass);
+    object_class->dispose = topology_dispose;
+    object_class->finalize = topology_finalize;
+}
+
+static void
+topology_init (Topology *self)
+{
+    self->priv = topology_get_instance_private (self);
+
+    self->priv->clusters = NULL;
+    self->priv->cpus = NULL;
+
+    detect_clusters (self);
+}
+
+/**
+ * topology_new:
+ *
+ * Creates a new #Topology
+ *
+ * Returns: (transfer full): a new #Topology
+ *
+ **/
+GObject *
+topology_new (void)
+{
+    GObject *topology;
+
+    topology = g_object_new (TYPE_TOPOLOGY, NULL);
+
+    return topology;
+}
+
+static Topology *default_topology = NULL;
+/**
+ * topology_get_default:
+ *
+ * Gets the default #Topology.
+ *
+ * Return value: (transfer none): the default #Topology.
+ */
+Topology *
+topology_get_default (void)
+{
+    if (default_topology == NULL)
+        default_topology = TOPOLOGY (topology_new ());
+
+    return default_topology;
+}
+
+/**
+ * topology_free_default:
+ *
+ * Free the default #Topology.
+ *
+ */
+void
+topology_free_default (void)
+{
+    g_clear_object (&default_topology);
+}
+
+/**
+ * topology_get_clusters:
+ *
+ * Get CPU clusters, from little to big
+ *
+ * @self: a #Topology
+ *
+ * Returns: (transfer none) (element-type TopologyCluster): clusters
+ */
+GList *
+topology_get_clusters (Topology *self)
+{
+    return self->priv->clusters;
+}
+
+/**
+ * topology_get_cpus:
+ *
+ * Get all cpus
+ *
+ * @self: a #Topology
+ *
+ * Returns: (transfer none): cpus list, like 0-7
+ */
+const char *
+topology_get_cpus (Topology *self)
+{
+    return self->priv->cpus;
+}
+
+/**
+ * topology_get_cpuset_cpus:
+ *
+ * Get cpus a cpuset should use on this topology:
+ * - background: half the little cluster
+ * - system-background: the little cluster
+ * - foreground: all cpus but the prime cluster, if any
+ * - top-app: all cpus
+ *
+ * @self: a #Topology
+ * @cpuset: a #CpuSet
+ *
+ * Returns: (transfer full): cpus list
+ */
+char *
+topology_get_cpuset_cpus (Topology *self,
+                          CpuSet    cpuset)
+{
+    guint clusters_count = g_list_length (self->priv->clusters);
+    TopologyCluster *little;
+    TopologyCluster *cluster;
+    GArray *cpu_ids;
+    GList *item;
+    char *cpus;
+
+    if (clusters_count == 0)
+        return g_strdup (self->priv->cpus);
+
+    little = self->priv->clusters->data;
+
+    switch (cpuset) {
+    case CPUSET_BACKGROUND:
+        return format_cpu_list (
+            little->cpu_ids, (little->cpus_count + 1) / 2
+        );
+    case CPUSET_SYSTEM_BACKGROUND:
+        return g_strdup (little->cpus);
+    case CPUSET_FOREGROUND:
+        if (clusters_count < 3)
+            return g_strdup (self->priv->cpus);
+
+        cpu_ids = g_array_new (FALSE, FALSE, sizeof (guint));
+        for (item = self->priv->clusters; item->next != NULL; item = item->next) {
+            cluster = item->data;
+            g_array_append_vals (cpu_ids, cluster->cpu_ids, cluster->cpus_count);
+        }
+        g_array_sort (cpu_ids, compare_cpu_ids);
+        cpus = format_cpu_list ((guint *) cpu_ids->data, cpu_ids->len);
+        g_array_free (cpu_ids, TRUE);
+
+        return cpus;
+    case CPUSET_TOPAPP:
+    default:
+        return g_strdup (self->priv->cpus);
+    }
+}
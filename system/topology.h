@@ -0,0 +1,65 @@
+/*
+ * Copyright Cedric Bellegarde <cedric.bellegarde@adishatz.org>
+ */
+
+#ifndef TOPOLOGY_H
+#define TOPOLOGY_H
+
+#include <glib.h>
+#include <glib-object.h>
+#include "../common/define.h"
+
+#define TYPE_TOPOLOGY \
+    (topology_get_type ())
+#define TOPOLOGY(obj) \
+    (G_TYPE_CHECK_INSTANCE_CAST \
+    ((obj), TYPE_TOPOLOGY, Topology))
+#define TOPOLOGY_CLASS(cls) \
+    (G_TYPE_CHECK_CLASS_CAST \
+    ((cls), TYPE_TOPOLOGY, TopologyClass))
+#define IS_TOPOLOGY(obj) \
+    (G_TYPE_CHECK_INSTANCE_TYPE \
+    ((obj), TYPE_TOPOLOGY))
+#define IS_TOPOLOGY_CLASS(cls) \
+    (G_TYPE_CHECK_CLASS_TYPE \
+    ((cls), TYPE_TOPOLOGY))
+#define TOPOLOGY_GET_CLASS(obj) \
+    (G_TYPE_INSTANCE_GET_CLASS \
+    ((obj), TYPE_TOPOLOGY, TopologyClass))
+
+G_BEGIN_DECLS
+
+typedef struct _Topology Topology;
+typedef struct _TopologyClass TopologyClass;
+typedef struct _TopologyPrivate TopologyPrivate;
+
+typedef struct {
+    char *policy;
+    char *cpus;
+    guint *cpu_ids;
+    guint cpus_count;
+    guint capacity;
+} TopologyCluster;
+
+struct _Topology {
+    GObject parent;
+    TopologyPrivate *priv;
+};
+
+struct _TopologyClass {
+    GObjectClass parent_class;
+};
+
+GType           topology_get_type            (void) G_GNUC_CONST;
+
+GObject*        topology_new                 (void);
+Topology       *topology_get_default         (void);
+void            topology_free_default        (void);
+GList          *topology_get_clusters        (Topology   *self);
+const char     *topology_get_cpus            (Topology   *self);
+char           *topology_get_cpuset_cpus     (Topology   *self,
+                                              CpuSet      cpuset);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,344 @@
+/*
+ * Copyright Cedric Bellegarde <cedric.bellegarde@adishatz.org>
+ */
+
+#include <gio/gio.h>
+
+#include "transitions.h"
+#include "../common/utils.h"
+
+/*
+ * The main loop only talks to D-Bus and logind: everything touching
+ * sysfs, procfs and cgroups runs on a worker thread, owning its own
+ * main context (proc connector and inotify sources are attached there).
+ *
+ * Jobs are queued, the worker runs them in order. A transition is a
+ * list of stages: queuing a new transition supersedes the queued or
+ * running ones, their remaining stages are dropped.
+ */
+
+typedef struct {
+    const char *name;
+    TransitionFunc func;
+} Stage;
+
+struct _Transition {
+    char *name;
+    GList *stages;
+    gpointer user_data;
+    GDestroyNotify destroy;
+
+    /* 0 for jobs that can't be superseded */
+    gint generation;
+
+    /* Set for synchronous jobs */
+    GMutex *mutex;
+    GCond *cond;
+    gboolean *done;
+};
+
+struct _TransitionsPrivate {
+    GThread *thread;
+    GMainContext *context;
+    GMainLoop *loop;
+    GAsyncQueue *queue;
+
+    gint generation;
+};
+
+G_DEFINE_TYPE_WITH_CODE (
+    Transitions,
+    transitions,
+    G_TYPE_OBJECT,
+    G_ADD_PRIVATE (Transitions)
+)
+
+static void
+transition_free (Transition *transition)
+{
+    g_list_free_full (transition->stages, g_free);
+    if (transition->destroy != NULL)
+        transition->destroy (transition->user_data);
+    g_free (transition->name);
+    g_free (transition);
+}
+
+static gboolean
+is_superseded (Transitions *self,
+               Transition  *transition)
+{
+    return transition->generation != 0 &&
+        transition->generation != g_atomic_int_get (&self->priv->generation);
+}
+
+static void
+run_transition (Transitions *self,
+                Transition  *transition)
+{
+    Stage *stage;
+
+    GFOREACH (transition->stages, stage) {
+        if (is_superseded (self, transition)) {
+            g_message (
+                "Transition %s superseded before %s",
+                transition->name, stage->name
+            );
+            break;
+        }
+        stage->func (transition->user_data);
+    }
+
+    if (transition->done != NULL) {
+        g_mutex_lock (transition->mutex);
+        *transition->done = TRUE;
+        g_cond_signal (transition->cond);
+        g_mutex_unlock (transition->mutex);
+    }
+}
+
+static gboolean
+on_queue_ready (gpointer user_data)
+{
+    Transitions *self = TRANSITIONS (user_data);
+    Transition *transition;
+
+    while ((transition = g_async_queue_try_pop (self->priv->queue)) != NULL) {
+        run_transition (self, transition);
+        transition_free (transition);
+    }
+
+    return G_SOURCE_REMOVE;
+}
+
+static void
+push (Transitions *self,
+      Transition  *transition)
+{
+    GSource *source = g_idle_source_new ();
+
+    g_async_queue_push (self->priv->queue, transition);
+
+    /* Not g_main_context_invoke(): never run nested in a stage */
+    g_source_set_callback (source, on_queue_ready, self, NULL);
+    g_source_attach (source, self->priv->context);
+    g_source_unref (source);
+}
+
+static void
+quit_loop (gpointer user_data)
+{
+    g_main_loop_quit (user_data);
+}
+
+static gpointer
+worker_thread (gpointer user_data)
+{
+    Transitions *self = TRANSITIONS (user_data);
+
+    g_main_context_push_thread_default (self->priv->context);
+    g_main_loop_run (self->priv->loop);
+    g_main_context_pop_thread_default (self->priv->context);
+
+    return NULL;
+}
+
+static void
+transitions_dispose (GObject *transitions)
+{
+    Transitions *self = TRANSITIONS (transitions);
+
+    if (self->priv->thread != NULL) {
+        transitions_run (self, quit_loop, self->priv->loop, NULL);
+        g_thread_join (self->priv->thread);
+        self->priv->thread = NULL;
+    }
+
+    G_OBJECT_CLASS (transitions_parent_class)->dispose (transitions);
+}
+
+static void
+transitions_finalize (GObject *transitions)
+{
+    Transitions *self = TRANSITIONS (transitions);
+
+    g_async_queue_unref (self->priv->queue);
+    g_main_loop_unref (self->priv->loop);
+    g_main_context_unref (self->priv->context);
+
+    G_OBJECT_CLASS (transitions_parent_class)->finalize (transitions);
+}
+
+static void
+transitions_class_init (TransitionsClass *klass)
+{
+    GObjectClass *object_class;
+
+    object_class = G_OBJECT_CLASS (klass);
+    object_class->dispose = transitions_dispose;
+    object_class->finalize = transitions_finalize;
+}
+
+static void
+transitions_init (Transitions *self)
+{
+    self->priv = transitions_get_instance_private (self);
+
+    self->priv->generation = 0;
+    self->priv->context = g_main_context_new ();
+    self->priv->loop = g_main_loop_new (self->priv->context, FALSE);
+    self->priv->queue = g_async_queue_new_full (
+        (GDestroyNotify) transition_free
+    );
+    self->priv->thread = g_thread_new ("transitions", worker_thread, self);
+}
+
+/**
+ * transition_new:
+ *
+ * Creates a new #Transition, stages will be called with user_data
+ *
+ * @name: transition name, for logs
+ * @user_data: stages data
+ * @destroy: (nullable): user_data destroy function
+ *
+ * Returns: (transfer full): a new #Transition
+ *
+ **/
+Transition *
+transition_new (const char     *name,
+                gpointer        user_data,
+                GDestroyNotify  destroy)
+{
+    Transition *transition = g_new0 (Transition, 1);
+
+    transition->name = g_strdup (name);
+    transition->user_data = user_data;
+    transition->destroy = destroy;
+
+    return transition;
+}
+
+/**
+ * transition_add_stage:
+ *
+ * Append a stage to transition
+ *
+ * @transition: a #Transition
+ * @name: (transfer none): stage name, a static string
+ * @func: stage function
+ *
+ **/
+void
+transition_add_stage (Transition     *transition,
+                      const char     *name,
+                      TransitionFunc  func)
+{
+    Stage *stage = g_new (Stage, 1);
+
+    stage->name = name;
+    stage->func = func;
+
+    transition->stages = g_list_append (transition->stages, stage);
+}
+
+/**
+ * transitions_new:
+ *
+ * Creates a new #Transitions engine and its worker thread
+ *
+ * Returns: (transfer full): a new #Transitions
+ *
+ **/
+GObject *
+transitions_new (void)
+{
+    GObject *transitions;
+
+    transitions = g_object_new (TYPE_TRANSITIONS, NULL);
+
+    return transitions;
+}
+
+/**
+ * transitions_queue:
+ *
+ * Queue transition on worker, superseding previous transitions
+ *
+ * @self: a #Transitions
+ * @transition: (transfer full): a #Transition
+ *
+ **/
+void
+transitions_queue (Transitions *self,
+                   Transition  *transition)
+{
+    transition->generation = g_atomic_int_add (
+        &self->priv->generation, 1
+    ) + 1;
+
+    push (self, transition);
+}
+
+/**
+ * transitions_run:
+ *
+ * Run func on worker, after queued jobs. It can't be superseded.
+ *
+ * @self: a #Transitions
+ * @func: function to run
+ * @user_data: func data
+ * @destroy: (nullable): user_data destroy function
+ *
+ **/
+void
+transitions_run (Transitions    *self,
+                 TransitionFunc  func,
+                 gpointer        user_data,
+                 GDestroyNotify  destroy)
+{
+    Transition *transition = transition_new ("job", user_data, destroy);
+
+    transition_add_stage (transition, "job", func);
+    push (self, transition);
+}
+
+/**
+ * transitions_run_sync:
+ *
+ * Run func on worker, after queued jobs, and wait for it.
+ * Must not be called from worker.
+ *
+ * @self: a #Transitions
+ * @func: function to run
+ * @user_data: func data
+ *
+ **/
+void
+transitions_run_sync (Transitions    *self,
+                      TransitionFunc  func,
+                      gpointer        user_data)
+{
+    Transition *transition = transition_new ("sync", user_data, NULL);
+    GMutex mutex;
+    GCond cond;
+    gboolean done = FALSE;
+
+    g_return_if_fail (g_thread_self () != self->priv->thread);
+
+    g_mutex_init (&mutex);
+    g_cond_init (&cond);
+
+    transition_add_stage (transition, "sync", func);
+    transition->mutex = &mutex;
+    transition->cond = &cond;
+    transition->done = &done;
+
+    g_mutex_lock (&mutex);
+    push (self, transition);
+    while (!done)
+        g_cond_wait (&cond, &mutex);
+    g_mutex_unlock (&mutex);
+
+    g_mutex_clear (&mutex);
+    g_cond_clear (&cond);
+}
@@ -0,0 +1,70 @@
+/*
+ * Copyright Cedric Bellegarde <cedric.bellegarde@adishatz.org>
+ */
+
+#ifndef TRANSITIONS_H
+#define TRANSITIONS_H
+
+#include <glib.h>
+#include <glib-object.h>
+
+#define TYPE_TRANSITIONS \
+    (transitions_get_type ())
+#define TRANSITIONS(obj) \
+    (G_TYPE_CHECK_INSTANCE_CAST \
+    ((obj), TYPE_TRANSITIONS, Transitions))
+#define TRANSITIONS_CLASS(cls) \
+    (G_TYPE_CHECK_CLASS_CAST \
+    ((cls), TYPE_TRANSITIONS, TransitionsClass))
+#define IS_TRANSITIONS(obj) \
+    (G_TYPE_CHECK_INSTANCE_TYPE \
+    ((obj), TYPE_TRANSITIONS))
+#define IS_TRANSITIONS_CLASS(cls) \
+    (G_TYPE_CHECK_CLASS_TYPE \
+    ((cls), TYPE_TRANSITIONS))
+#define TRANSITIONS_GET_CLASS(obj) \
+    (G_TYPE_INSTANCE_GET_CLASS \
+    ((obj), TYPE_TRANSITIONS, TransitionsClass))
+
+G_BEGIN_DECLS
+
+typedef void (*TransitionFunc) (gpointer user_data);
+
+typedef struct _Transition Transition;
+
+typedef struct _Transitions Transitions;
+typedef struct _TransitionsClass TransitionsClass;
+typedef struct _TransitionsPrivate TransitionsPrivate;
+
+struct _Transitions {
+    GObject parent;
+    TransitionsPrivate *priv;
+};
+
+struct _TransitionsClass {
+    GObjectClass parent_class;
+};
+
+Transition      *transition_new              (const char      *name,
+                                              gpointer         user_data,
+                                              GDestroyNotify   destroy);
+void             transition_add_stage        (Transition      *transition,
+                                              const char      *name,
+                                              TransitionFunc   func);
+
+GType            transitions_get_type        (void) G_GNUC_CONST;
+
+GObject*         transitions_new             (void);
+void             transitions_queue           (Transitions     *self,
+                                              Transition      *transition);
+void             transitions_run             (Transitions     *self,
+                                              TransitionFunc   func,
+                                              gpointer         user_data,
+                                              GDestroyNotify   destroy);
+void             transitions_run_sync        (Transitions     *self,
+                                              TransitionFunc   func,
+                                              gpointer         user_data);
+
+G_END_DECLS
+
+#endif
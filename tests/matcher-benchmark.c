@@ -0,0 +1,139 @@
+/*
+ * Copyright Cedric Bellegarde <cedric.bellegarde@adishatz.org>
+ */
+
+#include <stdlib.h>
+
+#include <glib.h>
+
+#include "../common/matcher.h"
+
+/*
+ * Matches a process table worth of cmdlines against a blacklist, once
+ * with a g_strrstr() per pattern, as before, then with the automaton.
+ */
+
+#define PROCESSES 2000
+#define PATTERNS 50
+#define ROUNDS 20
+
+static GPtrArray *
+create_cmdlines (guint count)
+{
+    GPtrArray *cmdlines = g_ptr_array_new_with_free_func (g_free);
+    guint i;
+
+    for (i = 0; i < count; i++)
+        g_ptr_array_add (
+            cmdlines,
+            g_strdup_printf (
+                "/usr/libexec/process-%u --session --fd=%u --log-level=info",
+                i, i % 16
+            )
+        );
+
+    return cmdlines;
+}
+
+static GList *
+create_patterns (guint count)
+{
+    GList *patterns = NULL;
+    guint i;
+
+    /* Mostly misses, as in a real blacklist */
+    for (i = 0; i < count; i++)
+        patterns = g_list_prepend (
+            patterns, g_strdup_printf ("blacklisted-daemon-%u", i)
+        );
+    patterns = g_list_prepend (patterns, g_strdup ("process-1999 "));
+
+    return patterns;
+}
+
+static gdouble
+run_strrstr (GPtrArray *cmdlines,
+             GList     *patterns,
+             guint     *matches)
+{
+    gint64 start = g_get_monotonic_time ();
+    guint round;
+    guint i;
+
+    *matches = 0;
+    for (round = 0; round < ROUNDS; round++) {
+        for (i = 0; i < cmdlines->len; i++) {
+            const char *cmdline = g_ptr_array_index (cmdlines, i);
+            GList *pattern;
+
+            for (pattern = patterns; pattern != NULL; pattern = pattern->next) {
+                if (g_strrstr (cmdline, pattern->data) != NULL) {
+                    (*matches)++;
+                    break;
+                }
+            }
+        }
+    }
+
+    return (gdouble) (g_get_monotonic_time () - start) / ROUNDS;
+}
+
+static gdouble
+run_matcher (GPtrArray *cmdlines,
+             Matcher   *matcher,
+             guint     *matches)
+{
+    gint64 start = g_get_monotonic_time ();
+    guint round;
+    guint i;
+
+    *matches = 0;
+    for (round = 0; round < ROUNDS; round++)
+        for (i = 0; i < cmdlines->len; i++)
+            if (matcher_match (matcher, g_ptr_array_index (cmdlines, i)))
+                (*matches)++;
+
+    return (gdouble) (g_get_monotonic_time () - start) / ROUNDS;
+}
+
+gint
+main (gint argc, char *argv[])
+{
+    g_autoptr (GPtrArray) cmdlines = NULL;
+    g_autoptr (Matcher) matcher = NULL;
+    GList *patterns;
+    guint processes = argc > 1 ? strtoul (argv[1], NULL, 10) : PROCESSES;
+    guint count = argc > 2 ? strtoul (argv[2], NULL, 10) : PATTERNS;
+    guint strrstr_matches;
+    guint matcher_matches;
+    gdouble strrstr_time;
+    gdouble matcher_time;
+    gint64 start;
+
+    cmdlines = create_cmdlines (processes);
+    patterns = create_patterns (count);
+
+    start = g_get_monotonic_time ();
+    matcher = matcher_new_from_list (patterns);
+    g_print (
+        "%u processes, %u patterns, compiled in %" G_GINT64_FORMAT " us\n",
+        processes, g_list_length (patterns), g_get_monotonic_time () - start
+    );
+
+    strrstr_time = run_strrstr (cmdlines, patterns, &strrstr_matches);
+    matcher_time = run_matcher (cmdlines, matcher, &matcher_matches);
+
+    g_print ("g_strrstr():     %8.0f us\n", strrstr_time);
+    g_print ("matcher_match(): %8.0f us\n", matcher_time);
+
+    g_list_free_full (patterns, g_free);
+
+    if (strrstr_matches != matcher_matches) {
+        g_printerr (
+            "Matches differ: %u != %u\n", strrstr_matches, matcher_matches
+        );
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,178 @@
+/*
+ * Copyright Cedric Bellegarde <cedric.bellegarde@adishatz.org>
+ */
+
+#include <stdlib.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "../system/proc_scanner.h"
+
+/*
+ * Scans a /proc tree built by sh/mps-fake-root, once with a GDir and a
+ * g_file_get_contents() per cmdline, as before, then with the scanner:
+ * pids only, all cmdlines inline and with a thread pool.
+ */
+
+#define PIDS "10000"
+#define ROUNDS 20
+#define THREADS 4
+
+static char *
+create_fake_root (const char *fake_root_script)
+{
+    g_autoptr (GError) error = NULL;
+    g_autofree char *root = NULL;
+    gint status;
+    const char *argv[] = {
+        "/bin/bash", fake_root_script,
+        "-p", "1", "-c", "1", "-d", "0",
+        "-s", "100", "-u", "50", "-a", "20", "-n", PIDS,
+        NULL, NULL
+    };
+
+    root = g_dir_make_tmp ("mps-proc-XXXXXX", &error);
+    if (root == NULL)
+        g_error ("%s", error->message);
+
+    argv[G_N_ELEMENTS (argv) - 2] = root;
+    if (!g_spawn_sync (NULL, (char **) argv, NULL, G_SPAWN_STDOUT_TO_DEV_NULL,
+                       NULL, NULL, NULL, NULL, &status, &error))
+        g_error ("%s", error->message);
+    if (!g_spawn_check_wait_status (status, &error))
+        g_error ("%s", error->message);
+
+    return g_steal_pointer (&root);
+}
+
+static void
+remove_tree (const char *path)
+{
+    g_autoptr (GDir) dir = g_dir_open (path, 0, NULL);
+    const char *name;
+
+    if (dir != NULL) {
+        while ((name = g_dir_read_name (dir)) != NULL) {
+            g_autofree char *child = g_build_filename (path, name, NULL);
+
+            remove_tree (child);
+        }
+    }
+    g_remove (path);
+}
+
+static gdouble
+run_legacy (const char *proc_path,
+            guint       rounds,
+            guint      *length)
+{
+    gint64 start = g_get_monotonic_time ();
+    guint round;
+
+    for (round = 0; round < rounds; round++) {
+        g_autoptr (GDir) dir = g_dir_open (proc_path, 0, NULL);
+        g_autoptr (GPtrArray) cmdlines = g_ptr_array_new_with_free_func (
+            g_free
+        );
+        const char *name;
+
+        while ((name = g_dir_read_name (dir)) != NULL) {
+            g_autofree char *cmdline = g_build_filename (
+                proc_path, name, "cmdline", NULL
+            );
+            char *contents = NULL;
+
+            if (!g_ascii_isdigit (*name))
+                continue;
+
+            g_file_get_contents (cmdline, &contents, NULL, NULL);
+            g_ptr_array_add (cmdlines, contents);
+        }
+        *length = cmdlines->len;
+    }
+
+    return (gdouble) (g_get_monotonic_time () - start) / rounds;
+}
+
+static gdouble
+run_scanner (ProcScanner *scanner,
+             gboolean     cmdlines,
+             guint        rounds,
+             guint       *length,
+             gdouble     *free_time)
+{
+    gint64 start = g_get_monotonic_time ();
+    gint64 freed = 0;
+    guint round;
+
+    for (round = 0; round < rounds; round++) {
+        ProcSnapshot *snapshot = proc_scanner_scan (scanner);
+        gint64 free_start;
+
+        if (cmdlines)
+            proc_snapshot_load_cmdlines (snapshot);
+        *length = proc_snapshot_length (snapshot);
+
+        free_start = g_get_monotonic_time ();
+        proc_snapshot_free (snapshot);
+        freed += g_get_monotonic_time () - free_start;
+    }
+
+    *free_time = (gdouble) freed / rounds;
+
+    return (gdouble) (g_get_monotonic_time () - start) / rounds;
+}
+
+gint
+main (gint argc, char *argv[])
+{
+    g_autoptr (ProcScanner) inline_scanner = NULL;
+    g_autoptr (ProcScanner) pool_scanner = NULL;
+    g_autofree char *root = NULL;
+    g_autofree char *proc_path = NULL;
+    guint rounds = argc > 2 ? strtoul (argv[2], NULL, 10) : ROUNDS;
+    guint legacy_length = 0;
+    guint length = 0;
+    gdouble free_time;
+
+    if (argc < 2)
+        g_error ("Usage: %s mps-fake-root [rounds]", argv[0]);
+
+    root = create_fake_root (argv[1]);
+    proc_path = g_build_filename (root, "proc", NULL);
+    inline_scanner = proc_scanner_new (proc_path, 1);
+    pool_scanner = proc_scanner_new (proc_path, THREADS);
+
+    /* Warm up dentries and page cache */
+    run_legacy (proc_path, 1, &legacy_length);
+
+    g_print ("%u pids, %u rounds\n", legacy_length, rounds);
+    g_print (
+        "g_dir + cmdlines:      %8.0f us\n",
+        run_legacy (proc_path, rounds, &legacy_length)
+    );
+    g_print (
+        "scan, pids only:       %8.0f us\n",
+        run_scanner (inline_scanner, FALSE, rounds, &length, &free_time)
+    );
+    g_print (
+        "scan + cmdlines:       %8.0f us\n",
+        run_scanner (inline_scanner, TRUE, rounds, &length, &free_time)
+    );
+    g_print (
+        "scan + cmdlines (%u):   %8.0f us\n",
+        THREADS,
+        run_scanner (pool_scanner, TRUE, rounds, &length, &free_time)
+    );
+    g_print ("snapshot free:         %8.0f us\n", free_time);
+
+    remove_tree (root);
+
+    if (length != legacy_length) {
+        g_printerr ("Pids differ: %u != %u\n", legacy_length, length);
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
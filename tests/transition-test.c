@@ -0,0 +1,282 @@
+/*
+ * Copyright Cedric Bellegarde <cedric.bellegarde@adishatz.org>
+ */
+
+#include <stdlib.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "../system/cpufreq.h"
+#include "../system/devfreq.h"
+#include "../system/kernel_settings.h"
+#include "../system/processes.h"
+#include "../common/cgroups.h"
+#include "../common/define.h"
+#include "../common/reconciler.h"
+#include "../common/units.h"
+#include "../common/utils.h"
+
+/*
+ * Runs a screen off then a screen on transition against a tree built by
+ * sh/mps-fake-root, stages in manager order, and checks knobs.
+ *
+ * Fake tree: three policies (little, mid, prime), frequencies up to
+ * 2400000, devfreq up to 400000000, 16 cgroups sharing
+ * pids 1000-1049 round robin: pid 1003 is in service3.service.
+ */
+
+#define SERVICE_CGROUP "/sys/fs/cgroup/system.slice/service3.service"
+#define FROZEN_CGROUP \
+    "/sys/fs/cgroup/system.slice/mobile-power-saver-system.service/frozen"
+
+typedef struct {
+    Cpufreq *cpufreq;
+    Devfreq *devfreq;
+    KernelSettings *kernel_settings;
+    Processes *processes;
+} Transition;
+
+static const char *fake_root_script = NULL;
+static char *root = NULL;
+static Transition transition;
+
+static char *
+read_knob (const char *path)
+{
+    g_autofree char *filename = g_build_filename (root, path, NULL);
+    g_autoptr (GError) error = NULL;
+    char *contents = NULL;
+
+    if (!g_file_get_contents (filename, &contents, NULL, &error))
+        g_error ("Can't read %s: %s", filename, error->message);
+
+    return g_strstrip (contents);
+}
+
+#define assert_knob(path, expected) G_STMT_START {  \
+    g_autofree char *value = read_knob (path);      \
+    g_assert_cmpstr (value, ==, expected);          \
+} G_STMT_END
+
+static void
+remove_tree (const char *path)
+{
+    g_autoptr (GDir) dir = g_dir_open (path, 0, NULL);
+    const char *name;
+
+    if (dir != NULL) {
+        while ((name = g_dir_read_name (dir)) != NULL) {
+            g_autofree char *child = g_build_filename (path, name, NULL);
+
+            remove_tree (child);
+        }
+    }
+    g_remove (path);
+}
+
+static void
+create_fake_root (void)
+{
+    g_autoptr (GError) error = NULL;
+    gint status;
+    const char *argv[] = {
+        "/bin/bash", fake_root_script,
+        "-p", "3", "-c", "2", "-d", "2",
+        "-s", "10", "-u", "4", "-a", "2", "-n", "50",
+        NULL, NULL
+    };
+
+    root = g_dir_make_tmp ("mps-root-XXXXXX", &error);
+    g_assert_no_error (error);
+
+    argv[G_N_ELEMENTS (argv) - 2] = root;
+    g_spawn_sync (
+        NULL, (char **) argv, NULL, G_SPAWN_STDOUT_TO_DEV_NULL,
+        NULL, NULL, NULL, NULL, &status, &error
+    );
+    g_assert_no_error (error);
+    g_assert_true (g_spawn_check_wait_status (status, NULL));
+
+    set_root_dir (root);
+}
+
+static Matcher *
+new_matcher (const char *name)
+{
+    g_autoptr (GList) names = g_list_append (NULL, (gpointer) name);
+
+    return matcher_new_from_list (names);
+}
+
+static void
+test_screen_off (void)
+{
+    g_autoptr (Matcher) background = new_matcher ("process1007");
+
+    transition.cpufreq = CPUFREQ (cpufreq_new ());
+    transition.devfreq = DEVFREQ (devfreq_new ());
+    transition.kernel_settings = KERNEL_SETTINGS (kernel_settings_new ());
+    transition.processes = PROCESSES (processes_new ());
+
+    /* Sized from topology at start */
+    assert_knob ("/dev/cpuset/background/cpus", "0");
+    assert_knob ("/dev/cpuset/system-background/cpus", "0-1");
+
+    /* journal, devfreq, kernel, cpufreq, processes, cpusets */
+    reconciler_journal_open (reconciler_get_default ());
+    devfreq_set_doze_level (transition.devfreq, DOZE_LEVEL_SCREEN_OFF);
+    kernel_settings_set_powersave (transition.kernel_settings, TRUE);
+    cpufreq_set_doze_level (transition.cpufreq, DOZE_LEVEL_SCREEN_OFF);
+    processes_update (transition.processes);
+    processes_set_cpuset (
+        transition.processes, background, CPUSET_BACKGROUND
+    );
+    processes_set_services_cpuset (
+        transition.processes,
+        cgroups_get_default (G_BUS_TYPE_SYSTEM),
+        CPUSET_BACKGROUND
+    );
+
+    /* Governor kept, capped at 70%, snapped down */
+    assert_knob ("/sys/class/devfreq/devfreq0/governor", "simple_ondemand");
+    assert_knob ("/sys/class/devfreq/devfreq0/max_freq", "200000000");
+    assert_knob ("/sys/class/devfreq/devfreq1/max_freq", "200000000");
+
+    assert_knob ("/proc/sys/vm/swappiness", "5");
+    assert_knob ("/proc/sys/vm/dirty_writeback_centisecs", "60000");
+    assert_knob ("/proc/sys/vm/laptop_mode", "5");
+
+    /* Little uncapped, mid at 70%, prime at 50%, snapped down */
+    assert_knob (
+        "/sys/devices/system/cpu/cpufreq/policy0/scaling_max_freq", "2400000"
+    );
+    assert_knob (
+        "/sys/devices/system/cpu/cpufreq/policy2/scaling_max_freq", "1200000"
+    );
+    assert_knob (
+        "/sys/devices/system/cpu/cpufreq/policy4/scaling_max_freq", "1200000"
+    );
+    assert_knob (
+        "/sys/devices/system/cpu/cpufreq/policy0/schedutil/rate_limit_us",
+        "10000"
+    );
+
+    /* Listed process joins background cpuset */
+    assert_knob ("/dev/cpuset/background/cgroup.procs", "1007");
+
+    /* Services go through systemd, none here: pids are left alone */
+    assert_knob (SERVICE_CGROUP "/cgroup.procs", "1003\n1019\n1035");
+}
+
+static void
+test_doze (void)
+{
+    g_autofree char *frozen_cgroups = NULL;
+
+    g_assert_nonnull (transition.processes);
+
+    processes_set_suspended (transition.processes, new_matcher ("process1003"));
+
+    /* Moved to our delegated cgroup, then frozen at once */
+    processes_suspend (transition.processes);
+    assert_knob (FROZEN_CGROUP "/cgroup.procs", "1003");
+    assert_knob (FROZEN_CGROUP "/cgroup.freeze", "1");
+    frozen_cgroups = g_build_filename (
+        root, RUNTIME_DIR, "frozen-cgroups", NULL
+    );
+    g_assert_true (g_file_test (frozen_cgroups, G_FILE_TEST_EXISTS));
+
+    /* Thawed between doze windows, stays with us for the session */
+    processes_resume (transition.processes);
+    assert_knob (FROZEN_CGROUP "/cgroup.freeze", "0");
+    assert_knob (SERVICE_CGROUP "/cgroup.procs", "1003\n1019\n1035");
+
+    processes_suspend (transition.processes);
+    assert_knob (FROZEN_CGROUP "/cgroup.freeze", "1");
+    processes_resume (transition.processes);
+}
+
+static void
+test_screen_on (void)
+{
+    g_autoptr (Matcher) background = new_matcher ("process1007");
+
+    g_assert_nonnull (transition.cpufreq);
+
+    /* cpufreq, devfreq, kernel, cpusets, deferred */
+    cpufreq_set_doze_level (transition.cpufreq, DOZE_LEVEL_SCREEN_ON);
+    devfreq_set_doze_level (transition.devfreq, DOZE_LEVEL_SCREEN_ON);
+    kernel_settings_restore (transition.kernel_settings, FALSE);
+    processes_set_cpuset (
+        transition.processes, background, CPUSET_SYSTEM_BACKGROUND
+    );
+    processes_set_services_cpuset (
+        transition.processes,
+        cgroups_get_default (G_BUS_TYPE_SYSTEM),
+        CPUSET_SYSTEM_BACKGROUND
+    );
+    processes_release (transition.processes);
+    kernel_settings_restore (transition.kernel_settings, TRUE);
+    reconciler_journal_close (reconciler_get_default ());
+
+    assert_knob ("/sys/class/devfreq/devfreq0/governor", "simple_ondemand");
+    assert_knob ("/sys/class/devfreq/devfreq0/max_freq", "400000000");
+    assert_knob ("/sys/class/devfreq/devfreq1/max_freq", "400000000");
+
+    assert_knob ("/proc/sys/vm/swappiness", "60");
+    assert_knob ("/proc/sys/vm/dirty_writeback_centisecs", "500");
+    assert_knob ("/proc/sys/vm/laptop_mode", "0");
+
+    assert_knob (
+        "/sys/devices/system/cpu/cpufreq/policy0/scaling_max_freq", "2400000"
+    );
+    assert_knob (
+        "/sys/devices/system/cpu/cpufreq/policy2/scaling_max_freq", "2400000"
+    );
+    assert_knob (
+        "/sys/devices/system/cpu/cpufreq/policy4/scaling_max_freq", "2400000"
+    );
+    assert_knob (
+        "/sys/devices/system/cpu/cpufreq/policy0/schedutil/rate_limit_us",
+        "500"
+    );
+
+    assert_knob ("/dev/cpuset/system-background/cgroup.procs", "1007");
+
+    /* Session over: back to its service cgroup */
+    assert_knob (SERVICE_CGROUP "/cgroup.procs", "1003");
+    assert_knob (FROZEN_CGROUP "/cgroup.freeze", "0");
+}
+
+gint
+main (gint argc, char *argv[])
+{
+    gint ret;
+
+    g_test_init (&argc, &argv, NULL);
+
+    if (argc < 2)
+        g_error ("Usage: %s mps-fake-root", argv[0]);
+    fake_root_script = argv[1];
+
+    create_fake_root ();
+
+    g_test_add_func ("/transition/screen-off", test_screen_off);
+    g_test_add_func ("/transition/doze", test_doze);
+    g_test_add_func ("/transition/screen-on", test_screen_on);
+
+    ret = g_test_run ();
+
+    g_clear_object (&transition.cpufreq);
+    g_clear_object (&transition.devfreq);
+    g_clear_object (&transition.kernel_settings);
+    g_clear_object (&transition.processes);
+    cgroups_free_default ();
+    units_free_default ();
+    reconciler_free_default ();
+    remove_tree (root);
+    g_free (root);
+
+    return ret;
+}
@@ -0,0 +1,162 @@
+/*
+ * Copyright Cedric Bellegarde <cedric.bellegarde@adishatz.org>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "../common/writer.h"
+
+/*
+ * Writes a transition worth of knobs (policies, sysctls, cgroups) in a
+ * temporary tree: once with the old g_file_test() + fopen() path, then
+ * with cached descriptors, one by one and batched.
+ */
+
+#define KNOBS 500
+#define KNOBS_PER_DIR 10
+#define ROUNDS 20
+
+static void
+legacy_write (const char *filename,
+              const char *value)
+{
+    FILE *file;
+
+    if (!g_file_test (filename, G_FILE_TEST_EXISTS))
+        return;
+
+    file = fopen (filename, "w");
+    g_return_if_fail (file != NULL);
+
+    fprintf (file, "%s", value);
+    fclose (file);
+}
+
+static GPtrArray *
+create_knobs (const char *root,
+              guint       count)
+{
+    GPtrArray *knobs = g_ptr_array_new_with_free_func (g_free);
+    guint i;
+
+    for (i = 0; i < count; i++) {
+        g_autofree char *dir = g_strdup_printf (
+            "%s/knob%u", root, i / KNOBS_PER_DIR
+        );
+        char *knob = g_strdup_printf ("%s/value%u", dir, i % KNOBS_PER_DIR);
+
+        g_mkdir_with_parents (dir, 0755);
+        g_file_set_contents (knob, "0", -1, NULL);
+        g_ptr_array_add (knobs, knob);
+    }
+
+    return knobs;
+}
+
+static void
+remove_tree (const char *path)
+{
+    g_autoptr (GDir) dir = g_dir_open (path, 0, NULL);
+    const char *name;
+
+    if (dir != NULL) {
+        while ((name = g_dir_read_name (dir)) != NULL) {
+            g_autofree char *child = g_build_filename (path, name, NULL);
+
+            remove_tree (child);
+        }
+    }
+    g_remove (path);
+}
+
+static gdouble
+run_legacy (GPtrArray *knobs,
+            guint      rounds)
+{
+    gint64 start = g_get_monotonic_time ();
+    guint round;
+    guint i;
+
+    for (round = 0; round < rounds; round++)
+        for (i = 0; i < knobs->len; i++)
+            legacy_write (g_ptr_array_index (knobs, i), round % 2 ? "1" : "0");
+
+    return (gdouble) (g_get_monotonic_time () - start) / rounds;
+}
+
+static gdouble
+run_writer (Writer    *writer,
+            GPtrArray *knobs,
+            guint      rounds)
+{
+    gint64 start = g_get_monotonic_time ();
+    guint round;
+    guint i;
+
+    for (round = 0; round < rounds; round++)
+        for (i = 0; i < knobs->len; i++)
+            writer_write (
+                writer, g_ptr_array_index (knobs, i), round % 2 ? "1" : "0"
+            );
+
+    return (gdouble) (g_get_monotonic_time () - start) / rounds;
+}
+
+static gdouble
+run_batch (Writer    *writer,
+           GPtrArray *knobs,
+           guint      rounds)
+{
+    gint64 start = g_get_monotonic_time ();
+    guint round;
+    guint i;
+
+    for (round = 0; round < rounds; round++) {
+        g_autoptr (WriterBatch) batch = writer_batch_new ();
+
+        for (i = 0; i < knobs->len; i++)
+            writer_batch_add (
+                batch, g_ptr_array_index (knobs, i), round % 2 ? "1" : "0"
+            );
+        if (writer_batch_submit (writer, batch) != 0)
+            g_error ("Batch failed");
+    }
+
+    return (gdouble) (g_get_monotonic_time () - start) / rounds;
+}
+
+gint
+main (gint argc, char *argv[])
+{
+    g_autoptr (GError) error = NULL;
+    g_autoptr (GPtrArray) knobs = NULL;
+    g_autofree char *root = NULL;
+    Writer *writer;
+    guint count = argc > 1 ? strtoul (argv[1], NULL, 10) : KNOBS;
+    guint rounds = argc > 2 ? strtoul (argv[2], NULL, 10) : ROUNDS;
+
+    root = g_dir_make_tmp ("mps-writer-XXXXXX", &error);
+    if (root == NULL)
+        g_error ("%s", error->message);
+
+    knobs = create_knobs (root, count);
+    writer = WRITER (writer_new ());
+
+    /* Warm up page cache and writer descriptors */
+    run_legacy (knobs, 1);
+    run_writer (writer, knobs, 1);
+
+    g_print ("%u writes per transition, %u rounds\n", count, rounds);
+    g_print ("fopen/fprintf:   %8.0f us\n", run_legacy (knobs, rounds));
+    g_print ("writer_write():  %8.0f us\n", run_writer (writer, knobs, rounds));
+    g_print ("writer batch:    %8.0f us\n", run_batch (writer, knobs, rounds));
+
+    g_object_unref (writer);
+    remove_tree (root);
+
+    return EXIT_SUCCESS;
+}
@@ -8,7 +8,6 @@
 #include "config.h"
 #include "bus.h"
 #include "settings.h"
-#include "../common/define.h"
 
 #define DBUS_MPS_NAME                "org.adishatz.Mps"
 #define DBUS_MPS_PATH                "/org/adishatz/Mps"
@@ -94,10 +93,6 @@ bus_class_init (BusClass *klass)
 static void
 bus_init (Bus *self)
 {
-    g_autofree char *cgroups_user_services_dir = g_strdup_printf(
-        CGROUPS_USER_DIR, getuid(), getuid()
-    );
-
     self->priv = bus_get_instance_private (self);
 
     self->priv->mps_proxy = g_dbus_proxy_new_for_bus_sync (
@@ -117,12 +112,6 @@ bus_init (Bus *self)
         G_CALLBACK (on_mps_proxy_signal),
         self
     );
-
-    bus_set_value (
-        self,
-        "cgroups-user-dir",
-        g_variant_new ("s", cgroups_user_services_dir)
-    );
 }
 
 /**
@@ -193,3 +182,20 @@ bus_get_default (void)
     }
     return default_bus;
 }
+
+/**
+ * bus_get_cpuset_layout:
+ *
+ * Get cpus used by cpusets, as published by system daemon
+ *
+ * @self: a #Bus
+ *
+ * Returns: (transfer full) (nullable): cpus by cpuset name, as a{ss}
+ */
+GVariant *
+bus_get_cpuset_layout (Bus *self)
+{
+    return g_dbus_proxy_get_cached_property (
+        self->priv->mps_proxy, "CpusetLayout"
+    );
+}
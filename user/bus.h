@@ -47,6 +47,7 @@ GObject*    bus_new            (void);
 void        bus_set_value      (Bus        *self,
                                 const char *key,
                                 GVariant   *value);
+GVariant   *bus_get_cpuset_layout (Bus     *self);
 
 G_END_DECLS
 
@@ -2,6 +2,7 @@
  * Copyright Cedric Bellegarde <cedric.bellegarde@adishatz.org>
  */
 
+#include <errno.h>
 #include <stdio.h>
 #include <stdarg.h>
 #include <signal.h>
@@ -19,8 +20,11 @@
 #endif
 #include "network_manager.h"
 #include "settings.h"
+#include "../common/define.h"
 #include "../common/services.h"
+#include "../common/throttle.h"
 #include "../common/utils.h"
+#include "../common/writer.h"
 
 #define DOZING_PRE_SLEEP          60
 #define DOZING_LIGHT_SLEEP        300
@@ -30,6 +34,8 @@
 #define DOZING_FULL_SLEEP         1200
 #define DOZING_FULL_MAINTENANCE   80
 #define MODEM_APPLY_DELAY 500
+/* Bytes reclaimed from all frozen apps in a doze cycle */
+#define DOZING_RECLAIM_CYCLE_LIMIT (256 * 1024 * 1024)
 
 enum DozingType {
     DOZING_LIGHT,
@@ -48,13 +54,17 @@ struct _DozingPrivate {
     Modem  *modem;
     NetworkManager *network_manager;
     Services *services;
+    Throttle *throttle;
 
     guint type;
     guint timeout_id;
 
     gboolean radio_power_saving;
+    gboolean little_cluster_powersave;
 
     guint modem_timeout_id;
+
+    GCancellable *reclaim_cancellable;
 };
 
 G_DEFINE_TYPE_WITH_CODE (
@@ -89,6 +99,17 @@ get_sleep (Dozing *self)
         return DOZING_FULL_SLEEP;
 }
 
+static DozeLevel
+get_doze_level (Dozing *self)
+{
+    if (self->priv->type < DOZING_MEDIUM)
+        return DOZE_LEVEL_LIGHT;
+    else if (self->priv->type < DOZING_FULL)
+        return DOZE_LEVEL_MEDIUM;
+    else
+        return DOZE_LEVEL_FULL;
+}
+
 static void
 queue_next_freeze (Dozing *self)
 {
@@ -135,14 +156,18 @@ freeze_services (Dozing *self)
                    g_variant_new ("b", TRUE));
 
     if (settings_suspend_services (settings_get_default ())) {
-        GList *blacklist = settings_get_suspend_services_blacklist (
+        Matcher *blacklist = settings_get_suspend_services_blacklist (
             settings_get_default ()
         );
 
         services_freeze_all (self->priv->services, blacklist);
-
-        g_list_free_full (blacklist, g_free);
     }
+
+    throttle_cgroups (
+        self->priv->throttle,
+        cgroups_get_default (G_BUS_TYPE_SESSION),
+        settings_get_suspend_services_blacklist (settings_get_default ())
+    );
 }
 
 static void
@@ -157,20 +182,141 @@ unfreeze_services (Dozing *self)
                    g_variant_new ("b", FALSE));
 
     if (settings_suspend_services (settings_get_default ())) {
-        GList *blacklist = settings_get_suspend_services_blacklist (
+        Matcher *blacklist = settings_get_suspend_services_blacklist (
             settings_get_default ()
         );
 
         services_unfreeze_all (self->priv->services, blacklist);
+    }
+
+    throttle_restore (self->priv->throttle);
+}
+
+typedef struct {
+    GList *scope_dirs;
+    guint64 limit;
+} ReclaimRequest;
+
+static void
+reclaim_request_free (ReclaimRequest *request)
+{
+    g_list_free_full (request->scope_dirs, g_free);
+    g_free (request);
+}
+
+static guint64
+read_memory_current (Writer     *writer,
+                     const char *scope_dir)
+{
+    g_autofree char *path = g_build_filename (
+        scope_dir, "memory.current", NULL
+    );
+    char buffer[32];
+
+    if (writer_read (writer, path, buffer, sizeof (buffer)) != 0)
+        return 0;
+
+    return g_ascii_strtoull (buffer, NULL, 10);
+}
+
+static void
+reclaim_apps_thread (GTask        *task,
+                     gpointer      source_object,
+                     gpointer      task_data,
+                     GCancellable *cancellable)
+{
+    ReclaimRequest *request = task_data;
+    /* Default writer belongs to main loop */
+    g_autoptr (GObject) writer = writer_new ();
+    guint64 budget = DOZING_RECLAIM_CYCLE_LIMIT;
+    const char *scope_dir;
+
+    GFOREACH (request->scope_dirs, scope_dir) {
+        g_autofree char *scope = g_path_get_basename (scope_dir);
+        g_autofree char *reclaim_path = NULL;
+        g_autofree char *value = NULL;
+        guint64 before;
+        guint64 after;
+        guint64 amount;
+        gint error;
+
+        /* Apps thawed: reclaimed pages would fault back */
+        if (g_cancellable_is_cancelled (cancellable))
+            break;
+
+        if (budget == 0) {
+            g_message ("Reclaim budget exhausted");
+            break;
+        }
 
-        g_list_free_full (blacklist, g_free);
+        before = read_memory_current (WRITER (writer), scope_dir);
+        amount = MIN (MIN (before, request->limit), budget);
+        if (amount == 0)
+            continue;
+
+        /* Synchronous: returns once amount is reclaimed or given up */
+        reclaim_path = g_build_filename (scope_dir, "memory.reclaim", NULL);
+        value = g_strdup_printf ("%" G_GUINT64_FORMAT, amount);
+        error = writer_try_write (WRITER (writer), reclaim_path, value);
+
+        /* EAGAIN: less than requested was reclaimed */
+        if (error != 0 && error != EAGAIN) {
+            if (error != ENOENT)
+                g_warning (
+                    "Can't reclaim from %s: %s", scope, g_strerror (error)
+                );
+            continue;
+        }
+
+        budget -= amount;
+        after = read_memory_current (WRITER (writer), scope_dir);
+        g_message (
+            "Reclaimed %" G_GUINT64_FORMAT " bytes from %s",
+            before > after ? before - after : 0,
+            scope
+        );
     }
+
+    g_task_return_boolean (task, TRUE);
+}
+
+static void
+reclaim_apps (Dozing *self,
+              GList  *frozen_apps)
+{
+    guint64 limit = settings_get_frozen_apps_reclaim (settings_get_default ());
+    g_autoptr (GTask) task = NULL;
+    ReclaimRequest *request;
+    const char *app;
+
+    /* MiB per app */
+    limit *= 1024 * 1024;
+    if (limit == 0 || frozen_apps == NULL)
+        return;
+
+    request = g_new0 (ReclaimRequest, 1);
+    request->limit = limit;
+    GFOREACH (frozen_apps, app)
+        request->scope_dirs = g_list_prepend (
+            request->scope_dirs, g_path_get_dirname (app)
+        );
+
+    g_clear_object (&self->priv->reclaim_cancellable);
+    self->priv->reclaim_cancellable = g_cancellable_new ();
+
+    /* Frozen: nothing will fault pages back before maintenance */
+    task = g_task_new (self, self->priv->reclaim_cancellable, NULL, NULL);
+    g_task_set_task_data (
+        task, request, (GDestroyNotify) reclaim_request_free
+    );
+    g_task_run_in_thread (task, reclaim_apps_thread);
 }
 
 static gboolean
 freeze_apps (Dozing *self)
 {
     Bus *bus = bus_get_default ();
+    g_autoptr (GList) frozen_apps = NULL;
     const char *app;
     gboolean apps_active = FALSE;
 
@@ -181,19 +327,29 @@ freeze_apps (Dozing *self)
                 apps_active = TRUE;
                 continue;
             }
-            if (settings_can_freeze_app (settings_get_default (), app))
-                write_to_file (app, "1");
+            if (settings_can_freeze_app (settings_get_default (), app) &&
+                    write_to_file (app, "1") == 0)
+                frozen_apps = g_list_prepend (frozen_apps, (gpointer) app);
         }
     }
 
+    /* Light doze is too short to be worth refaulting */
+    if (self->priv->type >= DOZING_MEDIUM)
+        reclaim_apps (self, frozen_apps);
+
     if (apps_active) {
         g_message ("Phone active: Keep little cluster active");
-    } else {
+    } else if (!self->priv->little_cluster_powersave) {
         bus_set_value (bus,
                        "little-cluster-powersave",
                        g_variant_new ("b", TRUE));
+        self->priv->little_cluster_powersave = TRUE;
     }
 
+    bus_set_value (bus,
+                   "doze-level",
+                   g_variant_new ("u", get_doze_level (self)));
+
     powersave_modem (self, TRUE);
     freeze_services (self);
 
@@ -210,15 +366,24 @@ freeze_apps (Dozing *self)
 static gboolean
 unfreeze_apps (Dozing *self)
 {
+    Bus *bus = bus_get_default ();
     const char *app;
 
     if (self->priv->apps == NULL)
         return FALSE;
 
+    if (self->priv->reclaim_cancellable != NULL)
+        g_cancellable_cancel (self->priv->reclaim_cancellable);
+
     g_message("Unfreezing apps");
     GFOREACH (self->priv->apps, app)
         write_to_file (app, "0");
 
+    /* Maintenance window */
+    bus_set_value (bus,
+                   "doze-level",
+                   g_variant_new ("u", DOZE_LEVEL_SCREEN_OFF));
+
     powersave_modem (self, FALSE);
     unfreeze_services (self);
 
@@ -259,6 +424,20 @@ on_setting_changed (Settings   *settings,
         self->priv->modem_timeout_id = g_timeout_add (
             MODEM_APPLY_DELAY, (GSourceFunc) on_modem_timeout, self
         );
+    } else if (g_strcmp0 (key, "doze-io-weight") == 0) {
+        throttle_set_limit (
+            self->priv->throttle, THROTTLE_WEIGHT, g_variant_get_uint32 (value)
+        );
+    } else if (g_strcmp0 (key, "doze-io-max-iops") == 0) {
+        throttle_set_limit (
+            self->priv->throttle, THROTTLE_IOPS, g_variant_get_uint32 (value)
+        );
+    } else if (g_strcmp0 (key, "doze-io-max-bandwidth") == 0) {
+        throttle_set_limit (
+            self->priv->throttle,
+            THROTTLE_BANDWIDTH,
+            g_variant_get_uint32 (value)
+        );
     }
 }
 
@@ -290,6 +469,11 @@ dozing_dispose (GObject *dozing)
     g_clear_object (&self->priv->modem);
     g_clear_object (&self->priv->mpris);
     g_clear_object (&self->priv->services);
+    g_clear_object (&self->priv->throttle);
+
+    if (self->priv->reclaim_cancellable != NULL)
+        g_cancellable_cancel (self->priv->reclaim_cancellable);
+    g_clear_object (&self->priv->reclaim_cancellable);
 
     G_OBJECT_CLASS (dozing_parent_class)->dispose (dozing);
 }
@@ -329,14 +513,17 @@ dozing_init (Dozing *self)
 #endif
     self->priv->mpris = MPRIS (mpris_new ());
     self->priv->services = SERVICES (services_new (G_BUS_TYPE_SESSION));
+    self->priv->throttle = THROTTLE (throttle_new (G_BUS_TYPE_SESSION));
 
     self->priv->apps = NULL;
     self->priv->type = DOZING_LIGHT;
 
     self->priv->radio_power_saving = FALSE;
+    self->priv->little_cluster_powersave = FALSE;
 
     self->priv->timeout_id = 0;
     self->priv->modem_timeout_id = 0;
+    self->priv->reclaim_cancellable = NULL;
 
 
     g_signal_connect (
@@ -405,6 +592,8 @@ dozing_start (Dozing  *self) {
 
     self->priv->apps = get_applications();
 
+    /* System daemon restores little cluster on screen on */
+    self->priv->little_cluster_powersave = FALSE;
     self->priv->type = DOZING_LIGHT;
     self->priv->timeout_id = g_timeout_add_seconds (
         DOZING_PRE_SLEEP,
@@ -430,6 +619,9 @@ dozing_stop (Dozing  *self) {
     bus_set_value (bus, "suspend-modem", g_variant_new ("b", FALSE));
     unfreeze_services (self);
 
+    if (self->priv->reclaim_cancellable != NULL)
+        g_cancellable_cancel (self->priv->reclaim_cancellable);
+
     g_message("Unfreezing apps");
     GFOREACH (self->priv->apps, app)
         write_to_file (app, "0");
@@ -11,6 +11,11 @@
 #include <signal.h>
 
 #include "manager.h"
+#include "../common/cgroups.h"
+#include "../common/reconciler.h"
+#include "../common/units.h"
+#include "../common/utils.h"
+#include "../common/writer.h"
 #include "settings.h"
 
 #include <glib/gi18n-lib.h>
@@ -28,9 +33,13 @@ main (gint argc, char * argv[])
     GObject *manager;
     g_autoptr (GOptionContext) context = NULL;
     g_autoptr (GError) error = NULL;
+    g_autofree char *root_dir = NULL;
     gboolean version = FALSE;
     GOptionEntry main_entries[] = {
         {"version", 0, 0, G_OPTION_ARG_NONE, &version, "Show version"},
+        {"root", 0, 0, G_OPTION_ARG_FILENAME, &root_dir,
+         "Use sysfs/procfs/cgroups from this root (default: $MPS_ROOT_DIR)",
+         "DIR"},
         {NULL}
     };
 
@@ -53,6 +62,10 @@ main (gint argc, char * argv[])
         return EXIT_SUCCESS;
     }
 
+    if (root_dir == NULL)
+        root_dir = g_strdup (g_getenv ("MPS_ROOT_DIR"));
+    set_root_dir (root_dir);
+
     manager = manager_new ();
 
     loop = g_main_loop_new (NULL, FALSE);
@@ -60,6 +73,10 @@ main (gint argc, char * argv[])
 
     g_clear_pointer (&loop, g_main_loop_unref);
     g_clear_object (&manager);
+    cgroups_free_default ();
+    units_free_default ();
+    reconciler_free_default ();
+    writer_free_default ();
 
     return EXIT_SUCCESS;
 }
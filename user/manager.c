@@ -13,9 +13,13 @@
 #include "manager.h"
 #include "mpris.h"
 #include "settings.h"
+#include "../common/cgroups.h"
+#include "../common/units.h"
+#include "../common/utils.h"
 
 struct _ManagerPrivate {
     Bluetooth *bluetooth;
+    Units *units;
 
     gboolean screen_off_power_saving;
     gboolean bluetooth_power_saving;
@@ -48,6 +52,42 @@ on_setting_changed (Settings   *settings,
     }
 }
 
+static void
+set_services_cpuset (Manager  *self,
+                     gboolean  screen_on)
+{
+    Settings *settings = settings_get_default ();
+    g_autoptr (GVariant) layout = bus_get_cpuset_layout (bus_get_default ());
+    Matcher *idle_services = settings_get_cpu_idle_services (settings);
+    GList *services;
+    const char *service;
+
+    /* User manager owns our services cgroups, ask it */
+    services = cgroups_get_services (cgroups_get_default (G_BUS_TYPE_SESSION));
+    GFOREACH (services, service) {
+        const char *cpuset = screen_on ? "foreground" : "system-background";
+        const char *cpus;
+
+        units_set_cpu_idle (
+            self->priv->units,
+            service,
+            !screen_on && matcher_contains (idle_services, service)
+        );
+
+        if (matcher_match (settings_get_cpuset_blacklist (settings), service))
+            continue;
+
+        if (screen_on &&
+                matcher_contains (settings_get_cpuset_topapp (settings), service))
+            cpuset = "top-app";
+
+        /* System daemon owns the layout */
+        if (layout != NULL && g_variant_lookup (layout, cpuset, "&s", &cpus))
+            units_set_allowed_cpus (self->priv->units, service, cpus);
+    }
+    g_list_free (services);
+}
+
 static void
 on_screen_state_changed (Bus      *bus,
                          gboolean  screen_on,
@@ -62,6 +102,8 @@ on_screen_state_changed (Bus      *bus,
             dozing_start (dozing_get_default ());
         }
 
+        set_services_cpuset (self, screen_on);
+
         if (self->priv->bluetooth_power_saving) {
             bluetooth_set_powersave (self->priv->bluetooth, !screen_on);
         }
@@ -71,7 +113,10 @@ on_screen_state_changed (Bus      *bus,
 static void
 manager_dispose (GObject *manager)
 {
+    Manager *self = MANAGER (manager);
+
     dozing_stop (dozing_get_default ());
+    g_clear_object (&self->priv->units);
 
     G_OBJECT_CLASS (manager_parent_class)->dispose (manager);
 }
@@ -98,6 +143,7 @@ manager_init (Manager *self)
     self->priv = manager_get_instance_private (self);
 
     self->priv->bluetooth = BLUETOOTH (bluetooth_new ());
+    self->priv->units = g_object_ref (units_get_default (G_BUS_TYPE_SESSION));
 
     self->priv->screen_off_power_saving = TRUE;
     self->priv->bluetooth_power_saving = TRUE;
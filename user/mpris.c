@@ -8,6 +8,7 @@
 #include "config.h"
 #include "mpris.h"
 #include "settings.h"
+#include "../common/matcher.h"
 #include "../common/utils.h"
 
 #define DBUS_FREEDESKTOP_NAME           "org.freedesktop.DBus"
@@ -30,6 +31,7 @@ struct _MprisPrivate {
     GDBusProxy *dbus_proxy;
 
     GList *players;
+    Matcher *desktop_ids;
 };
 
 G_DEFINE_TYPE_WITH_CODE (Mpris, mpris, G_TYPE_OBJECT,
@@ -61,6 +63,20 @@ clear_player (struct Player *player)
     g_free (player);
 }
 
+static void
+update_desktop_ids (Mpris *self)
+{
+    g_autoptr (GList) desktop_ids = NULL;
+    struct Player *player;
+
+    GFOREACH (self->priv->players, player)
+        desktop_ids = g_list_prepend (desktop_ids, player->desktop_id);
+
+    /* Compiled once */
+    g_clear_pointer (&self->priv->desktop_ids, matcher_free);
+    self->priv->desktop_ids = matcher_new_from_list (desktop_ids);
+}
+
 static void
 on_player_proxy_properties (GDBusProxy  *proxy,
                             GVariant    *changed_properties,
@@ -123,6 +139,7 @@ add_player (Mpris      *self,
     player = get_player (player_bus, name, desktop_id, is_playing);
 
     self->priv->players = g_list_append (self->priv->players, player);
+    update_desktop_ids (self);
 
     g_signal_connect (
         player_bus,
@@ -189,6 +206,7 @@ del_player (Mpris      *self,
                 self->priv->players, player
             );
             clear_player (player);
+            update_desktop_ids (self);
             return;
         }
     }
@@ -272,6 +290,7 @@ mpris_finalize (GObject *mpris)
     Mpris *self = MPRIS (mpris);
 
     g_list_free (self->priv->players);
+    matcher_free (self->priv->desktop_ids);
 
     G_OBJECT_CLASS (mpris_parent_class)->finalize (mpris);
 }
@@ -291,6 +310,9 @@ mpris_init (Mpris *self)
 {
     self->priv = mpris_get_instance_private (self);
 
+    self->priv->players = NULL;
+    self->priv->desktop_ids = matcher_new ();
+
     self->priv->dbus_proxy = g_dbus_proxy_new_for_bus_sync (
         G_BUS_TYPE_SESSION,
         0,
@@ -347,10 +369,14 @@ gboolean
 mpris_can_freeze (Mpris      *self,
                   const char *app_scope)
 {
+    const char *desktop_id = matcher_search (self->priv->desktop_ids, app_scope);
     struct Player *player;
 
+    if (desktop_id == NULL)
+        return TRUE;
+
     GFOREACH (self->priv->players, player) {
-        if (g_strrstr (app_scope, player->desktop_id) != NULL)
+        if (g_strcmp0 (player->desktop_id, desktop_id) == 0)
             return !player->is_playing;
     }
     return TRUE;
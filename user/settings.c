@@ -7,6 +7,7 @@
 #include "bus.h"
 #include "config.h"
 #include "settings.h"
+#include "../common/matcher.h"
 
 /* signals */
 enum
@@ -19,6 +20,13 @@ static guint signals[LAST_SIGNAL];
 
 struct _SettingsPrivate {
     GSettings *settings;
+
+    Matcher *bluetooth_power_saving_blacklist;
+    Matcher *suspend_apps_blacklist;
+    Matcher *suspend_services_blacklist;
+    Matcher *cpuset_blacklist;
+    Matcher *cpuset_topapp;
+    Matcher *cpu_idle_services;
 };
 
 G_DEFINE_TYPE_WITH_CODE (
@@ -28,6 +36,33 @@ G_DEFINE_TYPE_WITH_CODE (
     G_ADD_PRIVATE (Settings)
 )
 
+static void
+update_matcher (Settings   *self,
+                const char *key)
+{
+    g_autoptr (GVariant) value = NULL;
+    Matcher **matcher;
+
+    if (g_strcmp0 (key, "bluetooth-power-saving-blacklist") == 0)
+        matcher = &self->priv->bluetooth_power_saving_blacklist;
+    else if (g_strcmp0 (key, "suspend-apps-blacklist") == 0)
+        matcher = &self->priv->suspend_apps_blacklist;
+    else if (g_strcmp0 (key, "suspend-user-services-blacklist") == 0)
+        matcher = &self->priv->suspend_services_blacklist;
+    else if (g_strcmp0 (key, "cpuset-blacklist") == 0)
+        matcher = &self->priv->cpuset_blacklist;
+    else if (g_strcmp0 (key, "cpuset-topapp") == 0)
+        matcher = &self->priv->cpuset_topapp;
+    else if (g_strcmp0 (key, "cpu-idle-services") == 0)
+        matcher = &self->priv->cpu_idle_services;
+    else
+        return;
+
+    value = g_settings_get_value (self->priv->settings, key);
+    g_clear_pointer (matcher, matcher_free);
+    *matcher = matcher_new_from_variant (value);
+}
+
 static void
 on_setting_changed (GSettings  *settings,
                     const char *key,
@@ -36,6 +71,8 @@ on_setting_changed (GSettings  *settings,
     Settings *self = SETTINGS (user_data);
     g_autoptr (GVariant) value = g_settings_get_value (settings, key);
 
+    update_matcher (self, key);
+
     g_signal_emit(
         self,
         signals[SETTING_CHANGED],
@@ -79,6 +116,15 @@ settings_dispose (GObject *settings)
 static void
 settings_finalize (GObject *settings)
 {
+    Settings *self = SETTINGS (settings);
+
+    matcher_free (self->priv->bluetooth_power_saving_blacklist);
+    matcher_free (self->priv->suspend_apps_blacklist);
+    matcher_free (self->priv->suspend_services_blacklist);
+    matcher_free (self->priv->cpuset_blacklist);
+    matcher_free (self->priv->cpuset_topapp);
+    matcher_free (self->priv->cpu_idle_services);
+
     G_OBJECT_CLASS (settings_parent_class)->finalize (settings);
 }
 
@@ -111,6 +157,19 @@ settings_init (Settings *self)
 
     self->priv->settings = g_settings_new (APP_ID);
 
+    self->priv->bluetooth_power_saving_blacklist = NULL;
+    self->priv->suspend_apps_blacklist = NULL;
+    self->priv->suspend_services_blacklist = NULL;
+    self->priv->cpuset_blacklist = NULL;
+    self->priv->cpuset_topapp = NULL;
+    self->priv->cpu_idle_services = NULL;
+    update_matcher (self, "bluetooth-power-saving-blacklist");
+    update_matcher (self, "suspend-apps-blacklist");
+    update_matcher (self, "suspend-user-services-blacklist");
+    update_matcher (self, "cpuset-blacklist");
+    update_matcher (self, "cpuset-topapp");
+    update_matcher (self, "cpu-idle-services");
+
     g_signal_connect (
         self->priv->settings,
         "changed",
@@ -185,18 +244,9 @@ gboolean
 settings_can_bluetooth_powersave (Settings   *self,
                                   const char *app_scope)
 {
-    g_autoptr (GVariant) value = g_settings_get_value (
-        self->priv->settings, "bluetooth-power-saving-blacklist"
+    return !matcher_match (
+        self->priv->bluetooth_power_saving_blacklist, app_scope
     );
-    g_autoptr (GVariantIter) iter;
-    const char *application;
-
-    g_variant_get (value, "as", &iter);
-    while (g_variant_iter_loop (iter, "s", &application)) {
-        if (g_strrstr (app_scope, application) != NULL)
-            return FALSE;
-    }
-    return TRUE;
 }
 
 /**
@@ -213,18 +263,7 @@ gboolean
 settings_can_freeze_app (Settings   *self,
                          const char *app_scope)
 {
-    g_autoptr (GVariant) value = g_settings_get_value (
-        self->priv->settings, "suspend-apps-blacklist"
-    );
-    g_autoptr (GVariantIter) iter;
-    const char *application;
-
-    g_variant_get (value, "as", &iter);
-    while (g_variant_iter_loop (iter, "s", &application)) {
-        if (g_strrstr (app_scope, application) != NULL)
-            return FALSE;
-    }
-    return TRUE;
+    return !matcher_match (self->priv->suspend_apps_blacklist, app_scope);
 }
 
 
@@ -245,6 +284,23 @@ settings_suspend_services (Settings *self)
     );
 }
 
+/**
+ * settings_get_frozen_apps_reclaim:
+ *
+ * Get memory to reclaim from each frozen app
+ *
+ * @self: a #Settings
+ *
+ * Returns: MiB to reclaim, 0 if disabled
+ */
+guint
+settings_get_frozen_apps_reclaim (Settings *self)
+{
+    return g_settings_get_uint (
+        self->priv->settings, "frozen-apps-reclaim"
+    );
+}
+
 /**
  * settings_get_suspend_services_blacklist
  *
@@ -252,21 +308,55 @@ settings_suspend_services (Settings *self)
  *
  * @self: a #Settings
  *
- * Return value: (transfer full): services list.
+ * Return value: (transfer none): services names.
  */
-GList *
+Matcher *
 settings_get_suspend_services_blacklist (Settings *self)
 {
-    g_autoptr (GVariant) value = g_settings_get_value (
-        self->priv->settings, "suspend-user-services-blacklist"
-    );
-    g_autoptr (GVariantIter) iter;
-    const char *service;
-    GList *services = NULL;
+    return self->priv->suspend_services_blacklist;
+}
 
-    g_variant_get (value, "as", &iter);
-    while (g_variant_iter_loop (iter, "s", &service)) {
-        services = g_list_append (services, g_strdup (service));
-    }
-    return services;
+/**
+ * settings_get_cpuset_blacklist
+ *
+ * Get services those must not be moved between cpusets
+ *
+ * @self: a #Settings
+ *
+ * Return value: (transfer none): services names.
+ */
+Matcher *
+settings_get_cpuset_blacklist (Settings *self)
+{
+    return self->priv->cpuset_blacklist;
+}
+
+/**
+ * settings_get_cpuset_topapp
+ *
+ * Get services running in top-app cpuset while screen is on
+ *
+ * @self: a #Settings
+ *
+ * Return value: (transfer none): services names.
+ */
+Matcher *
+settings_get_cpuset_topapp (Settings *self)
+{
+    return self->priv->cpuset_topapp;
+}
+
+/**
+ * settings_get_cpu_idle_services
+ *
+ * Get services running at idle cpu priority while screen is off
+ *
+ * @self: a #Settings
+ *
+ * Return value: (transfer none): services names.
+ */
+Matcher *
+settings_get_cpu_idle_services (Settings *self)
+{
+    return self->priv->cpu_idle_services;
 }
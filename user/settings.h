@@ -8,6 +8,8 @@
 #include <glib.h>
 #include <glib-object.h>
 
+#include "../common/matcher.h"
+
 #define TYPE_SETTINGS \
     (settings_get_type ())
 #define SETTINGS(obj) \
@@ -51,7 +53,11 @@ gboolean        settings_can_bluetooth_powersave        (Settings   *self,
 gboolean        settings_can_freeze_app                 (Settings   *self,
                                                          const char *app_scope);
 gboolean        settings_suspend_services               (Settings   *self);
-GList          *settings_get_suspend_services_blacklist (Settings   *self);
+guint           settings_get_frozen_apps_reclaim        (Settings   *self);
+Matcher        *settings_get_suspend_services_blacklist (Settings   *self);
+Matcher        *settings_get_cpuset_blacklist           (Settings   *self);
+Matcher        *settings_get_cpuset_topapp              (Settings   *self);
+Matcher        *settings_get_cpu_idle_services          (Settings   *self);
 
 G_END_DECLS
 